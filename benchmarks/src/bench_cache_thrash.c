@@ -0,0 +1,123 @@
+/*
+ * ==============================================================================
+ * File: bench_cache_thrash.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xd_malloc.h"
+
+/**
+ * @brief The default number of increments done by each thread.
+ */
+#define DEFAULT_INCREMENT_COUNT (100000000ULL)
+
+/**
+ * @brief The number of threads, each increments its own counter.
+ */
+#define THREAD_COUNT (4)
+
+static uint64_t increment_count = DEFAULT_INCREMENT_COUNT;
+static pthread_barrier_t barrier;
+static volatile uint64_t *counters[THREAD_COUNT];
+
+/**
+ * @brief Returns the current monotonic time in nanoseconds.
+ */
+static inline uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}  // now_ns()
+
+/**
+ * @brief Increments the thread's counter once all the threads are started.
+ */
+static void *thread_routine(void *arg) {
+  int index = (int)(intptr_t)arg;
+  volatile uint64_t *counter = counters[index];
+  pthread_barrier_wait(&barrier);
+  for (uint64_t i = 0; i < increment_count; i++) {
+    (*counter)++;
+  }
+  return NULL;
+}  // thread_routine()
+
+/**
+ * @brief Runs the threads with counters allocated under the passed placement
+ * policy, returns the elapsed time in nanoseconds.
+ */
+static uint64_t run(int policy) {
+  pthread_t threads[THREAD_COUNT];
+
+  // allocate the counters one after the other, as threads starting together
+  // would, so under the shared policy they end up next to each other
+  xd_malloc_thread_policy(policy);
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    counters[i] = xd_malloc(sizeof(uint64_t));
+    if (counters[i] == NULL) {
+      perror("xd_malloc");
+      exit(EXIT_FAILURE);
+    }
+    *counters[i] = 0;
+  }
+  xd_malloc_thread_policy(XD_THREAD_POLICY_SHARED);
+
+  pthread_barrier_init(&barrier, NULL, THREAD_COUNT + 1);
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_create(&threads[i], NULL, thread_routine, (void *)(intptr_t)i);
+  }
+  uint64_t start = now_ns();
+  pthread_barrier_wait(&barrier);
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  uint64_t elapsed = now_ns() - start;
+  pthread_barrier_destroy(&barrier);
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    xd_free((void *)counters[i]);
+  }
+  return elapsed;
+}  // run()
+
+/**
+ * @brief Measures the cost of false sharing between per-thread counters:
+ * - Usage: `bench_cache_thrash [increment_count]` (default 10^8 per thread).
+ * - Each of the threads increments its own counter allocated by `xd_malloc()`,
+ *   first with the counters packed together (`XD_THREAD_POLICY_SHARED`), then
+ *   on cache lines of their own (`XD_THREAD_POLICY_CACHELINE`).
+ * - The difference only shows on a machine with more than one CPU.
+ */
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    increment_count = strtoull(argv[1], NULL, 10);
+  }
+
+  uint64_t shared_ns = run(XD_THREAD_POLICY_SHARED);
+  uint64_t isolated_ns = run(XD_THREAD_POLICY_CACHELINE);
+
+  printf("threads:     %d\n", THREAD_COUNT);
+  printf("increments:  %" PRIu64 " per thread\n", increment_count);
+  printf("shared:      %.1f ms\n", (double)shared_ns / 1e6);
+  printf("cache line:  %.1f ms\n", (double)isolated_ns / 1e6);
+  printf("speedup:     %.2fx\n",
+         (isolated_ns == 0) ? 0.0 : (double)shared_ns / (double)isolated_ns);
+
+  exit(EXIT_SUCCESS);
+}  // main()
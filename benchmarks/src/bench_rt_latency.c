@@ -0,0 +1,146 @@
+/*
+ * ==============================================================================
+ * File: bench_rt_latency.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xd_malloc.h"
+
+/**
+ * @brief The default number of operations (`xd_malloc()` or `xd_free()`).
+ */
+#define DEFAULT_OP_COUNT (1000000000ULL)
+
+/**
+ * @brief The number of live pointer slots, must be a power of two.
+ */
+#define SLOT_COUNT (4096)
+
+/**
+ * @brief The size of the heap reserved in real-time mode.
+ */
+#define RESERVE_SIZE (64 * 1024 * 1024)
+
+/**
+ * @brief The number of latency histogram buckets, bucket `i` counts the
+ * operations that took `[2^i, 2^(i+1))` nanoseconds.
+ */
+#define BUCKET_COUNT (64)
+
+static void *slots[SLOT_COUNT];
+static uint64_t histogram[BUCKET_COUNT];
+
+/**
+ * @brief Returns the current monotonic time in nanoseconds.
+ */
+static inline uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}  // now_ns()
+
+/**
+ * @brief Returns the next number of a xorshift64 pseudo-random sequence.
+ */
+static inline uint64_t next_random(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}  // next_random()
+
+/**
+ * @brief Returns the upper bound (in nanoseconds) of the histogram bucket
+ * holding the passed percentile of the operations.
+ */
+static uint64_t percentile_ns(uint64_t op_count, double percentile) {
+  uint64_t target = (uint64_t)((double)op_count * percentile);
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    seen += histogram[i];
+    if (seen >= target) {
+      return (i == BUCKET_COUNT - 1) ? UINT64_MAX : (2ULL << i) - 1;
+    }
+  }
+  return UINT64_MAX;
+}  // percentile_ns()
+
+/**
+ * @brief Measures the latency of every `xd_malloc()`/`xd_free()` in real-time
+ * mode and reports the worst case:
+ * - Usage: `bench_rt_latency [op_count]` (default 10^9 operations).
+ * - A random slot is picked per operation: an empty slot is filled with an
+ *   allocation of a random size in `[16, 1024]`, a full slot is freed.
+ */
+int main(int argc, char **argv) {
+  uint64_t op_count = DEFAULT_OP_COUNT;
+  if (argc > 1) {
+    op_count = strtoull(argv[1], NULL, 10);
+  }
+
+  if (xd_malloc_rt_enable(RESERVE_SIZE) != 0) {
+    perror("xd_malloc_rt_enable");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t random_state = 88172645463325252ULL;
+  uint64_t worst_ns = 0;
+  uint64_t total_ns = 0;
+  uint64_t failures = 0;
+
+  for (uint64_t op = 0; op < op_count; op++) {
+    uint64_t random = next_random(&random_state);
+    size_t slot = random & (SLOT_COUNT - 1);
+    size_t size = 16 + ((random >> 32) % 1009);
+
+    bool allocating = (slots[slot] == NULL);
+
+    uint64_t start = now_ns();
+    if (allocating) {
+      slots[slot] = xd_malloc(size);
+    }
+    else {
+      xd_free(slots[slot]);
+      slots[slot] = NULL;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    if (allocating && slots[slot] == NULL) {
+      failures++;
+    }
+    total_ns += elapsed;
+    if (elapsed > worst_ns) {
+      worst_ns = elapsed;
+    }
+    int bucket = (elapsed == 0) ? 0 : 63 - __builtin_clzll(elapsed);
+    histogram[bucket]++;
+  }
+
+  printf("operations:  %" PRIu64 "\n", op_count);
+  printf("mean:        %.1f ns\n",
+         (op_count == 0) ? 0.0 : (double)total_ns / (double)op_count);
+  printf("p99:         < %" PRIu64 " ns\n", percentile_ns(op_count, 0.99));
+  printf("p99.9999:    < %" PRIu64 " ns\n", percentile_ns(op_count, 0.999999));
+  printf("worst case:  %" PRIu64 " ns\n", worst_ns);
+  printf("failures:    %" PRIu64 "\n", failures);
+
+  exit(EXIT_SUCCESS);
+}  // main()
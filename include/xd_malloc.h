@@ -20,6 +20,243 @@
 #include <stdint.h>
 #include <stdio.h>
 
+// ========================
+// Constants
+// ========================
+
+/**
+ * @brief Flag for `xd_malloc_reserve()`, faults in all the pages of the
+ * reserved memory before returning.
+ */
+#define XD_RESERVE_PREFAULT (0x1)
+
+/**
+ * @brief Flag for `xd_malloc_reserve()`, faults in the pages of the reserved
+ * memory using one thread per online CPU (implies `XD_RESERVE_PREFAULT`).
+ */
+#define XD_RESERVE_PREFAULT_PARALLEL (0x2)
+
+/**
+ * @brief The size of a cache line (in bytes), blocks allocated by
+ * `xd_malloc_cacheline()` start on a cache line boundary and span whole cache
+ * lines.
+ */
+#define XD_CACHELINE_SIZE (64)
+
+/**
+ * @brief Thread placement policy for `xd_malloc_thread_policy()`, blocks are
+ * packed next to each other regardless of the allocating thread (default).
+ */
+#define XD_THREAD_POLICY_SHARED (0)
+
+/**
+ * @brief Thread placement policy for `xd_malloc_thread_policy()`, every block
+ * allocated by the thread is placed as if allocated by `xd_malloc_cacheline()`,
+ * so it never shares a cache line with blocks of other threads.
+ */
+#define XD_THREAD_POLICY_CACHELINE (1)
+
+/**
+ * @brief Flag for `xd_shm_heap_open()`, small blocks freed by the process are
+ * cached and reused by it without taking the lock shared with the other
+ * processes, they return to the heap when it is closed.
+ */
+#define XD_SHM_HEAP_CACHE (0x1)
+
+/**
+ * @brief Flag for `xd_iopool_create()`, the buffers are locked into RAM using
+ * `mlock()`, so they never page-fault during I/O.
+ */
+#define XD_IOPOOL_MLOCK (0x1)
+
+/**
+ * @brief Flag for `xd_iopool_create()`, the buffers are placed in huge pages
+ * (reserved ones if available, transparent ones otherwise).
+ */
+#define XD_IOPOOL_HUGEPAGE (0x2)
+
+/**
+ * @brief Lifetime hint for `xd_malloc_hint()`, the block is expected to be
+ * freed soon (such as temporary buffers).
+ */
+#define XD_HINT_SHORT (0x1)
+
+/**
+ * @brief Lifetime hint for `xd_malloc_hint()`, the block is expected to live
+ * for a long time (such as cache entries).
+ */
+#define XD_HINT_LONG (0x2)
+
+/**
+ * @brief Lifetime hint for `xd_malloc_hint()`, the block is expected to live
+ * until the program exits (such as configuration and lookup tables).
+ */
+#define XD_HINT_PERMANENT (0x4)
+
+/**
+ * @brief The largest tag of `xd_malloc_tag_push()`, tags start at `1`.
+ */
+#define XD_TAG_MAX (63)
+
+/**
+ * @brief The magic number at the start of a heap snapshot (see
+ * `xd_malloc_snapshot()`), "XDSNAPSH" in little-endian.
+ */
+#define XD_SNAPSHOT_MAGIC (0x485350414E534458ULL)
+
+/**
+ * @brief The version of the heap snapshot format.
+ */
+#define XD_SNAPSHOT_VERSION (1)
+
+/**
+ * @brief The number of frames of the allocation stack of a sampled block in a
+ * heap snapshot (unused frames are `0`).
+ */
+#define XD_SNAPSHOT_STACK_DEPTH (8)
+
+/**
+ * @brief State of a free block in a heap snapshot.
+ */
+#define XD_SNAPSHOT_BLOCK_FREE (0)
+
+/**
+ * @brief State of an allocated block in a heap snapshot.
+ */
+#define XD_SNAPSHOT_BLOCK_ALLOCATED (1)
+
+/**
+ * @brief State of a block allocated by `xd_halloc()` in a heap snapshot.
+ */
+#define XD_SNAPSHOT_BLOCK_RELOCATABLE (2)
+
+// ========================
+// Types
+// ========================
+
+/**
+ * @brief Handle of a relocatable memory block (see `xd_halloc()`), `0` is
+ * never a valid handle.
+ */
+typedef size_t xd_handle;
+
+/**
+ * @brief A heap created by `xd_heap_create()`.
+ */
+typedef struct xd_heap xd_heap;
+
+/**
+ * @brief Checkpoint of the calling thread's allocations (see
+ * `xd_heap_mark()`).
+ */
+typedef struct xd_mark {
+  size_t top;    // The top of the thread's stage region when taken
+  size_t depth;  // The number of marks active before this one
+} xd_mark;
+
+/**
+ * @brief A persistent heap backed by a file (see `xd_pheap_open()`).
+ */
+typedef struct xd_pheap xd_pheap;
+
+/**
+ * @brief A pool of page-aligned I/O buffers (see `xd_iopool_create()`).
+ */
+typedef struct xd_iopool xd_iopool;
+
+/**
+ * @brief A contiguous region backing the buffers of an I/O buffer pool (see
+ * `xd_iopool_regions()`), laid out like `struct iovec`.
+ */
+typedef struct xd_iopool_region {
+  void *base;   // The start of the region
+  size_t size;  // The size of the region (in bytes)
+} xd_iopool_region;
+
+/**
+ * @brief A memory pressure callback (see `xd_malloc_pressure_callback_add()`).
+ *
+ * @param bytes The number of bytes the heap is about to grow past the soft
+ * limit by.
+ * @param arg The argument passed when registering the callback.
+ */
+typedef void (*xd_pressure_callback)(size_t bytes, void *arg);
+
+/**
+ * @brief A hook called when entering reserve mode (see
+ * `xd_malloc_set_reserve_hook()`).
+ *
+ * @param size The size of the allocation served by the emergency reserve.
+ * @param arg The argument passed when setting the hook.
+ */
+typedef void (*xd_reserve_hook)(size_t size, void *arg);
+
+/**
+ * @brief A heap quota callback (see `xd_heap_set_quota()`).
+ *
+ * @param heap The heap that hit its quota.
+ * @param bytes The number of bytes the heap is about to exceed its quota by.
+ * @param arg The argument passed when setting the quota.
+ */
+typedef void (*xd_quota_callback)(xd_heap *heap, size_t bytes, void *arg);
+
+/**
+ * @brief The memory usage of a heap (see `xd_heap_get_usage()`).
+ */
+typedef struct xd_heap_usage {
+  size_t quota;      // The quota of the heap (in bytes), `0` if none
+  size_t mapped;     // The size of the chunks mapped by the heap (in bytes)
+  size_t allocated;  // The size of the allocated blocks (in bytes)
+} xd_heap_usage;
+
+/**
+ * @brief The statistics of a tag (see `xd_malloc_tag_stats()`).
+ */
+typedef struct xd_tag_stats {
+  size_t live_bytes;    // The size of the live blocks (in bytes)
+  size_t live_blocks;   // The number of live blocks
+  size_t total_bytes;   // The size of all the blocks allocated (in bytes)
+  size_t total_blocks;  // The number of all the blocks allocated
+} xd_tag_stats;
+
+/**
+ * @brief The header of a heap snapshot (see `xd_malloc_snapshot()`), followed
+ * by `block_count` `xd_snapshot_block` then `sample_count`
+ * `xd_snapshot_sample` records (in the byte order of the process).
+ */
+typedef struct xd_snapshot_header {
+  uint64_t magic;          // `XD_SNAPSHOT_MAGIC`
+  uint32_t version;        // `XD_SNAPSHOT_VERSION`
+  uint32_t stack_depth;    // `XD_SNAPSHOT_STACK_DEPTH`
+  uint64_t sample_period;  // The lifetime prediction sample period
+  uint64_t block_count;    // The number of block records
+  uint64_t sample_count;   // The number of sample records
+} xd_snapshot_header;
+
+/**
+ * @brief A block of a heap snapshot, the blocks of each heap are in address
+ * order.
+ */
+typedef struct xd_snapshot_block {
+  uint64_t address;  // The address of the block's data
+  uint64_t size;     // The size of the block's data (in bytes)
+  uint32_t state;    // One of the `XD_SNAPSHOT_BLOCK_*` states
+  uint32_t tag;      // The tag of the block (see `xd_malloc_tag_push()`)
+} xd_snapshot_block;
+
+/**
+ * @brief A live block sampled by lifetime prediction in a heap snapshot.
+ */
+typedef struct xd_snapshot_sample {
+  uint64_t address;  // The address of the block's data
+  uint64_t size;     // The size of the block's data (in bytes)
+  uint64_t stack[XD_SNAPSHOT_STACK_DEPTH];  // The allocation stack
+} xd_snapshot_sample;
+
+// ========================
+// Functions
+// ========================
+
 /**
  * @brief Allocates a block of memory of the passed size.
  *
@@ -75,9 +312,887 @@ void *xd_calloc(size_t n, size_t size);
  * `xd_malloc(size)`.
  * @note If the passed size is `0`, this function behaves like `xd_free(ptr)`
  * and returns `NULL`.
+ * @note A moved block keeps the tag of the block (see `xd_malloc_tag_push()`),
+ * whatever tag is current.
  */
 void *xd_realloc(void *ptr, size_t size);
 
+/**
+ * @brief Grows the heap up front so that a free block of at least the passed
+ * size is available, moving the cost of heap growth (and optionally page
+ * faults) out of later `xd_malloc()` calls.
+ *
+ * @param bytes The size of the free block to be reserved (in bytes).
+ * @param flags Bitwise OR of `XD_RESERVE_*` flags, or `0`.
+ *
+ * @return `0` on success, or `-1` on failure.
+ *
+ * @note If the heap cannot be grown, `errno` is set to `ENOMEM` and `-1` is
+ * returned.
+ */
+int xd_malloc_reserve(size_t bytes, int flags);
+
+/**
+ * @brief Allocates a block of memory of the passed size that starts on a cache
+ * line boundary and whose size is rounded up to whole cache lines, so it never
+ * shares a cache line with another block (no false sharing).
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on
+ * failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `NULL` is returned.
+ * @note If the passed `size` is 0, `NULL` is returned.
+ * @note The block is freed using `xd_free()`.
+ */
+void *xd_malloc_cacheline(size_t size);
+
+/**
+ * @brief Sets the placement policy of the calling thread's allocations, used to
+ * keep small objects of different threads (such as per-thread counters) from
+ * sharing a cache line.
+ *
+ * @param policy One of the `XD_THREAD_POLICY_*` constants.
+ *
+ * @return The previous policy of the calling thread on success, or `-1` on
+ * failure.
+ *
+ * @note If the passed policy is invalid, `errno` is set to `EINVAL` and `-1` is
+ * returned.
+ * @note Under `XD_THREAD_POLICY_CACHELINE` every block takes at least one cache
+ * line, so it is meant for threads allocating shared-written objects.
+ */
+int xd_malloc_thread_policy(int policy);
+
+/**
+ * @brief Allocates a block of memory of the passed size, placing it with the
+ * blocks of the same expected lifetime.
+ *
+ * Every lifetime class has a heap of its own (separate from the heap used by
+ * `xd_malloc()`), so short-lived blocks coalesce freely without being pinned by
+ * long-lived blocks, and long-lived blocks are packed densely.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ * @param hint One of `XD_HINT_SHORT`, `XD_HINT_LONG` or `XD_HINT_PERMANENT`.
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on
+ * failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `NULL` is returned.
+ * @note If the passed `size` is 0, `NULL` is returned.
+ * @note The hint is advisory, with an unknown hint (or in real-time mode) this
+ * function behaves like `xd_malloc(size)`.
+ * @note The block is freed using `xd_free()`, and `xd_realloc()` keeps it in
+ * its lifetime class.
+ */
+void *xd_malloc_hint(size_t size, int hint);
+
+/**
+ * @brief Enables (or disables) automatic lifetime prediction, in which the
+ * lifetime of sampled `xd_malloc()`, `xd_calloc()` and `xd_realloc()` blocks is
+ * measured per call site, and the blocks of sites that are consistently
+ * short-lived (or long-lived) are placed as if allocated by `xd_malloc_hint()`.
+ *
+ * A block lives short if freed within 1 ms, and long if it lives at least 1 s,
+ * a site is predicted once 8 of its blocks are sampled and at least 90% of them
+ * agree.
+ *
+ * @param sample_period One of every `sample_period` allocations of a thread is
+ * sampled, or `0` to disable prediction (default).
+ *
+ * @note Allocations that are not sampled only decrement a thread-local counter
+ * and look up the prediction of their call site without locking.
+ * @note Predictions made while enabled are kept after disabling, but no longer
+ * used.
+ */
+void xd_malloc_lifetime_prediction(size_t sample_period);
+
+/**
+ * @brief Allocates a block of memory of the passed size for rarely used data
+ * (such as metadata that is only read on errors), placing it in a heap of its
+ * own so it doesn't dilute the pages of frequently used blocks.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on
+ * failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `NULL` is returned.
+ * @note If the passed `size` is 0, `NULL` is returned.
+ * @note In real-time mode this function behaves like `xd_malloc(size)`.
+ * @note The block is freed using `xd_free()`, and `xd_realloc()` keeps it in
+ * the cold heap.
+ */
+void *xd_malloc_cold(size_t size);
+
+/**
+ * @brief Advises the kernel that the pages of the cold heap (see
+ * `xd_malloc_cold()`) are unlikely to be used soon.
+ *
+ * Under memory pressure (as reported by `/proc/pressure/memory`) the pages are
+ * reclaimed right away (`MADV_PAGEOUT`), otherwise they are only moved to the
+ * inactive list (`MADV_COLD`) so they are reclaimed first. The contents of the
+ * blocks are kept either way.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set.
+ *
+ * @note Meant to be called periodically, or after the cold data is set up.
+ */
+int xd_heap_mark_cold(void);
+
+/**
+ * @brief Allocates a block of memory of the passed size that can be mapped by
+ * another process, so large buffers are passed between processes without
+ * copying them.
+ *
+ * The block is placed in a memfd of its own, rounded up to whole pages, so the
+ * descriptor exposes no other block. The receiving process gets the descriptor
+ * (through `SCM_RIGHTS` or by inheriting it) and maps it using
+ * `mmap(NULL, len, prot, MAP_SHARED, fd, 0)`, the block then starts `offset`
+ * bytes into the mapping.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ * @param fd Pointer to where the descriptor of the memfd is stored.
+ * @param offset Pointer to where the offset of the block in the memfd is
+ * stored.
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on
+ * failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `NULL` is returned.
+ * @note If the passed `size` is 0, `NULL` is returned.
+ * @note In real-time mode this function fails with `ENOMEM`.
+ * @note The block is freed using `xd_free()`, which closes the descriptor.
+ * The descriptor belongs to the allocator and must not be closed, each block
+ * holds one open descriptor.
+ * @note `xd_realloc()` keeps the block shareable, the block stays in its memfd
+ * while the new size fits it, otherwise it moves to a new memfd (see
+ * `xd_shareable_info()`).
+ * @note The block is not mapped in child processes forked after it was
+ * allocated, a child maps the inherited descriptor like any other receiving
+ * process (it may close it).
+ */
+void *xd_malloc_shareable(size_t size, int *fd, size_t *offset);
+
+/**
+ * @brief Returns the memfd and offset of a block of `xd_malloc_shareable()`,
+ * such as after it was moved by `xd_realloc()`.
+ *
+ * @param ptr Pointer to the block.
+ * @param fd Pointer to where the descriptor of the memfd is stored.
+ * @param offset Pointer to where the offset of the block in the memfd is
+ * stored.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `EINVAL` if the block
+ * isn't shareable (or an argument is `NULL`).
+ */
+int xd_shareable_info(const void *ptr, int *fd, size_t *offset);
+
+/**
+ * @brief Creates a pool of fixed-size, page-aligned buffers for direct I/O
+ * (`O_DIRECT`) and `io_uring` registered buffers.
+ *
+ * The buffers are carved from dedicated chunks of `count` buffers each, mapped
+ * as needed. Buffers put back by a thread are reused by it without locking.
+ *
+ * @param buffer_size The size of each buffer (in bytes), rounded up to a
+ * multiple of the page size.
+ * @param count The number of buffers per chunk, the first chunk is mapped right
+ * away.
+ * @param flags `0`, or a combination of `XD_IOPOOL_MLOCK` and
+ * `XD_IOPOOL_HUGEPAGE`.
+ *
+ * @return A pointer to the pool, or `NULL` on failure with `errno` set
+ * (`EINVAL` if `buffer_size` or `count` is `0`).
+ */
+xd_iopool *xd_iopool_create(size_t buffer_size, size_t count, int flags);
+
+/**
+ * @brief Destroys an I/O buffer pool, unmapping all its buffers.
+ *
+ * @param pool Pointer to the pool, if `NULL`, no operation is performed.
+ *
+ * @note No buffer of the pool may be in use by any thread.
+ */
+void xd_iopool_destroy(xd_iopool *pool);
+
+/**
+ * @brief Gets a buffer from an I/O buffer pool, mapping a new chunk if all the
+ * buffers are in use.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return A pointer to the buffer, aligned to the page size, or `NULL` on
+ * failure with `errno` set to `ENOMEM`.
+ *
+ * @note The contents of the buffer are undefined.
+ */
+void *xd_iopool_get(xd_iopool *pool);
+
+/**
+ * @brief Puts a buffer back into the I/O buffer pool it was taken from.
+ *
+ * @param pool Pointer to the pool.
+ * @param buffer Pointer to the buffer, if `NULL`, no operation is performed.
+ */
+void xd_iopool_put(xd_iopool *pool, void *buffer);
+
+/**
+ * @brief Returns the contiguous regions backing the buffers of an I/O buffer
+ * pool, to be registered with `io_uring` (as an array of `struct iovec`).
+ *
+ * @param pool Pointer to the pool.
+ * @param regions Pointer to where the regions are stored.
+ * @param max_regions The capacity of `regions`.
+ *
+ * @return The number of regions of the pool, only the first `max_regions` of
+ * them are stored.
+ *
+ * @note Regions are only added when the pool grows, so the registration stays
+ * valid as long as `count` buffers per region are enough.
+ */
+size_t xd_iopool_regions(xd_iopool *pool, xd_iopool_region *regions,
+                         size_t max_regions);
+
+/**
+ * @brief Sets the memory limit the allocator keeps the memory usage under.
+ *
+ * By default the limit is the `memory.max` of the process's cgroup v2, read at
+ * startup. As the heaps grow, the usage (the cgroup's `memory.current`, or the
+ * resident set size of the process) is checked against the limit:
+ * - Above 75% of the limit, the pre-zeroed pool of `xd_calloc()` is emptied and
+ *   no longer refilled, and the usage is checked more often.
+ * - Above 90% of the limit, the free pages of all heaps are returned to the OS
+ *   (see `xd_malloc_purge()`).
+ *
+ * @param limit The memory limit (in bytes), or `0` to read the `memory.max` of
+ * the cgroup again.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `ENOENT` if `limit` is
+ * `0` and the cgroup has no memory limit (the limit is then removed).
+ */
+int xd_malloc_memory_limit(size_t limit);
+
+/**
+ * @brief Returns the free memory held by the allocator to the OS: empties the
+ * pre-zeroed pool, frees the calling thread's deferred blocks that are safe to
+ * free, shrinks the heap break, and releases the whole free pages of all heaps
+ * (they are zero-filled when touched again).
+ *
+ * @return The number of bytes returned to the OS.
+ *
+ * @note Does nothing in real-time mode, whose pages stay locked.
+ */
+size_t xd_malloc_purge(void);
+
+/**
+ * @brief Sets a soft limit on the size of the heap used by `xd_malloc()`.
+ *
+ * Before an allocation that may grow the heap past the limit, the free memory
+ * is returned to the OS (see `xd_malloc_purge()`), and if growing still
+ * crosses the limit, the registered memory pressure callbacks are called so
+ * the application can shed cached data. The heap then grows as needed (the
+ * limit is soft), unless enough memory was freed. Pressure is relieved again
+ * only once the size of the heap changed.
+ *
+ * @param bytes The soft limit (in bytes), `0` to remove it.
+ */
+void xd_malloc_set_soft_limit(size_t bytes);
+
+/**
+ * @brief Registers a callback called when the heap is about to grow past the
+ * soft limit (see `xd_malloc_set_soft_limit()`), callbacks are called in
+ * registration order.
+ *
+ * @param callback The callback, it may allocate and free memory.
+ * @param arg The argument passed to the callback.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set (`EINVAL` if
+ * `callback` is `NULL`, `ENOMEM` if 16 callbacks are already registered).
+ */
+int xd_malloc_pressure_callback_add(xd_pressure_callback callback, void *arg);
+
+/**
+ * @brief Unregisters a callback registered by
+ * `xd_malloc_pressure_callback_add()`.
+ *
+ * @param callback The callback.
+ * @param arg The argument it was registered with.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `ENOENT` if it is not
+ * registered.
+ */
+int xd_malloc_pressure_callback_remove(xd_pressure_callback callback,
+                                       void *arg);
+
+/**
+ * @brief Adds pre-mapped (and faulted in) memory to the emergency reserve.
+ *
+ * The reserve serves `xd_malloc()`, `xd_calloc()` and `xd_realloc()` only after
+ * the heap failed to grow, so the error paths of the application can still
+ * allocate to log and unwind. The allocator is in reserve mode while blocks of
+ * the reserve are allocated, `xd_realloc()` moves them out of it when possible.
+ *
+ * @param bytes The number of bytes to add to the reserve.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `ENOMEM` on failure.
+ *
+ * @note The allocations of heaps set by `xd_heap_push_current()` and of marks
+ * don't use the reserve.
+ */
+int xd_malloc_emergency_reserve(size_t bytes);
+
+/**
+ * @brief Sets the hook called when the allocator enters reserve mode (see
+ * `xd_malloc_emergency_reserve()`), so the application can shed load.
+ *
+ * @param hook The hook (`NULL` to remove it), it is called by the allocating
+ * thread and may allocate memory.
+ * @param arg The argument passed to the hook.
+ */
+void xd_malloc_set_reserve_hook(xd_reserve_hook hook, void *arg);
+
+/**
+ * @brief Returns whether the allocator is in reserve mode, i.e. blocks of the
+ * emergency reserve are allocated (see `xd_malloc_emergency_reserve()`).
+ *
+ * @return `1` if in reserve mode, `0` otherwise.
+ */
+int xd_malloc_in_reserve_mode(void);
+
+/**
+ * @brief Makes the passed tag current on the calling thread, blocks allocated
+ * while it is current are counted in its statistics until freed (such as a tag
+ * per subsystem).
+ *
+ * @param tag The tag, from `1` to `XD_TAG_MAX`.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set (`EINVAL` if the
+ * tag is out of range, `EOVERFLOW` if 16 tags are already pushed).
+ *
+ * @note Tagged blocks have a record in a side table, allocations without a
+ * current tag only check a thread-local variable.
+ * @note The blocks of `xd_malloc_group()`, `xd_malloc_reserve_blocks()`,
+ * `xd_malloc_shareable()`, `xd_halloc()` and marks (see `xd_heap_mark()`) are
+ * not tagged.
+ */
+int xd_malloc_tag_push(unsigned int tag);
+
+/**
+ * @brief Makes the tag replaced by the last `xd_malloc_tag_push()` current on
+ * the calling thread again.
+ *
+ * @note If no tag was pushed this function will do nothing.
+ */
+void xd_malloc_tag_pop(void);
+
+/**
+ * @brief Gets the statistics of a tag, the allocation rate is the change of
+ * the totals between two calls.
+ *
+ * @param tag The tag, from `1` to `XD_TAG_MAX`.
+ * @param stats Pointer to the statistics to be filled.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `EINVAL` if the tag is
+ * out of range or `stats` is `NULL`.
+ */
+int xd_malloc_tag_stats(unsigned int tag, xd_tag_stats *stats);
+
+/**
+ * @brief Enables leak detection: the allocation stacks of the blocks sampled by
+ * lifetime prediction (see `xd_malloc_lifetime_prediction()`) are recorded,
+ * and a leak report is written when the program exits (see
+ * `xd_malloc_leak_report()`).
+ *
+ * @param out The stream the report is written to, or `NULL` to disable leak
+ * detection.
+ *
+ * @note Only sampled allocations capture their stack, the others cost nothing
+ * more.
+ */
+void xd_malloc_leak_detection(FILE *out);
+
+/**
+ * @brief Writes a leak report: the size and number of the blocks still
+ * allocated in all heaps, followed by the largest allocation stacks of the
+ * live sampled blocks, scaled by the sample period.
+ *
+ * The stacks are printed as return addresses (to be resolved using
+ * `addr2line`), or as the call site alone if leak detection is disabled (see
+ * `xd_malloc_leak_detection()`). Blocks of marks (see `xd_heap_mark()`) and the
+ * allocator's own structures (such as the heaps of `xd_heap_create()`) are not
+ * counted.
+ *
+ * @param out The stream the report is written to.
+ *
+ * @return The size of the blocks still allocated (in bytes).
+ *
+ * @note The allocator is locked while the heaps are walked.
+ */
+size_t xd_malloc_leak_report(FILE *out);
+
+/**
+ * @brief Writes a binary snapshot of all heaps: every block (its address, size,
+ * state and tag) and the live blocks sampled by lifetime prediction (with
+ * their allocation stacks if leak detection is enabled, see
+ * `xd_malloc_leak_detection()`).
+ *
+ * Snapshots taken some time apart are compared offline by the
+ * `xd_snapshot_diff` tool (see `tools/`). The format is described by
+ * `xd_snapshot_header`.
+ *
+ * @param out The stream the snapshot is written to.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `ENOMEM` if the buffer of
+ * the snapshot couldn't be mapped or to `EIO` if writing failed.
+ *
+ * @note The allocator is locked only while the snapshot is copied to a buffer,
+ * it is written afterwards, so `out` may be a pipe read by another thread.
+ * Blocks of marks (see `xd_heap_mark()`) and the allocator's own structures are
+ * not included.
+ */
+int xd_malloc_snapshot(FILE *out);
+
+/**
+ * @brief Allocates a group of memory blocks of the passed sizes that are placed
+ * next to each other in a single piece of the heap, so objects that are always
+ * used together (such as a node and its key and value buffers) share cache
+ * lines and pages.
+ *
+ * @param sizes The sizes of the memory blocks to be allocated (in bytes).
+ * @param n The number of memory blocks.
+ * @param out_ptrs Array of `n` pointers, set to the allocated blocks in the
+ * order of `sizes` (in increasing address order).
+ *
+ * @return `0` on success, or `-1` on failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `-1` is returned, no block is allocated.
+ * @note If any of the passed sizes is 0, or `sizes` or `out_ptrs` is `NULL`
+ * while `n` isn't 0, `errno` is set to `EINVAL` and `-1` is returned.
+ * @note The blocks are placed in the current heap (see
+ * `xd_heap_push_current()`) if any, otherwise in the main heap.
+ * @note Every block is freed individually using `xd_free()`.
+ */
+int xd_malloc_group(const size_t *sizes, size_t n, void **out_ptrs);
+
+/**
+ * @brief Takes a checkpoint of the calling thread's allocations, until it is
+ * released every block allocated by the thread using `xd_malloc()`,
+ * `xd_calloc()` or `xd_realloc()` is placed at the top of a stage region of the
+ * thread instead of the heap.
+ *
+ * @return The checkpoint to be passed to `xd_heap_release_to()`.
+ *
+ * @note Marks nest, the thread's allocations return to the heap once the first
+ * active mark is released.
+ * @note Freeing a block of the stage region using `xd_free()` does nothing, the
+ * space is only reclaimed by `xd_heap_release_to()`.
+ * @note A stage region may grow with a system call, so it is not meant for
+ * real-time threads.
+ */
+xd_mark xd_heap_mark(void);
+
+/**
+ * @brief Frees every block the calling thread allocated since the passed mark
+ * in one operation, by resetting the top of its stage region. Blocks allocated
+ * before the mark stay valid.
+ *
+ * @param mark A checkpoint returned by `xd_heap_mark()` on the calling thread,
+ * marks taken after it are released too.
+ *
+ * @note Releasing a mark that was already released does nothing.
+ * @note Blocks allocated before the mark stay in their heap when they are moved
+ * by `xd_realloc()` after it, only the blocks of the stage region are moved
+ * within it.
+ */
+void xd_heap_release_to(xd_mark mark);
+
+/**
+ * @brief Creates an empty heap, to be made current using
+ * `xd_heap_push_current()` (such as a heap per coroutine or task).
+ *
+ * @return A pointer to the heap on success, or `NULL` on failure.
+ *
+ * @note If the heap cannot be created due to lack of memory, `errno` is set to
+ * `ENOMEM` and `NULL` is returned.
+ */
+xd_heap *xd_heap_create(void);
+
+/**
+ * @brief Destroys a heap created by `xd_heap_create()`, freeing all its blocks
+ * in one operation.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @note The heap must not be current on any thread, and its blocks must not be
+ * used (or freed) afterwards.
+ * @note If the passed pointer is `NULL` this function will do nothing.
+ */
+void xd_heap_destroy(xd_heap *heap);
+
+/**
+ * @brief Sets a quota on the memory a heap created by `xd_heap_create()` maps
+ * for its chunks.
+ *
+ * When growing the heap would exceed the quota, the callback (if any) is
+ * called so the application can free blocks of the heap or raise the quota.
+ * If the heap still can't grow, the allocation fails with `errno` set to
+ * `ENOMEM`.
+ *
+ * @param heap Pointer to the heap.
+ * @param bytes The quota (in bytes), `0` to remove it. A quota below the mapped
+ * size only prevents the heap from growing.
+ * @param callback The callback (`NULL` if none), it is called by the
+ * allocating thread without holding the heap's mutex, and the allocations it
+ * makes from the heap fail instead of calling it again.
+ * @param arg The argument passed to the callback.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `EINVAL` if `heap` is
+ * `NULL`.
+ */
+int xd_heap_set_quota(xd_heap *heap, size_t bytes, xd_quota_callback callback,
+                      void *arg);
+
+/**
+ * @brief Reports the memory usage of a heap created by `xd_heap_create()`.
+ *
+ * @param heap Pointer to the heap.
+ * @param usage Pointer to the usage to be filled.
+ *
+ * @return `0` on success, or `-1` with `errno` set to `EINVAL` if `heap` or
+ * `usage` is `NULL`.
+ */
+int xd_heap_get_usage(xd_heap *heap, xd_heap_usage *usage);
+
+/**
+ * @brief Makes the passed heap current on the calling thread, its blocks
+ * allocated by `xd_malloc()`, `xd_calloc()`, `xd_realloc()` and
+ * `xd_malloc_group()` are then placed in that heap until the matching
+ * `xd_heap_pop_current()`.
+ *
+ * Switching heaps only updates thread-local state, so a coroutine runtime can
+ * push the task's heap when resuming it and pop it when suspending it. The
+ * blocks of the heap can be freed using `xd_free()` from any thread.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @return `0` on success, or `-1` on failure.
+ *
+ * @note If the passed heap is `NULL`, `errno` is set to `EINVAL` and `-1` is
+ * returned.
+ * @note At most 16 heaps can be pushed on a thread at the same time, otherwise
+ * `errno` is set to `EOVERFLOW` and `-1` is returned.
+ * @note An active mark (see `xd_heap_mark()`) takes precedence over the
+ * current heap.
+ */
+int xd_heap_push_current(xd_heap *heap);
+
+/**
+ * @brief Restores the heap that was current on the calling thread before the
+ * last `xd_heap_push_current()`.
+ *
+ * @note If no heap was pushed this function will do nothing.
+ */
+void xd_heap_pop_current(void);
+
+/**
+ * @brief Enters a read-side critical section of the calling thread, blocks
+ * passed to `xd_free_deferred()` by any thread after this call are not freed
+ * until the matching `xd_epoch_exit()`.
+ *
+ * @note Critical sections nest, and are meant to be short (such as a single
+ * lookup in a lock-free hash map).
+ */
+void xd_epoch_enter(void);
+
+/**
+ * @brief Exits a read-side critical section entered using `xd_epoch_enter()`,
+ * the calling thread must not use pointers read inside it afterwards.
+ */
+void xd_epoch_exit(void);
+
+/**
+ * @brief Frees a block once every thread that may still be reading it has left
+ * its critical section (see `xd_epoch_enter()`), used to reclaim nodes removed
+ * from lock-free data structures.
+ *
+ * The block is parked without being written, and the calling thread frees its
+ * parked blocks in batches every 64 calls, once the global epoch has advanced
+ * twice since they were parked.
+ *
+ * @param ptr The pointer to the memory block to be freed.
+ *
+ * @note If the passed pointer is `NULL` this function will do nothing.
+ * @note Blocks parked by a thread that exits are freed by the next thread that
+ * uses epochs.
+ */
+void xd_free_deferred(void *ptr);
+
+/**
+ * @brief Attempts to advance the global epoch and frees the parked blocks of
+ * the calling thread that are safe to free, without waiting for the next
+ * batch.
+ *
+ * @return The number of blocks freed.
+ */
+size_t xd_epoch_reclaim(void);
+
+/**
+ * @brief Allocates a relocatable block of memory of the passed size, which the
+ * allocator may move while it is not locked to reduce fragmentation (see
+ * `xd_heap_compact()`).
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return The handle of the block on success, or `0` on failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `0` is returned.
+ * @note If the passed `size` is 0, `0` is returned.
+ * @note The block must be accessed only between `xd_hlock()` and
+ * `xd_hunlock()`, and freed using `xd_hfree()` (not `xd_free()`).
+ */
+xd_handle xd_halloc(size_t size);
+
+/**
+ * @brief Pins a relocatable block in place and returns its address.
+ *
+ * @param handle The handle of the block.
+ *
+ * @return A pointer to the block's memory, or `NULL` if the handle is invalid.
+ *
+ * @note Locks nest, the block may move again once every `xd_hlock()` call is
+ * matched by an `xd_hunlock()` call, and pointers into it must not be used
+ * after that.
+ */
+void *xd_hlock(xd_handle handle);
+
+/**
+ * @brief Releases a lock taken by `xd_hlock()` on a relocatable block.
+ *
+ * @param handle The handle of the block.
+ */
+void xd_hunlock(xd_handle handle);
+
+/**
+ * @brief Frees a relocatable block (locked or not), the handle becomes invalid
+ * and may be returned by a later `xd_halloc()`.
+ *
+ * @param handle The handle of the block.
+ *
+ * @note If the passed handle is `0` this function will do nothing.
+ */
+void xd_hfree(xd_handle handle);
+
+/**
+ * @brief Runs an incremental compaction pass over the heap, sliding unlocked
+ * relocatable blocks toward the start of the heap so the free space between
+ * them coalesces, then returns the free space at the top of the heap to the
+ * OS.
+ *
+ * @param max_bytes The number of bytes after which the pass stops moving
+ * blocks, `SIZE_MAX` to compact the whole heap.
+ *
+ * @return The number of bytes moved, `0` once there is nothing left to move.
+ *
+ * @note Blocks returned by `xd_malloc()` never move, so they limit how much the
+ * free space can be coalesced.
+ */
+size_t xd_heap_compact(size_t max_bytes);
+
+/**
+ * @brief Opens a persistent heap backed by the file at the passed path,
+ * creating and formatting the file if it doesn't exist (or is empty).
+ *
+ * The file is mapped shared, so blocks allocated from the heap and their
+ * contents survive a restart of the process, which reopens the file and finds
+ * its data through the root block (see `xd_pheap_set_root()`) instead of
+ * rebuilding it.
+ *
+ * @param path The path of the file.
+ * @param size The size of the heap (in bytes), ignored if the file exists.
+ *
+ * @return A pointer to the opened heap, or `NULL` on failure with `errno` set
+ * (`EBUSY` if another process has the file open, `EINVAL` if the file is not a
+ * persistent heap).
+ *
+ * @note The heap doesn't grow, allocations fail with `ENOMEM` once it is full.
+ * @note The file is mapped at its previous address when possible. Links
+ * between blocks should be stored as offsets (see `xd_pheap_offset()`) unless
+ * pointers are known to stay valid.
+ */
+xd_pheap *xd_pheap_open(const char *path, size_t size);
+
+/**
+ * @brief Opens a heap in shared memory that multiple processes allocate from
+ * and free to concurrently, creating and formatting it if it doesn't exist.
+ *
+ * The heap uses the same functions as a persistent heap (`xd_pheap_malloc()`,
+ * `xd_pheap_free()`, `xd_pheap_root()`, ...). Its free list is protected by a
+ * process-shared robust mutex, so a process dying while allocating doesn't
+ * block the others: the next process to lock it rebuilds the free list from
+ * the blocks (a block being allocated or freed by the dead process may be
+ * lost). If the blocks are inconsistent, the heap becomes unusable and
+ * allocations fail with `ENOTRECOVERABLE`. Since each process maps the heap at
+ * its own address, links between blocks must be stored as offsets (see
+ * `xd_pheap_offset()`).
+ *
+ * @param name The name of the POSIX shared memory object (see `shm_open()`), or
+ * `NULL` for an anonymous heap (backed by `memfd_create()`) shared with the
+ * child processes forked after it is opened.
+ * @param size The size of the heap (in bytes), ignored if the heap exists.
+ * @param flags `0` or `XD_SHM_HEAP_CACHE`.
+ *
+ * @return A pointer to the opened heap, or `NULL` on failure with `errno` set
+ * (`EINVAL` if the object is not a shared heap).
+ *
+ * @note Close the heap using `xd_pheap_close()`, and remove a named heap using
+ * `shm_unlink()` once no process needs it.
+ */
+xd_pheap *xd_shm_heap_open(const char *name, size_t size, int flags);
+
+/**
+ * @brief Flushes a persistent heap to its file and closes it, or closes a
+ * shared heap, returning the blocks cached by the calling process.
+ *
+ * @param pheap Pointer to the heap, if `NULL`, no operation is performed.
+ *
+ * @return `0` on success, or `-1` if flushing failed with `errno` set.
+ */
+int xd_pheap_close(xd_pheap *pheap);
+
+/**
+ * @brief Allocates a block of memory of the passed size from a persistent
+ * heap.
+ *
+ * @param pheap Pointer to the heap.
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory block, or `NULL` if size is `0` or
+ * on failure.
+ *
+ * @note If the heap is full, `errno` is set to `ENOMEM` and `NULL` is returned.
+ * @note If a shared heap is unusable, `errno` is set to `ENOTRECOVERABLE` (see
+ * `xd_shm_heap_open()`).
+ */
+void *xd_pheap_malloc(xd_pheap *pheap, size_t size);
+
+/**
+ * @brief Frees a memory block allocated by `xd_pheap_malloc()`.
+ *
+ * @param pheap Pointer to the heap the block was allocated from.
+ * @param ptr Pointer to the memory block, if `NULL`, no operation is performed.
+ *
+ * @note Double free is detected and causes abort, except for blocks held in
+ * the cache of a shared heap (see `XD_SHM_HEAP_CACHE`).
+ */
+void xd_pheap_free(xd_pheap *pheap, void *ptr);
+
+/**
+ * @brief Returns the root block of a persistent heap.
+ *
+ * @param pheap Pointer to the heap.
+ *
+ * @return A pointer to the root block, or `NULL` if none was set.
+ */
+void *xd_pheap_root(xd_pheap *pheap);
+
+/**
+ * @brief Sets the root block of a persistent heap, the entry point to its data
+ * after it is reopened.
+ *
+ * @param pheap Pointer to the heap.
+ * @param ptr Pointer to a block allocated by `xd_pheap_malloc()`, or `NULL`.
+ */
+void xd_pheap_set_root(xd_pheap *pheap, void *ptr);
+
+/**
+ * @brief Converts a pointer into a persistent heap to its offset from the start
+ * of the heap, which stays valid wherever the heap is mapped.
+ *
+ * @param pheap Pointer to the heap.
+ * @param ptr Pointer into the heap.
+ *
+ * @return The offset of the pointer.
+ */
+size_t xd_pheap_offset(const xd_pheap *pheap, const void *ptr);
+
+/**
+ * @brief Converts an offset returned by `xd_pheap_offset()` back to a pointer.
+ *
+ * @param pheap Pointer to the heap.
+ * @param offset The offset.
+ *
+ * @return The pointer at the offset into the heap.
+ */
+void *xd_pheap_pointer(const xd_pheap *pheap, size_t offset);
+
+/**
+ * @brief Pre-splits free blocks of the passed size and places them at the
+ * front of the free list, so that the next `count` allocations of that size
+ * are served without searching or splitting.
+ *
+ * @param size The size of each block (in bytes).
+ * @param count The number of blocks to be pre-split.
+ *
+ * @return `0` on success, or `-1` on failure.
+ *
+ * @note If the heap cannot be grown, `errno` is set to `ENOMEM` and `-1` is
+ * returned.
+ * @note Call it once per size class to warm up several size classes.
+ */
+int xd_malloc_reserve_blocks(size_t size, size_t count);
+
+/**
+ * @brief Switches the allocator to real-time mode, in which allocations never
+ * page-fault or make system calls:
+ * - The heap is grown by the passed size and all its pages are locked into RAM
+ *   using `mlock()`.
+ * - The heap only grows through `xd_malloc_reserve()` (the new pages are
+ *   locked too), otherwise `xd_malloc()` fails with `ENOMEM` when no free block
+ *   is large enough.
+ * - Free blocks are kept in segregated lists by power-of-two size, so
+ *   `xd_malloc()` and `xd_free()` take constant time.
+ * - The allocator mutex uses priority inheritance.
+ *
+ * @param bytes The size of the free block to be reserved (in bytes).
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set.
+ *
+ * @note Must be called before other threads start using the allocator, since
+ * the allocator mutex is re-initialized.
+ * @note Real-time mode cannot be disabled once enabled, calling this function
+ * again only reserves more memory.
+ */
+int xd_malloc_rt_enable(size_t bytes);
+
+/**
+ * @brief Starts a background thread that keeps a pool of pre-zeroed (and
+ * pre-faulted) blocks in power-of-two size bands from 4 KB to 1 MB.
+ *
+ * Large `xd_calloc()` requests are then served from the pool, moving the cost
+ * of zeroing and page faults off the calling thread. Requests that find their
+ * band empty are zeroed synchronously as usual.
+ *
+ * @return `0` on success (or if the pool is already running), or `-1` on
+ * failure with `errno` set.
+ */
+int xd_calloc_pool_start(void);
+
+/**
+ * @brief Stops the pre-zeroed pool thread and returns the pooled blocks to the
+ * heap.
+ *
+ * @note Called automatically on exit.
+ */
+void xd_calloc_pool_stop(void);
+
 /**
  * @brief Dumps all memory block headers in a specified range of the heap to the
  * passed output stream.
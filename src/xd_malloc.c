@@ -13,9 +13,14 @@
  * ==============================================================================
  */
 
+// for `mremap()` and `MADV_*` extensions
+#define _GNU_SOURCE
+
 #include "xd_malloc.h"
 
 #include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdbool.h>
@@ -23,6 +28,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 // ========================
@@ -61,710 +70,7049 @@
  */
 #define XD_STATE_MASK (0b111)
 
-// ========================
-// Types
-// ========================
+/**
+ * @brief Flag stored in the state bits of an allocated block that has a record
+ * in a side table (such as a lifetime sample), the rest of the state bits hold
+ * the `xd_mem_block_state`.
+ */
+#define XD_TRACKED_FLAG (0b100)
 
 /**
- * @brief Represents a single byte of memory.
+ * @brief The maximum number of threads used to prefault reserved memory.
  */
-typedef char xd_byte;
+#define XD_PREFAULT_MAX_THREADS (16)
 
 /**
- * @brief Represents the state of a memory block.
+ * @brief The minimum number of bytes each prefault thread is given.
+ *
+ * Smaller ranges are faulted in by fewer threads.
  */
-typedef enum xd_mem_block_state {
-  XD_MEM_BLOCK_UNALLOCATED = 0b000,  // Unallocated memory block
-  XD_MEM_BLOCK_ALLOCATED = 0b001,    // Allocated memory block
-  XD_MEM_BLOCK_FENCEPOST = 0b010     // Separator between two OS chunks
-} xd_mem_block_state;
+#define XD_PREFAULT_MIN_SLICE (1024 * 1024)
 
 /**
- * @brief Represents a memory block header, contains the metadata of the
- * memory block.
+ * @brief The number of bits in a `size_t`.
  */
-typedef struct xd_mem_block_header {
-  size_t size;       // The size of the block (only data excluding header).
-                     // Since `MIN_ALLOCATION_SIZE` is `8` we will use the
-                     // three least significant bits to store the  state of
-                     // the block.
-  size_t prev_size;  // The size of the previous block's data (for coalescing)
+#define XD_SIZE_BITS (sizeof(size_t) * 8)
 
-  // The start of the user's data
-  // when the block is free (in the free list) `prev` and `next`
-  // are used, otherwise (allocated) `data` will be used.
-  // if it is a fencepost this part is not used at all and no memory is
-  // allocated for it.
-  union {
-    struct {
-      struct xd_mem_block_header *next;  // The next block in the free list
-      struct xd_mem_block_header *prev;  // The previous block in the free list
-    };
-    xd_byte data[0];  // Pointer to the data section in the memory block
-  };
-} xd_mem_block_header;
+/**
+ * @brief The number of segregated free lists (bins) used in real-time mode,
+ * bin `i` holds the free blocks with sizes in `[2^i, 2^(i+1))`.
+ */
+#define XD_RT_BIN_COUNT (XD_SIZE_BITS)
 
-// ========================
-// Global Variables
-// ========================
+/**
+ * @brief The size of the smallest band of the pre-zeroed pool, `xd_calloc()`
+ * requests smaller than this are zeroed synchronously.
+ */
+#define XD_ZERO_POOL_MIN_SIZE (4096)
 
 /**
- * @brief Pointer to the location of the heap prior to any sbrk calls.
+ * @brief The number of size bands in the pre-zeroed pool, band `i` holds
+ * blocks of `XD_ZERO_POOL_MIN_SIZE << i` bytes (4 KB up to 1 MB).
  */
-static void *xd_heap_start_address = NULL;
+#define XD_ZERO_POOL_BAND_COUNT (9)
 
 /**
- * @brief Pointer to the location of the current end of the heap managed by this
- * library.
- *
- * Used to know if the heap was corrupted by calling `sbrk()` outside this
- * library.
+ * @brief The number of pre-zeroed blocks kept in each band of the pool.
  */
-static void *xd_heap_end_address = NULL;
+#define XD_ZERO_POOL_BAND_DEPTH (4)
 
 /**
- * @brief Pointer to the head of the free list.
+ * @brief How long the pool thread waits before retrying after a failed
+ * allocation (in milliseconds).
  */
-static xd_mem_block_header *xd_free_list_head = NULL;
+#define XD_ZERO_POOL_RETRY_MS (100)
 
-// ========================
-// Static Variables
-// ========================
+/**
+ * @brief The minimum size of a chunk mapped for a heap other than the main
+ * heap, mapped chunks are rounded up to a multiple of this value.
+ */
+#define XD_HEAP_CHUNK_SIZE (64 * 1024)
 
 /**
- * @brief Pointer to the right fencepost of the most recently created heap
- * chunk.
- *
- * Used when coalescing heap chunks.
+ * @brief The number of lifetime classes of `xd_malloc_hint()`, each has a heap
+ * of its own.
  */
-static xd_mem_block_header *xd_recent_chunk_right_fencepost = NULL;
+#define XD_HINT_HEAP_COUNT (3)
 
 /**
- * @brief Mutex to ensure thread safety.
+ * @brief The share of time (in percent, over the last 10 seconds) some tasks
+ * were stalled on memory above which the cold heap is paged out instead of only
+ * being deactivated (see `xd_heap_mark_cold()`).
  */
-static pthread_mutex_t xd_malloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define XD_COLD_PRESSURE_THRESHOLD (10.0)
 
-// ========================
-// Function Declarations
-// ========================
+/**
+ * @brief The number of bytes the heaps grow by between two checks of the memory
+ * usage against the memory limit (see `xd_malloc_memory_limit()`), a quarter of
+ * it once the usage is tight.
+ */
+#define XD_MEMORY_CHECK_INTERVAL (4 * 1024 * 1024)
 
-// constructor/destructor for the library
-static void xd_malloc_init() __attribute__((constructor));
-static void xd_malloc_destroy() __attribute__((destructor));
+/**
+ * @brief The memory usage (in percent of the memory limit) above which the
+ * pre-zeroed pool is emptied and no longer refilled, and the usage is checked
+ * more often.
+ */
+#define XD_MEMORY_TIGHT_PERCENT (75)
 
-// helpers
+/**
+ * @brief The memory usage (in percent of the memory limit) above which the free
+ * pages of all heaps are returned to the OS (see `xd_malloc_purge()`).
+ */
+#define XD_MEMORY_CRITICAL_PERCENT (90)
 
-static inline xd_mem_block_header *xd_block_get_header_from_data(void *ptr);
-static inline void xd_block_set_size(xd_mem_block_header *header, size_t size);
-static inline void xd_block_set_state(xd_mem_block_header *header,
-                                      xd_mem_block_state state);
-static inline void xd_block_set_size_and_state(xd_mem_block_header *header,
-                                               size_t size,
-                                               xd_mem_block_state state);
-static inline xd_mem_block_state xd_block_get_state(
-    const xd_mem_block_header *header);
-static inline size_t xd_block_get_size(const xd_mem_block_header *header);
+/**
+ * @brief The maximum number of registered memory pressure callbacks (see
+ * `xd_malloc_pressure_callback_add()`).
+ */
+#define XD_PRESSURE_CALLBACK_COUNT (16)
 
-static inline xd_mem_block_header *xd_block_get_next(
-    const xd_mem_block_header *header);
-static inline xd_mem_block_header *xd_block_get_prev(
-    const xd_mem_block_header *header);
+/**
+ * @brief The size of the space at the start of a relocatable block's data that
+ * holds the index of its handle, the user's data follows it.
+ */
+#define XD_HANDLE_HEADER_SIZE (XD_ALIGNMENT)
 
-static void xd_block_split(xd_mem_block_header *header, size_t size);
-static void xd_block_coalesce_with_prev_and_next(xd_mem_block_header *header);
-static void xd_block_coalesce_with_prev(xd_mem_block_header *header);
-static void xd_block_coalesce_with_next(xd_mem_block_header *header);
+/**
+ * @brief The minimum size of a segment mapped for the stage region of a thread
+ * (see `xd_heap_mark()`).
+ */
+#define XD_STAGE_SEGMENT_SIZE (1024 * 1024)
 
-static void xd_free_list_insert(xd_mem_block_header *header);
-static void xd_free_list_remove(xd_mem_block_header *header);
+/**
+ * @brief The maximum number of heaps pushed by `xd_heap_push_current()` on a
+ * thread at the same time.
+ */
+#define XD_HEAP_STACK_SIZE (16)
 
-static xd_mem_block_header *xd_free_list_find(size_t size);
+/**
+ * @brief The number of blocks a thread defers (see `xd_free_deferred()`)
+ * between attempts to advance the epoch and free its safe blocks.
+ */
+#define XD_EPOCH_BATCH (64)
 
-static void *xd_heap_chunk_create(size_t size);
-static bool xd_heap_chunk_try_coalesce(xd_mem_block_header *chunk_header);
+/**
+ * @brief The number of I/O buffer pools (see `xd_iopool_create()`) a thread can
+ * recycle buffers of without locking at the same time.
+ */
+#define XD_IOPOOL_THREAD_CACHES (4)
 
-static inline uintptr_t xd_block_header_relative_address(
-    xd_mem_block_header *header);
-static inline void xd_block_header_dump(FILE *out, xd_mem_block_header *header);
+/**
+ * @brief The maximum number of buffers a thread keeps for reuse per I/O buffer
+ * pool, half of them are returned to the pool once it is full.
+ */
+#define XD_IOPOOL_CACHE_SIZE (32)
 
-// ========================
-// Function Implementations
-// ========================
+/**
+ * @brief The initial number of chunks an I/O buffer pool keeps track of, the
+ * array of chunks doubles whenever it is full.
+ */
+#define XD_IOPOOL_REGION_CAPACITY (4)
 
 /**
- * @brief Constructor to be executed before `main()` to initialize the
- * `xd_malloc` library.
+ * @brief The size of a huge page (in bytes), the chunks of I/O buffer pools
+ * created with `XD_IOPOOL_HUGEPAGE` are multiples of it.
  */
-static void xd_malloc_init() {
-  // initialize the free list
-  xd_free_list_head = NULL;
+#define XD_HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
-  // initialize the mutex
-  if (pthread_mutex_init(&xd_malloc_mutex, NULL) != 0) {
-    perror("fatal - mutex init failed");
-    exit(EXIT_FAILURE);
-  }
+/**
+ * @brief Identifies a persistent heap file (see `xd_pheap_open()`), "XDPHEAP"
+ * followed by the format version.
+ */
+#define XD_PHEAP_MAGIC (0x5844504845415001ULL)
 
-  // disable stdout buffer so it won't call malloc
-  setvbuf(stdout, NULL, _IONBF, 0);
+/**
+ * @brief Internal flag of `xd_pheap.flags`, the heap is shared between
+ * processes (see `xd_shm_heap_open()`) and locked using the process-shared
+ * mutex in its header.
+ */
+#define XD_PHEAP_SHARED (0x100)
 
-  // store the start adress of the heap
-  xd_heap_start_address = sbrk(0);
-  if ((intptr_t)xd_heap_start_address % XD_ALIGNMENT != 0) {
-    fprintf(stderr, "xd_malloc: heap start is not 8-byte aligned\n");
-    exit(EXIT_FAILURE);
-  }
-  xd_heap_end_address = xd_heap_start_address;
-}  // xd_malloc_init()
+/**
+ * @brief The number of times `xd_shm_heap_open()` checks whether a heap created
+ * by another process is formatted (1 ms apart) before failing.
+ */
+#define XD_SHM_HEAP_OPEN_RETRIES (1000)
 
 /**
- * @brief Destructor to be executed on exit to cleanup.
+ * @brief The size step (in bytes) between the size classes of the per-process
+ * cache of a shared heap (see `XD_SHM_HEAP_CACHE`).
  */
-static void xd_malloc_destroy() {
-  pthread_mutex_destroy(&xd_malloc_mutex);
-}  // xd_malloc_destroy()
+#define XD_SHM_HEAP_CACHE_GRANULARITY (16)
 
 /**
- * @brief Returns the header of a memory block from its data section address.
- *
- * @param ptr Pointer to the data section of a block.
- *
- * @return Pointer to the memory block's header.
+ * @brief The number of size classes of the per-process cache of a shared heap.
  */
-static inline xd_mem_block_header *xd_block_get_header_from_data(void *ptr) {
-  return (xd_mem_block_header *)((xd_byte *)ptr - XD_BLOCK_HEADER_SIZE);
-}  // xd_block_get_header_from_data()
+#define XD_SHM_HEAP_CACHE_CLASSES (16)
 
 /**
- * @brief Sets the size of a memory block header.
- *
- * @param header Pointer to the memory block header.
- *
- * @param size Size of the block's data (in bytes).
+ * @brief The maximum size (in bytes) of blocks kept in the per-process cache of
+ * a shared heap.
  */
-static inline void xd_block_set_size(xd_mem_block_header *header, size_t size) {
-  header->size = size | (header->size & XD_STATE_MASK);
-}  // xd_block_set_size()
+#define XD_SHM_HEAP_CACHE_MAX_SIZE \
+  (XD_SHM_HEAP_CACHE_CLASSES * XD_SHM_HEAP_CACHE_GRANULARITY)
 
 /**
- * @brief Sets the state of a memory block header.
- *
- * @param header Pointer to the memory block header.
- *
- * @param state Allocation state of the block.
+ * @brief The maximum number of blocks kept in each size class of the
+ * per-process cache of a shared heap.
  */
-static inline void xd_block_set_state(xd_mem_block_header *header,
-                                      xd_mem_block_state state) {
-  header->size = (header->size & ~XD_STATE_MASK) | state;
-}  // xd_block_set_state()
+#define XD_SHM_HEAP_CACHE_COUNT (64)
 
 /**
- * @brief Sets the size and state of a memory block from its header.
- *
- * @param header Pointer to the memory block header.
- *
- * @param size Size of the block's data (in bytes).
- * @param state Allocation state of the block.
+ * @brief The size of the space at the start of a persistent heap file that
+ * holds its `xd_pheap_file_header`, the heap chunk follows it.
  */
-static inline void xd_block_set_size_and_state(xd_mem_block_header *header,
-                                               size_t size,
-                                               xd_mem_block_state state) {
-  header->size = (size & ~XD_STATE_MASK) | (state & XD_STATE_MASK);
-}  // xd_block_set_size_and_state()
+#define XD_PHEAP_FILE_HEADER_SIZE                     \
+  ((sizeof(xd_pheap_file_header) + XD_ALIGNMENT - 1) & \
+   ~(size_t)(XD_ALIGNMENT - 1))
 
 /**
- * @brief Gets the state of a memory block from its header.
- *
- * @param header Pointer to the memory block header.
- *
- * @return The state of the memory block.
+ * @brief The size of the space at the start of a stage segment that holds its
+ * `xd_stage_segment`, the blocks follow it.
  */
-static inline xd_mem_block_state xd_block_get_state(
-    const xd_mem_block_header *header) {
-  return (xd_mem_block_state)(header->size & XD_STATE_MASK);
-}  // xd_block_get_state()
+#define XD_STAGE_SEGMENT_HEADER_SIZE \
+  ((sizeof(xd_stage_segment) + XD_ALIGNMENT - 1) & ~(size_t)(XD_ALIGNMENT - 1))
 
 /**
- * @brief Gets the size of a memory block (excluding header, only user data).
- *
- * @param header Pointer to the memory block header.
- *
- * @return The size of the memory block.
+ * @brief The number of call sites tracked by lifetime prediction, must be a
+ * power of two.
  */
-static inline size_t xd_block_get_size(const xd_mem_block_header *header) {
-  return (size_t)(header->size & ~XD_STATE_MASK);
-}  // xd_block_get_size()
+#define XD_PREDICT_SITE_COUNT (1024)
 
 /**
- * @brief Returns the header of the next block in memory.
- *
- * @param header Pointer to the current block's header.
- *
- * @return Pointer to the next block's header.
+ * @brief The maximum number of slots probed when looking up a call site.
  */
-static inline xd_mem_block_header *xd_block_get_next(
-    const xd_mem_block_header *header) {
-  return (xd_mem_block_header *)((xd_byte *)header + XD_BLOCK_HEADER_SIZE +
-                                 xd_block_get_size(header));
-}  // xd_block_get_next()
+#define XD_PREDICT_SITE_PROBES (8)
 
 /**
- * @brief Returns the header of the previous block in memory.
- *
- * @param header Pointer to the current block's header.
- *
- * @return Pointer to the previous block's header.
+ * @brief The number of slots for live sampled blocks, must be a power of two
+ * (at most three quarters are used).
  */
-static inline xd_mem_block_header *xd_block_get_prev(
-    const xd_mem_block_header *header) {
-  return (xd_mem_block_header *)((xd_byte *)header - header->prev_size -
-                                 XD_BLOCK_HEADER_SIZE);
-}  // xd_block_get_prev()
+#define XD_PREDICT_SAMPLE_COUNT (4096)
 
 /**
- * @brief Splits the block pointed to by the passed header into two blocks,
- * making the first block with the passed required size, and the second block
- * with the rest of the block size.
- *
- * @param header Pointer to the block's header.
- * @param size The required size of the first block after split.
- *
- * @note this function is a helpr for `xd_malloc()` and must be used only on
- * unallocated memory blocks.
+ * @brief The number of sample slots checked for long-lived blocks on every new
+ * sample, since blocks that are never freed are only seen this way.
  */
-static void xd_block_split(xd_mem_block_header *header, size_t size) {
-  // get the size of the block before split
-  size_t block_size = xd_block_get_size(header);
+#define XD_PREDICT_AGE_SCAN (64)
 
-  // shrink the size of the block and mark it as allocated
-  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+/**
+ * @brief The number of samples of a call site needed before its lifetime is
+ * predicted.
+ */
+#define XD_PREDICT_MIN_SAMPLES (8)
 
-  // create a new free block with the rest of the size
-  xd_mem_block_header *new_block = xd_block_get_next(header);
-  size_t new_block_size = block_size - size - XD_BLOCK_HEADER_SIZE;
-  xd_block_set_size_and_state(new_block, new_block_size,
-                              XD_MEM_BLOCK_UNALLOCATED);
-  new_block->prev_size = size;
-  xd_free_list_insert(new_block);
+/**
+ * @brief The number of samples of a call site after which its counts are
+ * halved, so the prediction follows changes in behavior.
+ */
+#define XD_PREDICT_MAX_SAMPLES (256)
 
-  // update the previous size of the block on the right of the new block
-  xd_mem_block_header *new_block_next = xd_block_get_next(new_block);
-  new_block_next->prev_size = new_block_size;
-}  // xd_block_split()
+/**
+ * @brief Sampled blocks freed within this time are short-lived (in
+ * nanoseconds).
+ */
+#define XD_PREDICT_SHORT_NS (1000000ULL)
 
 /**
- * @brief Coalesce the memory block pointed to by the passed header with both
- * the block before it and the block after it in memory.
- *
- * @param header Pointer to the block's header to be coalesced.
- *
- * @note This function is a helper for `xd_free()` and must be called only on a
- * block when both the blocks before it and after it are unallocated.
+ * @brief Sampled blocks that live at least this long are long-lived (in
+ * nanoseconds).
  */
-static void xd_block_coalesce_with_prev_and_next(xd_mem_block_header *header) {
-  xd_mem_block_header *prev = xd_block_get_prev(header);
-  xd_mem_block_header *next = xd_block_get_next(header);
-  size_t size = xd_block_get_size(header) + xd_block_get_size(prev) +
-                xd_block_get_size(next) + (2 * XD_BLOCK_HEADER_SIZE);
-  xd_free_list_remove(next);
-  header = prev;
-  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
-  next = xd_block_get_next(header);
-  next->prev_size = size;
-}  // xd_block_coalesce_with_prev_and_next()
+#define XD_PREDICT_LONG_NS (1000000000ULL)
 
 /**
- * @brief Coalesce the memory block pointed to by the passed header with the
- * block before it.
- *
- * @param header Pointer to the block's header to be coalesced.
- *
- * @note This function is a helper for `xd_free()` and must be called only on a
- * block when the block before it is unallocated.
+ * @brief The number of tags pushed by `xd_malloc_tag_push()` on a thread at the
+ * same time.
  */
-static void xd_block_coalesce_with_prev(xd_mem_block_header *header) {
-  xd_mem_block_header *prev = xd_block_get_prev(header);
-  size_t size = xd_block_get_size(header) + xd_block_get_size(prev) +
-                XD_BLOCK_HEADER_SIZE;
-  header = prev;
-  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
-  xd_mem_block_header *next = xd_block_get_next(header);
-  next->prev_size = size;
-}  // xd_block_coalesce_with_prev()
+#define XD_TAG_STACK_SIZE (16)
 
 /**
- * @brief Coalesce the memory block pointed to by the passed header with the
- * block after it.
- *
- * @param header Pointer to the block's header to be coalesced.
- *
- * @note This function is a helper for `xd_free()` and must be called only on a
- * block when the block after it is unallocated.
+ * @brief The initial number of slots of the table of tagged blocks, it doubles
+ * when three quarters are used.
  */
-static void xd_block_coalesce_with_next(xd_mem_block_header *header) {
-  xd_mem_block_header *next = xd_block_get_next(header);
-  size_t size = xd_block_get_size(header) + xd_block_get_size(next) +
-                XD_BLOCK_HEADER_SIZE;
-  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
-  header->prev = next->prev;
-  header->next = next->next;
-  if (header->prev != NULL) {
-    header->prev->next = header;
-  }
-  if (header->next != NULL) {
-    header->next->prev = header;
-  }
-  if (next == xd_free_list_head) {
-    xd_free_list_head = header;
-  }
-  next = xd_block_get_next(header);
-  next->prev_size = size;
-}  // xd_block_coalesce_with_next()
+#define XD_TAG_TABLE_MIN_COUNT (4096)
 
 /**
- * @brief Inserts the passed memory block header at the beginning of the free
- * list.
- *
- * @param header A pointer to the memory block header to be inserted.
+ * @brief The number of frames of the allocation stack recorded for the blocks
+ * sampled by lifetime prediction when leak detection is enabled.
  */
-static void xd_free_list_insert(xd_mem_block_header *header) {
-  header->prev = NULL;
-  header->next = xd_free_list_head;
+#define XD_LEAK_STACK_DEPTH (XD_SNAPSHOT_STACK_DEPTH)
 
-  if (xd_free_list_head != NULL) {
-    xd_free_list_head->prev = header;
-  }
+/**
+ * @brief The number of extra frames captured for the allocator's own frames,
+ * which are skipped.
+ */
+#define XD_LEAK_STACK_SKIP (4)
 
-  xd_free_list_head = header;
-}  // xd_free_list_insert()
+/**
+ * @brief The maximum number of allocation stacks printed by a leak report.
+ */
+#define XD_LEAK_REPORT_STACKS (10)
 
 /**
- * @brief Removes the passed memory block header from the free list.
- *
- * @param header A pointer to the memory block header to be removed.
+ * @brief The number of slots of the table of long-lived sampled blocks kept
+ * for leak reports, a power of two, at most three quarters are used.
  */
-static void xd_free_list_remove(xd_mem_block_header *header) {
-  if (header->prev != NULL) {
-    header->prev->next = header->next;
-  }
-  if (header->next != NULL) {
-    header->next->prev = header->prev;
-  }
+#define XD_LEAK_SAMPLE_COUNT (4096)
 
-  if (header == xd_free_list_head) {
-    xd_free_list_head = xd_free_list_head->next;
-  }
-}  // xd_free_list_remove()
+// `XD_USE_DEFERRED_FREES` logs the frees of the main heap in side tables and
+// applies them to the inline headers (writing the heap pages) when an
+// allocation misses or the log is full
+#ifdef XD_USE_DEFERRED_FREES
+/**
+ * @brief The maximum number of frees kept pending before they are applied to
+ * the heap.
+ */
+#define XD_PENDING_FREE_CAPACITY (65536)
 
 /**
- * @brief Searches the free list for a block that can satisfy the requested size
- * and returns its header using First-Fit by default or Best-Fit if
- * `XD_USE_BEST_FIT` is defined.
- *
- * @param size The requested size in bytes.
- *
- * @return A pointer to the header of a suitable free block, or `NULL` if no
- * such block exists.
+ * @brief The number of levels of each size class of the free index, each level
+ * has a bit per word of the level below it, so empty regions of the heap are
+ * skipped.
  */
-static xd_mem_block_header *xd_free_list_find(size_t size) {
-#ifdef XD_USE_BEST_FIT
-  xd_mem_block_header *header = xd_free_list_head;
-  xd_mem_block_header *best_header = NULL;
-  while (header != NULL) {
-    if (xd_block_get_size(header) >= size) {
-      if (best_header == NULL ||
-          xd_block_get_size(header) < xd_block_get_size(best_header)) {
-        best_header = header;
-      }
-    }
-    header = header->next;
-  }
-  return best_header;
-#else
-  xd_mem_block_header *header = xd_free_list_head;
-  while (header != NULL && xd_block_get_size(header) < size) {
-    header = header->next;
-  }
-  return header;
+#define XD_FREE_INDEX_LEVELS (3)
 #endif
-}  // xd_free_list_find()
+
+// ========================
+// Types
+// ========================
 
 /**
- * @brief Requests a heap chunk from the OS and initializes it with fenceposts
- * and a free block.
+ * @brief Represents a single byte of memory.
+ */
+typedef char xd_byte;
+
+/**
+ * @brief Represents the state of a memory block.
+ */
+typedef enum xd_mem_block_state {
+  XD_MEM_BLOCK_UNALLOCATED = 0b000,  // Unallocated memory block
+  XD_MEM_BLOCK_ALLOCATED = 0b001,    // Allocated memory block
+  XD_MEM_BLOCK_FENCEPOST = 0b010,    // Separator between two OS chunks
+  XD_MEM_BLOCK_RELOCATABLE = 0b011   // Allocated block owned by a handle
+} xd_mem_block_state;
+
+/**
+ * @brief Represents a memory block header, contains the metadata of the
+ * memory block.
+ */
+typedef struct xd_mem_block_header {
+  size_t size;       // The size of the block (only data excluding header).
+                     // Since `MIN_ALLOCATION_SIZE` is `8` we will use the
+                     // three least significant bits to store the  state of
+                     // the block.
+  size_t prev_size;  // The size of the previous block's data (for coalescing)
+
+  // The start of the user's data
+  // when the block is free (in the free list) `prev` and `next`
+  // are used, otherwise (allocated) `data` will be used.
+  // if it is a fencepost this part is not used at all and no memory is
+  // allocated for it.
+  union {
+    struct {
+      struct xd_mem_block_header *next;  // The next block in the free list
+      struct xd_mem_block_header *prev;  // The previous block in the free list
+    };
+    xd_byte data[0];  // Pointer to the data section in the memory block
+  };
+} xd_mem_block_header;
+
+/**
+ * @brief Represents a range of memory to be faulted in by a prefault thread.
+ */
+typedef struct xd_prefault_range {
+  xd_byte *start;  // The start of the range (inclusive)
+  xd_byte *end;    // The end of the range (exclusive)
+} xd_prefault_range;
+
+/**
+ * @brief Represents a table of metadata kept out of line in its own memory
+ * mapping, so updating it doesn't write (and copy-on-write) the heap pages.
+ */
+typedef struct xd_side_table {
+  void *base;   // The start of the mapping (`NULL` if not mapped yet)
+  size_t size;  // The size of the mapping (in bytes)
+} xd_side_table;
+
+/**
+ * @brief Represents a band of the pre-zeroed pool, a stack of allocated and
+ * zeroed blocks of the same size.
+ */
+typedef struct xd_zero_pool_band {
+  void *blocks[XD_ZERO_POOL_BAND_DEPTH];  // The pre-zeroed blocks
+  size_t count;                           // The number of blocks in the band
+} xd_zero_pool_band;
+
+/**
+ * @brief Represents a heap, a set of chunks with their own free list and mutex.
  *
- * The new chunk includes space for 2 fenceposts and a block header.
+ * The main heap is grown using `sbrk()`, other heaps are grown by mapping
+ * chunks using `mmap()`.
+ */
+typedef struct xd_heap {
+  pthread_mutex_t mutex;                 // Mutex to ensure thread safety
+  xd_mem_block_header *free_list_head;  // Pointer to the head of the free list
+  xd_mem_block_header
+      *recent_chunk_right_fencepost;  // The right fencepost of the most
+                                      // recently created chunk (for
+                                      // coalescing chunks)
+  struct xd_heap *next;  // The next heap created by `xd_heap_create()`
+  size_t mapped;         // The size of the mapped chunks (in bytes)
+  size_t allocated;      // The size of the allocated blocks (in bytes)
+  size_t quota;          // The maximum of `mapped`, `0` if none
+  xd_quota_callback quota_callback;  // Called when the quota is hit
+  void *quota_arg;                   // The argument of `quota_callback`
+} xd_heap;
+
+/**
+ * @brief Represents the address range of a chunk mapped for a heap other than
+ * the main heap, used to find the heap of a block being freed.
+ */
+typedef struct xd_chunk_range {
+  void *start;    // The start of the chunk (inclusive)
+  void *end;      // The end of the chunk (exclusive)
+  xd_heap *heap;  // The heap owning the chunk
+  int fd;         // The memfd backing the chunk (`-1` if anonymous)
+} xd_chunk_range;
+
+/**
+ * @brief Represents a slot of the handle table (see `xd_halloc()`).
+ */
+typedef struct xd_handle_entry {
+  xd_mem_block_header *header;  // The block of the handle (`NULL` if free)
+  size_t lock_count;            // The number of unmatched `xd_hlock()` calls
+  xd_handle next_free;          // The next free slot (if free, `0` if last)
+} xd_handle_entry;
+
+/**
+ * @brief Represents a segment of the stage region of a thread, stored at the
+ * start of the segment's mapping.
+ */
+typedef struct xd_stage_segment {
+  struct xd_stage_segment *prev;  // The segment mapped before this one
+  size_t size;                    // The size of the mapping (in bytes)
+  size_t base;                    // The stage offset of the first block
+} xd_stage_segment;
+
+/**
+ * @brief Represents a block parked by `xd_free_deferred()`.
+ */
+typedef struct xd_epoch_retired {
+  void *ptr;     // The block to be freed
+  size_t epoch;  // The global epoch when the block was parked
+} xd_epoch_retired;
+
+/**
+ * @brief Represents the epoch state of a thread, records are never freed and
+ * are reused by new threads once their thread exits.
+ */
+typedef struct xd_epoch_record {
+  struct xd_epoch_record *next;  // The next record in `xd_epoch_records`
+  size_t state;                  // The observed epoch shifted left by one, the
+                                 // lowest bit is set inside a critical section
+  bool in_use;                   // Whether the record is owned by a thread
+  size_t nesting;                // The number of unmatched `xd_epoch_enter()`
+  xd_epoch_retired *retired;     // The parked blocks of the thread
+  size_t retired_count;          // The number of parked blocks
+  size_t retired_capacity;       // The capacity of `retired`
+} xd_epoch_record;
+
+/**
+ * @brief Represents the header of a persistent heap file, all positions are
+ * offsets from the start of the file so the file can be mapped anywhere.
+ */
+typedef struct xd_pheap_file_header {
+  uint64_t magic;         // `XD_PHEAP_MAGIC`
+  uint64_t size;          // The size of the file (in bytes)
+  uint64_t base;          // The address the file was last mapped at
+  uint64_t root;          // The offset of the root block's data (`0` if none)
+  uint64_t free_list;     // The offset of the first free block (`0` if none)
+  pthread_mutex_t mutex;  // Process-shared robust mutex (shared heaps only)
+} xd_pheap_file_header;
+
+/**
+ * @brief Represents an open persistent heap (see `xd_pheap_open()`) or shared
+ * heap (see `xd_shm_heap_open()`).
  *
- * @param size The required size of the usable data block in bytes.
+ * The blocks of the file use the layout of `xd_mem_block_header`, except that
+ * the free list links of a free block are offsets from the start of the file
+ * (stored in place of `next` and `prev`).
+ */
+typedef struct xd_pheap {
+  pthread_mutex_t mutex;  // Mutex to ensure thread safety (and of the cache)
+  xd_byte *base;          // The start of the mapping
+  size_t size;            // The size of the mapping (in bytes)
+  int fd;                 // The descriptor of the file
+  int flags;              // `XD_SHM_HEAP_*` and `XD_PHEAP_SHARED` flags
+  size_t generation;      // The `xd_fork_generation` the cache belongs to
+  size_t cache[XD_SHM_HEAP_CACHE_CLASSES];        // Offsets of cached blocks
+  size_t cache_count[XD_SHM_HEAP_CACHE_CLASSES];  // Number of cached blocks
+} xd_pheap;
+
+/**
+ * @brief Represents an I/O buffer pool (see `xd_iopool_create()`).
+ */
+typedef struct xd_iopool {
+  pthread_mutex_t mutex;      // Mutex to ensure thread safety
+  size_t id;                  // Unique id, tells the pool from a destroyed one
+  size_t buffer_size;         // The size of each buffer (in bytes)
+  size_t chunk_size;          // The size of each chunk (in bytes)
+  int flags;                  // `XD_IOPOOL_*` flags
+  void *free_list;            // Free buffers, linked through their first word
+  xd_iopool_region *regions;  // The chunks of the pool
+  size_t region_count;        // The number of chunks
+  size_t region_capacity;     // The capacity of `regions`
+  struct xd_iopool *next;     // The next pool in `xd_iopools`
+} xd_iopool;
+
+/**
+ * @brief Represents the buffers of an I/O buffer pool kept by a thread for
+ * reuse.
+ */
+typedef struct xd_iopool_cache {
+  xd_iopool *pool;                      // The pool (`NULL` if unused)
+  size_t id;                            // The id of the pool
+  size_t count;                         // The number of buffers
+  void *buffers[XD_IOPOOL_CACHE_SIZE];  // The buffers
+} xd_iopool_cache;
+
+/**
+ * @brief Represents an allocation call site tracked by lifetime prediction.
+ */
+typedef struct xd_predict_site {
+  uintptr_t address;      // The return address of the call (`0` if empty)
+  int hint;               // The predicted `XD_HINT_*` (`0` if none)
+  uint32_t short_count;   // The number of short-lived samples
+  uint32_t medium_count;  // The number of samples neither short nor long-lived
+  uint32_t long_count;    // The number of long-lived samples
+} xd_predict_site;
+
+/**
+ * @brief Represents a live sampled block of lifetime prediction.
+ */
+typedef struct xd_predict_sample {
+  xd_mem_block_header *header;  // The sampled block (`NULL` if empty)
+  xd_heap *heap;                // The heap owning the block
+  xd_predict_site *site;        // The call site that allocated the block
+  uint64_t time_ns;             // The allocation time
+  uintptr_t stack[XD_LEAK_STACK_DEPTH];  // The allocation stack (innermost
+                                         // first, `0` terminated)
+} xd_predict_sample;
+
+/**
+ * @brief Represents a long-lived sampled block that lifetime prediction
+ * stopped tracking, kept for leak reports.
+ */
+typedef struct xd_leak_sample {
+  xd_mem_block_header *header;           // The sampled block (`NULL` if empty)
+  uintptr_t stack[XD_LEAK_STACK_DEPTH];  // The allocation stack (innermost
+                                         // first, `0` terminated)
+} xd_leak_sample;
+
+/**
+ * @brief A function called for each block visited by `xd_heaps_walk()`.
  *
- * @return A pointer to the free block header on success, or `NULL` on
- * failure.
+ * @param header Pointer to the header of the block.
+ * @param arg The argument passed to `xd_heaps_walk()`.
  */
-static void *xd_heap_chunk_create(size_t size) {
-  // ensure enough space for header and two fenceposts (left + right)
-  size += 3 * XD_BLOCK_HEADER_SIZE;
+typedef void (*xd_block_visitor)(xd_mem_block_header *header, void *arg);
+
+/**
+ * @brief Represents the total size and number of the allocated blocks visited
+ * by a leak report.
+ */
+typedef struct xd_leak_totals {
+  size_t bytes;   // The size of the blocks (in bytes)
+  size_t blocks;  // The number of blocks
+} xd_leak_totals;
+
+/**
+ * @brief Represents the state of a heap snapshot being copied.
+ */
+typedef struct xd_snapshot_writer {
+  xd_snapshot_block *records;  // The block records, `NULL` to count only
+  uint64_t blocks;             // The number of blocks visited
+} xd_snapshot_writer;
+
+/**
+ * @brief Represents the sampled blocks of an allocation stack in a leak
+ * report.
+ */
+typedef struct xd_leak_group {
+  uintptr_t stack[XD_LEAK_STACK_DEPTH];  // The allocation stack
+  size_t bytes;                          // The size of the blocks (in bytes)
+  size_t blocks;                         // The number of blocks
+} xd_leak_group;
+
+/**
+ * @brief Represents a live block allocated while a tag was current (see
+ * `xd_malloc_tag_push()`).
+ */
+typedef struct xd_tag_record {
+  xd_mem_block_header *header;  // The tagged block (`NULL` if empty)
+  xd_heap *heap;                // The heap owning the block
+  unsigned int tag;             // The tag of the block
+} xd_tag_record;
+
+// ========================
+// Global Variables
+// ========================
+
+/**
+ * @brief Pointer to the location of the heap prior to any sbrk calls.
+ */
+static void *xd_heap_start_address = NULL;
+
+/**
+ * @brief Pointer to the location of the current end of the heap managed by this
+ * library.
+ *
+ * Used to know if the heap was corrupted by calling `sbrk()` outside this
+ * library.
+ */
+static void *xd_heap_end_address = NULL;
+
+/**
+ * @brief The main heap, grown using `sbrk()` and used by `xd_malloc()`.
+ */
+static xd_heap xd_main_heap = {
+    PTHREAD_MUTEX_INITIALIZER, NULL, NULL, NULL, 0, 0, 0, NULL, NULL};
+
+// ========================
+// Static Variables
+// ========================
+
+/**
+ * @brief The heaps of the lifetime classes of `xd_malloc_hint()`.
+ */
+static xd_heap xd_hint_heaps[XD_HINT_HEAP_COUNT];
+
+/**
+ * @brief The heap of the rarely used blocks of `xd_malloc_cold()`.
+ */
+static xd_heap xd_cold_heap;
+
+/**
+ * @brief The heap of the blocks of `xd_malloc_shareable()`, each block has a
+ * chunk of its own backed by a memfd, so its descriptor exposes nothing else.
+ */
+static xd_heap xd_shareable_heap;
+
+/**
+ * @brief The heap of the emergency reserve (see
+ * `xd_malloc_emergency_reserve()`), its chunks are mapped in advance and it
+ * never grows, so it can serve blocks after the other heaps fail to grow.
+ */
+static xd_heap xd_reserve_heap;
+
+/**
+ * @brief The heap of the allocator's own structures (created heaps, persistent
+ * heap handles, I/O buffer pools and epoch records), kept out of heap walks so
+ * leak reports and snapshots only show the blocks of the application.
+ */
+static xd_heap xd_internal_heap;
+
+/**
+ * @brief List of the heaps created by `xd_heap_create()`, so the fork handlers
+ * can acquire their mutexes.
+ */
+static xd_heap *xd_created_heaps = NULL;
+
+/**
+ * @brief Mutex protecting `xd_created_heaps`, acquired before the mutexes of
+ * the heaps in it.
+ */
+static pthread_mutex_t xd_created_heaps_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The heap the calling thread's allocations are routed to (see
+ * `xd_heap_push_current()`), `NULL` for the default placement.
+ */
+static __thread xd_heap *xd_current_heap = NULL;
+
+/**
+ * @brief The heaps that were current before the ones pushed on the calling
+ * thread.
+ */
+static __thread xd_heap *xd_heap_stack[XD_HEAP_STACK_SIZE];
+
+/**
+ * @brief The number of heaps in `xd_heap_stack`.
+ */
+static __thread size_t xd_heap_stack_depth = 0;
+
+/**
+ * @brief The number of times the process was forked from its parent, blocks
+ * cached by a shared heap in another generation belong to the parent.
+ */
+static size_t xd_fork_generation = 0;
+
+/**
+ * @brief The global epoch, advanced once every thread inside a critical section
+ * has observed it.
+ */
+static size_t xd_epoch_global = 0;
+
+/**
+ * @brief List of the epoch records, new records are pushed lock-free and read
+ * without locking, so it must be accessed atomically.
+ */
+static xd_epoch_record *xd_epoch_records = NULL;
+
+/**
+ * @brief The epoch record of the calling thread (`NULL` until it uses epochs).
+ */
+static __thread xd_epoch_record *xd_epoch_thread_record = NULL;
+
+/**
+ * @brief Key whose destructor releases the epoch record of an exiting thread.
+ */
+static pthread_key_t xd_epoch_key;
+
+/**
+ * @brief Used to create `xd_epoch_key` once.
+ */
+static pthread_once_t xd_epoch_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief The memory limit (in bytes) the allocator keeps the usage under, `0`
+ * if none (see `xd_malloc_memory_limit()`).
+ *
+ * Read without holding a lock, so it must be accessed atomically.
+ */
+static size_t xd_memory_limit = 0;
+
+/**
+ * @brief The directory of the process's cgroup v2 (empty if unknown), read
+ * for `memory.max` and `memory.current`.
+ */
+static char xd_cgroup_dir[256] = "";
+
+/**
+ * @brief The number of bytes the heaps grew by since the last memory usage
+ * check, must be accessed atomically.
+ */
+static size_t xd_memory_grown = 0;
+
+/**
+ * @brief Whether the memory usage was above `XD_MEMORY_TIGHT_PERCENT` of the
+ * limit at the last check, must be accessed atomically.
+ */
+static bool xd_memory_tight = false;
+
+/**
+ * @brief The size (in bytes) the main heap grows past only after relieving
+ * memory pressure, `0` if none (see `xd_malloc_set_soft_limit()`).
+ *
+ * Read without holding a lock, so it must be accessed atomically.
+ */
+static size_t xd_soft_limit = 0;
+
+/**
+ * @brief The registered memory pressure callbacks.
+ */
+static xd_pressure_callback xd_pressure_callbacks[XD_PRESSURE_CALLBACK_COUNT];
+
+/**
+ * @brief The arguments of `xd_pressure_callbacks`.
+ */
+static void *xd_pressure_callback_args[XD_PRESSURE_CALLBACK_COUNT];
+
+/**
+ * @brief The number of registered memory pressure callbacks.
+ */
+static size_t xd_pressure_callback_count = 0;
+
+/**
+ * @brief Mutex protecting the memory pressure callbacks.
+ */
+static pthread_mutex_t xd_pressure_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The end of the main heap after memory pressure was last relieved, so
+ * it is relieved again only once the heap changed (`NULL` if never).
+ *
+ * Read without holding a lock, so it must be accessed atomically.
+ */
+static void *xd_pressure_heap_end = NULL;
+
+/**
+ * @brief Whether the calling thread is relieving memory pressure, so the
+ * allocations of the callbacks don't relieve it again.
+ */
+static __thread bool xd_pressure_active = false;
+
+/**
+ * @brief Whether the calling thread is running a quota callback, so the
+ * allocations of the callback fail instead of calling it again.
+ */
+static __thread bool xd_quota_active = false;
+
+/**
+ * @brief The number of bytes the last `xd_heap_grow()` of the calling thread
+ * would have exceeded the quota of its heap by, if the quota callback should
+ * be called (`0` if not).
+ */
+static __thread size_t xd_heap_quota_excess = 0;
+
+/**
+ * @brief Whether the last `xd_heap_malloc()` of the calling thread failed
+ * because the heap couldn't grow (rather than because it is corrupted), only
+ * such failures fall back to the emergency reserve.
+ */
+static __thread bool xd_heap_grow_failed = false;
+
+/**
+ * @brief The number of allocated blocks of `xd_reserve_heap`, the allocator is
+ * in reserve mode while it is not `0`, must be accessed atomically.
+ */
+static size_t xd_reserve_blocks = 0;
+
+/**
+ * @brief The hook called when entering reserve mode, `NULL` if none, protected
+ * by `xd_reserve_heap.mutex`.
+ */
+static xd_reserve_hook xd_reserve_hook_function = NULL;
+
+/**
+ * @brief The argument of `xd_reserve_hook_function`.
+ */
+static void *xd_reserve_hook_arg = NULL;
+
+/**
+ * @brief List of the live I/O buffer pools, so buffers cached by threads are
+ * only returned to pools that weren't destroyed.
+ */
+static xd_iopool *xd_iopools = NULL;
+
+/**
+ * @brief Mutex protecting `xd_iopools`.
+ */
+static pthread_mutex_t xd_iopools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The id of the next I/O buffer pool.
+ */
+static size_t xd_iopool_next_id = 1;
+
+/**
+ * @brief The buffers cached by the calling thread, a pool uses the cache at
+ * its id modulo `XD_IOPOOL_THREAD_CACHES`.
+ */
+static __thread xd_iopool_cache
+    xd_iopool_thread_caches[XD_IOPOOL_THREAD_CACHES];
+
+/**
+ * @brief Key whose destructor returns the buffers cached by an exiting thread.
+ */
+static pthread_key_t xd_iopool_key;
+
+/**
+ * @brief Used to create `xd_iopool_key` once.
+ */
+static pthread_once_t xd_iopool_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Owner of the stage segments in the chunk registry, never allocated
+ * from (the blocks of a stage are only released by `xd_heap_release_to()`).
+ */
+static xd_heap xd_stage_heap;
+
+/**
+ * @brief The most recently mapped segment of the calling thread's stage region
+ * (`NULL` if none).
+ */
+static __thread xd_stage_segment *xd_stage_segment_top = NULL;
+
+/**
+ * @brief The offset of the next block in the calling thread's stage region,
+ * offsets keep increasing across segments.
+ */
+static __thread size_t xd_stage_top = 0;
+
+/**
+ * @brief The number of active marks of the calling thread, its allocations are
+ * served from its stage region while it is not `0`.
+ */
+static __thread size_t xd_stage_depth = 0;
+
+/**
+ * @brief Key whose destructor unmaps the stage region of an exiting thread.
+ */
+static pthread_key_t xd_stage_key;
+
+/**
+ * @brief Used to create `xd_stage_key` once.
+ */
+static pthread_once_t xd_stage_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Sorted array of `xd_chunk_range`, the chunks mapped for heaps other
+ * than the main heap.
+ */
+static xd_side_table xd_chunk_registry;
+
+/**
+ * @brief The number of chunk ranges in `xd_chunk_registry`.
+ *
+ * Read without holding `xd_chunk_registry_lock` to skip the lookup when no
+ * chunk is mapped, so it must be accessed atomically.
+ */
+static size_t xd_chunk_registry_count = 0;
+
+/**
+ * @brief Lock protecting `xd_chunk_registry`.
+ */
+static pthread_rwlock_t xd_chunk_registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief Array of `xd_handle_entry`, the handle `h` is the slot `h - 1`.
+ *
+ * Protected by `xd_main_heap.mutex`, like the relocatable blocks.
+ */
+static xd_side_table xd_handle_table;
+
+/**
+ * @brief The number of slots used in `xd_handle_table` (allocated or free).
+ */
+static size_t xd_handle_count = 0;
+
+/**
+ * @brief The first free slot of `xd_handle_table` (`0` if none).
+ */
+static xd_handle xd_handle_free_head = 0;
+
+/**
+ * @brief The lifetime prediction sample period, `0` if prediction is disabled
+ * (see `xd_malloc_lifetime_prediction()`).
+ *
+ * Read without holding a lock on every allocation, so it must be accessed
+ * atomically.
+ */
+static size_t xd_predict_period = 0;
+
+/**
+ * @brief The number of allocations of the calling thread left until the next
+ * sample.
+ */
+static __thread size_t xd_predict_countdown = 0;
+
+/**
+ * @brief Hash table of the call sites tracked by lifetime prediction.
+ *
+ * Slots are only added (never removed) while holding `xd_predict_mutex`, and
+ * `address` and `hint` are read without it, so they must be accessed
+ * atomically.
+ */
+static xd_predict_site xd_predict_sites[XD_PREDICT_SITE_COUNT];
+
+/**
+ * @brief Hash table of the live sampled blocks, keyed by header.
+ */
+static xd_predict_sample xd_predict_samples[XD_PREDICT_SAMPLE_COUNT];
+
+/**
+ * @brief The number of live sampled blocks in `xd_predict_samples`.
+ */
+static size_t xd_predict_sample_count = 0;
+
+/**
+ * @brief The next slot of `xd_predict_samples` checked for long-lived blocks.
+ */
+static size_t xd_predict_age_cursor = 0;
+
+/**
+ * @brief Hash table of the long-lived sampled blocks evicted from
+ * `xd_predict_samples` while allocation stacks are recorded, keyed by header.
+ */
+static xd_leak_sample xd_leak_samples[XD_LEAK_SAMPLE_COUNT];
+
+/**
+ * @brief The number of sampled blocks in `xd_leak_samples`.
+ */
+static size_t xd_leak_sample_count = 0;
+
+/**
+ * @brief Mutex protecting the lifetime prediction tables and
+ * `xd_leak_samples`, acquired after the mutex of a heap.
+ */
+static pthread_mutex_t xd_predict_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The tag of the calling thread's allocations, `0` if none.
+ */
+static __thread unsigned int xd_tag_current = 0;
+
+/**
+ * @brief The tags replaced by `xd_malloc_tag_push()` on the calling thread.
+ */
+static __thread unsigned int xd_tag_stack[XD_TAG_STACK_SIZE];
+
+/**
+ * @brief The number of tags in `xd_tag_stack`.
+ */
+static __thread size_t xd_tag_stack_depth = 0;
+
+/**
+ * @brief Hash table of the live tagged blocks keyed by header, mapped when the
+ * first block is tagged.
+ */
+static xd_tag_record *xd_tag_records = NULL;
+
+/**
+ * @brief The number of slots of `xd_tag_records`, a power of two.
+ */
+static size_t xd_tag_record_capacity = 0;
+
+/**
+ * @brief The number of live tagged blocks in `xd_tag_records`.
+ */
+static size_t xd_tag_record_count = 0;
+
+/**
+ * @brief The statistics of each tag, indexed by tag.
+ */
+static xd_tag_stats xd_tag_stats_table[XD_TAG_MAX + 1];
+
+/**
+ * @brief Mutex protecting the tag table and statistics, acquired after the
+ * mutex of a heap.
+ */
+static pthread_mutex_t xd_tag_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Whether the allocation stacks of sampled blocks are recorded, must be
+ * accessed atomically.
+ */
+static bool xd_leak_stacks = false;
+
+/**
+ * @brief The stream the leak report is written to on exit, `NULL` if none (see
+ * `xd_malloc_leak_detection()`).
+ */
+static FILE *xd_leak_report_stream = NULL;
+
+/**
+ * @brief Whether the allocator is in real-time mode (see
+ * `xd_malloc_rt_enable()`).
+ *
+ * In real-time mode the free blocks are kept in `xd_rt_bins` instead of the
+ * free list, and the heap only grows through `xd_malloc_reserve()`.
+ */
+static bool xd_rt_mode = false;
+
+/**
+ * @brief Heads of the segregated free lists used in real-time mode.
+ */
+static xd_mem_block_header *xd_rt_bins[XD_RT_BIN_COUNT];
+
+/**
+ * @brief Bitmap of the non-empty bins in `xd_rt_bins` (bit `i` is set if bin
+ * `i` is not empty).
+ */
+static size_t xd_rt_bins_bitmap = 0;
+
+/**
+ * @brief The bands of the pre-zeroed pool used by `xd_calloc()`.
+ */
+static xd_zero_pool_band xd_zero_pool[XD_ZERO_POOL_BAND_COUNT];
+
+/**
+ * @brief Whether the pre-zeroed pool thread is running.
+ *
+ * Read without holding `xd_zero_pool_mutex` by `xd_calloc()`, so it must be
+ * accessed atomically.
+ */
+static bool xd_zero_pool_running = false;
+
+/**
+ * @brief Mutex protecting the pre-zeroed pool.
+ */
+static pthread_mutex_t xd_zero_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Condition used to wake the pool thread when a block is taken from the
+ * pool or the pool is stopped.
+ */
+static pthread_cond_t xd_zero_pool_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief The thread refilling the pre-zeroed pool.
+ */
+static pthread_t xd_zero_pool_thread;
+
+/**
+ * @brief The placement policy of the calling thread's allocations (see
+ * `xd_malloc_thread_policy()`).
+ */
+static __thread int xd_thread_policy = XD_THREAD_POLICY_SHARED;
+
+#ifdef XD_USE_DEFERRED_FREES
+/**
+ * @brief Bitmap with a bit per `XD_ALIGNMENT` bytes of the heap, the bit of a
+ * block's header is set while the block's free is pending.
+ */
+static xd_side_table xd_pending_free_bitmap;
+
+/**
+ * @brief Array of the headers of the blocks whose free is pending.
+ */
+static xd_side_table xd_pending_free_log;
+
+/**
+ * @brief The number of headers in `xd_pending_free_log`.
+ */
+static size_t xd_pending_free_count = 0;
+
+/**
+ * @brief Hierarchical bitmaps tracking the free blocks of the main heap instead
+ * of the free list, one per size class (`floor(log2(size))`), level `0` has a
+ * bit per `XD_ALIGNMENT` bytes of the heap which is set for the header of
+ * every free block of the class, so no pointers are written into the free
+ * blocks.
+ */
+static xd_side_table xd_free_index[XD_RT_BIN_COUNT][XD_FREE_INDEX_LEVELS];
+
+/**
+ * @brief The number of free blocks of each size class of the free index.
+ */
+static size_t xd_free_index_counts[XD_RT_BIN_COUNT];
+
+/**
+ * @brief Bitmap of the size classes of the free index holding free blocks.
+ */
+static size_t xd_free_index_classes = 0;
+#endif
+
+// ========================
+// Function Declarations
+// ========================
+
+// constructor/destructor for the library
+static void xd_malloc_init() __attribute__((constructor));
+static void xd_malloc_destroy() __attribute__((destructor));
+
+// fork handlers
+static void xd_malloc_atfork_prepare();
+static void xd_malloc_atfork_parent();
+static void xd_malloc_atfork_child();
+
+// helpers
+
+static void xd_libc_heap_init();
+static bool xd_heap_is_corrupted();
+
+static inline size_t xd_block_adjust_size(size_t size);
+static inline xd_mem_block_header *xd_block_get_header_from_data(void *ptr);
+static inline void xd_block_set_size(xd_mem_block_header *header, size_t size);
+static inline void xd_block_set_state(xd_mem_block_header *header,
+                                      xd_mem_block_state state);
+static inline void xd_block_set_size_and_state(xd_mem_block_header *header,
+                                               size_t size,
+                                               xd_mem_block_state state);
+static inline xd_mem_block_state xd_block_get_state(
+    const xd_mem_block_header *header);
+static inline size_t xd_block_get_size(const xd_mem_block_header *header);
+
+static inline bool xd_block_is_tracked(const xd_mem_block_header *header);
+static inline void xd_block_set_tracked(xd_mem_block_header *header,
+                                        bool tracked);
+
+static inline xd_mem_block_header *xd_block_get_next(
+    const xd_mem_block_header *header);
+static inline xd_mem_block_header *xd_block_get_prev(
+    const xd_mem_block_header *header);
+
+static void xd_block_split(xd_heap *heap, xd_mem_block_header *header,
+                           size_t size);
+static void xd_block_coalesce_with_prev_and_next(xd_heap *heap,
+                                                 xd_mem_block_header *header);
+static void xd_block_coalesce_with_prev(xd_heap *heap,
+                                        xd_mem_block_header *header);
+static void xd_block_coalesce_with_next(xd_heap *heap,
+                                        xd_mem_block_header *header);
+static void xd_block_free(xd_heap *heap, xd_mem_block_header *header);
+static void xd_block_allocate(xd_heap *heap, xd_mem_block_header *header,
+                              size_t size);
+static xd_mem_block_header *xd_block_slide(xd_mem_block_header *header);
+
+static xd_mem_block_header *xd_heap_find_or_grow(xd_heap *heap, size_t size);
+static xd_mem_block_header *xd_heap_alloc(xd_heap *heap, size_t size);
+static xd_mem_block_header *xd_heap_alloc_aligned(xd_heap *heap, size_t size,
+                                                  size_t alignment);
+static xd_mem_block_header *xd_heap_alloc_by_policy(xd_heap *heap,
+                                                    size_t size);
+static void xd_heap_quota_call(xd_heap *heap);
+static void *xd_heap_malloc(xd_heap *heap, size_t size);
+static void xd_heap_free(xd_heap *heap, xd_mem_block_header *header);
+static xd_heap *xd_hint_heap(int hint);
+static void *xd_malloc_from(size_t size, uintptr_t site);
+
+static void xd_free_list_insert(xd_heap *heap, xd_mem_block_header *header);
+static void xd_free_list_remove(xd_heap *heap, xd_mem_block_header *header);
+static void xd_free_list_replace(xd_heap *heap,
+                                 xd_mem_block_header *old_header,
+                                 xd_mem_block_header *new_header);
+static void xd_free_list_resize(xd_heap *heap, xd_mem_block_header *header,
+                                size_t size);
+
+static xd_mem_block_header *xd_free_list_find(xd_heap *heap, size_t size);
+static xd_mem_block_header *xd_free_list_find_or_drain(xd_heap *heap,
+                                                       size_t size);
+
+static inline size_t xd_rt_bin_index(size_t size);
+static void xd_rt_bin_insert(xd_mem_block_header *header);
+static void xd_rt_bin_remove(xd_mem_block_header *header);
+static xd_mem_block_header *xd_rt_bin_find(size_t size);
+static int xd_rt_lock_heap();
+
+static xd_mem_block_header *xd_heap_chunk_format(void *chunk, size_t size);
+static void *xd_heap_chunk_create(size_t size);
+static void *xd_heap_chunk_map(xd_heap *heap, size_t size);
+static void xd_shareable_free(void *ptr);
+static bool xd_heap_chunk_try_coalesce(xd_heap *heap,
+                                       xd_mem_block_header *chunk_header);
+static xd_mem_block_header *xd_heap_grow(xd_heap *heap, size_t size);
+static void xd_heap_trim();
+
+static inline uint64_t xd_now_ns();
+static inline size_t xd_hash_address(uintptr_t address);
+static xd_predict_site *xd_predict_site_find(uintptr_t address, bool insert);
+static void xd_predict_site_count(xd_predict_site *site, uint64_t age_ns);
+static void xd_predict_sample_add(xd_heap *heap, xd_mem_block_header *header,
+                                  uintptr_t address);
+static void xd_predict_sample_remove(xd_mem_block_header *header);
+static void xd_predict_sample_delete(size_t index);
+static void xd_predict_age(xd_heap *heap);
+
+static bool xd_tag_table_grow();
+static void xd_tag_table_delete(size_t index);
+static void xd_tag_add(xd_heap *heap, xd_mem_block_header *header);
+static void xd_tag_remove(xd_mem_block_header *header);
+static void xd_tag_heap_forget(xd_heap *heap);
+static void xd_block_untrack(xd_mem_block_header *header);
+static unsigned int xd_tag_find(const xd_mem_block_header *header);
+
+static void xd_leak_stack_capture(uintptr_t address, uintptr_t *stack);
+static void xd_leak_sample_add(xd_mem_block_header *header,
+                               const uintptr_t *stack);
+static void xd_leak_sample_remove(xd_mem_block_header *header);
+static void xd_leak_sample_delete(size_t index);
+static void xd_heaps_lock();
+static void xd_heaps_unlock();
+static xd_byte *xd_heap_chunk_walk(xd_mem_block_header *left_fencepost,
+                                   xd_block_visitor visit, void *arg);
+static void xd_heaps_walk(xd_block_visitor visit, void *arg);
+static void xd_leak_block_count(xd_mem_block_header *header, void *arg);
+static void xd_snapshot_block_write(xd_mem_block_header *header, void *arg);
+static size_t xd_leak_group_add(xd_leak_group *groups, size_t count,
+                                const uintptr_t *stack, size_t size);
+static size_t xd_leak_groups_collect(xd_leak_group *groups);
+static int xd_leak_group_compare(const void *a, const void *b);
+
+static int xd_side_table_reserve(xd_side_table *table, size_t size);
+static int xd_chunk_registry_add(void *start, void *end, xd_heap *heap,
+                                 int fd);
+static bool xd_chunk_registry_find(const void *ptr, xd_chunk_range *range);
+static void xd_chunk_registry_remove(void *start);
+static xd_heap *xd_chunk_registry_lookup(const void *ptr);
+static void xd_chunk_registry_unmap(xd_heap *heap);
+static void xd_chunk_registry_forget(xd_heap *heap);
+static int xd_chunk_registry_advise(xd_heap *heap, int advice);
+static xd_handle_entry *xd_handle_entry_get(xd_handle handle);
+
+static void xd_stage_key_create();
+static void xd_stage_thread_exit(void *arg);
+static void xd_stage_segment_unmap(xd_stage_segment *segment);
+static void *xd_stage_alloc(size_t size);
+
+static inline xd_pheap_file_header *xd_pheap_file(const xd_pheap *pheap);
+static inline size_t *xd_pheap_block_links(xd_mem_block_header *header);
+static inline xd_mem_block_header *xd_pheap_block_at(const xd_pheap *pheap,
+                                                     size_t offset);
+static inline size_t xd_pheap_block_offset(const xd_pheap *pheap,
+                                           const xd_mem_block_header *header);
+static void xd_pheap_free_list_insert(xd_pheap *pheap,
+                                      xd_mem_block_header *header);
+static void xd_pheap_free_list_remove(xd_pheap *pheap,
+                                      xd_mem_block_header *header);
+static size_t xd_pheap_file_size(int fd, size_t size);
+static xd_pheap *xd_pheap_map(int fd, size_t size, void *hint, bool created,
+                              int flags);
+static bool xd_pheap_free_list_rebuild(xd_pheap *pheap);
+static int xd_pheap_lock(xd_pheap *pheap);
+static void xd_pheap_unlock(xd_pheap *pheap);
+static void xd_pheap_cache_reset(xd_pheap *pheap);
+static void xd_pheap_block_release(xd_pheap *pheap,
+                                   xd_mem_block_header *header);
+
+static void xd_iopool_key_create();
+static void xd_iopool_thread_exit(void *arg);
+static void xd_iopool_cache_flush(xd_iopool_cache *cache, size_t count);
+static int xd_iopool_grow(xd_iopool *pool);
+
+static void xd_epoch_key_create();
+static void xd_epoch_thread_exit(void *arg);
+static xd_epoch_record *xd_epoch_record_get();
+static bool xd_epoch_try_advance();
+static size_t xd_epoch_record_reclaim(xd_epoch_record *record);
+static bool xd_memory_under_pressure();
+static bool xd_cgroup_read(const char *name, size_t *value);
+static void xd_cgroup_detect();
+static size_t xd_memory_usage();
+static void xd_memory_limit_check();
+static void xd_zero_pool_drain();
+static size_t xd_block_purge(xd_mem_block_header *header);
+static size_t xd_heap_purge(xd_heap *heap);
+static void xd_memory_pressure_relieve(size_t size);
+static void xd_soft_limit_check(size_t size);
+
+static void *xd_prefault_worker(void *arg);
+static void xd_prefault(xd_byte *start, xd_byte *end, bool parallel);
+
+static inline size_t xd_zero_pool_band_size(size_t band);
+static inline int xd_zero_pool_band_index(size_t size);
+static void *xd_zero_pool_take(size_t size);
+static void *xd_zero_pool_worker(void *arg);
+
+#ifdef XD_USE_DEFERRED_FREES
+static inline size_t xd_block_granule_index(const xd_mem_block_header *header);
+static inline bool xd_side_bitmap_test(const xd_side_table *table,
+                                       size_t index);
+static inline void xd_side_bitmap_set(xd_side_table *table, size_t index);
+static inline void xd_side_bitmap_clear(xd_side_table *table, size_t index);
+static bool xd_pending_free_push(xd_mem_block_header *header);
+static void xd_pending_free_drain();
+static int xd_side_tables_reserve(size_t heap_size);
+static inline xd_mem_block_header *xd_block_from_granule_index(size_t index);
+static void xd_free_index_set(xd_mem_block_header *header);
+static void xd_free_index_clear(xd_mem_block_header *header);
+static size_t xd_free_index_next(size_t class, size_t level, size_t from);
+static xd_mem_block_header *xd_free_index_class_find(size_t class,
+                                                     size_t size);
+static xd_mem_block_header *xd_free_index_find(size_t size);
+#endif
+
+static inline uintptr_t xd_block_header_relative_address(
+    xd_mem_block_header *header);
+static inline void xd_block_header_dump(FILE *out, xd_mem_block_header *header);
+
+// ========================
+// Function Implementations
+// ========================
+
+/**
+ * @brief Constructor to be executed before `main()` to initialize the
+ * `xd_malloc` library.
+ */
+static void xd_malloc_init() {
+  // initialize the free lists
+  xd_main_heap.free_list_head = NULL;
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    xd_hint_heaps[i].free_list_head = NULL;
+    xd_hint_heaps[i].recent_chunk_right_fencepost = NULL;
+  }
+  xd_cold_heap.free_list_head = NULL;
+  xd_cold_heap.recent_chunk_right_fencepost = NULL;
+  xd_shareable_heap.free_list_head = NULL;
+  xd_shareable_heap.recent_chunk_right_fencepost = NULL;
+  xd_reserve_heap.free_list_head = NULL;
+  xd_reserve_heap.recent_chunk_right_fencepost = NULL;
+  xd_internal_heap.free_list_head = NULL;
+  xd_internal_heap.recent_chunk_right_fencepost = NULL;
+
+  // initialize the mutexes
+  if (pthread_mutex_init(&xd_main_heap.mutex, NULL) != 0) {
+    perror("fatal - mutex init failed");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    if (pthread_mutex_init(&xd_hint_heaps[i].mutex, NULL) != 0) {
+      perror("fatal - mutex init failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (pthread_mutex_init(&xd_cold_heap.mutex, NULL) != 0) {
+    perror("fatal - mutex init failed");
+    exit(EXIT_FAILURE);
+  }
+  if (pthread_mutex_init(&xd_shareable_heap.mutex, NULL) != 0) {
+    perror("fatal - mutex init failed");
+    exit(EXIT_FAILURE);
+  }
+  if (pthread_mutex_init(&xd_reserve_heap.mutex, NULL) != 0) {
+    perror("fatal - mutex init failed");
+    exit(EXIT_FAILURE);
+  }
+  if (pthread_mutex_init(&xd_internal_heap.mutex, NULL) != 0) {
+    perror("fatal - mutex init failed");
+    exit(EXIT_FAILURE);
+  }
+
+  // disable stdout buffer so it won't call malloc
+  setvbuf(stdout, NULL, _IONBF, 0);
+
+  // follow the memory limit of the container, if any
+  xd_cgroup_detect();
+  size_t limit;
+  if (xd_cgroup_read("memory.max", &limit) && limit != SIZE_MAX) {
+    xd_memory_limit = limit;
+  }
+
+  // must be done before taking the heap break
+  xd_libc_heap_init();
+
+  // store the start adress of the heap
+  xd_heap_start_address = sbrk(0);
+  if ((intptr_t)xd_heap_start_address % XD_ALIGNMENT != 0) {
+    fprintf(stderr, "xd_malloc: heap start is not 8-byte aligned\n");
+    exit(EXIT_FAILURE);
+  }
+  xd_heap_end_address = xd_heap_start_address;
+
+  // keep the allocator consistent in children of multi-threaded processes
+  if (pthread_atfork(xd_malloc_atfork_prepare, xd_malloc_atfork_parent,
+                     xd_malloc_atfork_child) != 0) {
+    perror("fatal - fork handlers registration failed");
+    exit(EXIT_FAILURE);
+  }
+}  // xd_malloc_init()
+
+/**
+ * @brief Destructor to be executed on exit to cleanup.
+ */
+static void xd_malloc_destroy() {
+  xd_calloc_pool_stop();
+  if (xd_leak_report_stream != NULL) {
+    xd_malloc_leak_report(xd_leak_report_stream);
+  }
+  pthread_mutex_destroy(&xd_main_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_destroy(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_destroy(&xd_cold_heap.mutex);
+  pthread_mutex_destroy(&xd_shareable_heap.mutex);
+  pthread_mutex_destroy(&xd_reserve_heap.mutex);
+  pthread_mutex_destroy(&xd_internal_heap.mutex);
+}  // xd_malloc_destroy()
+
+/**
+ * @brief Fork handler executed in the parent before `fork()`, acquires the
+ * allocator mutexes so the child doesn't inherit them locked by a thread that
+ * doesn't exist in the child.
+ */
+static void xd_malloc_atfork_prepare() {
+  pthread_mutex_lock(&xd_pressure_mutex);
+  pthread_mutex_lock(&xd_zero_pool_mutex);
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_lock(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_lock(&xd_cold_heap.mutex);
+  pthread_mutex_lock(&xd_shareable_heap.mutex);
+  pthread_mutex_lock(&xd_reserve_heap.mutex);
+  pthread_mutex_lock(&xd_created_heaps_mutex);
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_lock(&heap->mutex);
+  }
+  pthread_mutex_lock(&xd_iopools_mutex);
+  for (xd_iopool *pool = xd_iopools; pool != NULL; pool = pool->next) {
+    pthread_mutex_lock(&pool->mutex);
+  }
+  pthread_mutex_lock(&xd_internal_heap.mutex);
+  pthread_mutex_lock(&xd_predict_mutex);
+  pthread_mutex_lock(&xd_tag_mutex);
+  pthread_rwlock_wrlock(&xd_chunk_registry_lock);
+}  // xd_malloc_atfork_prepare()
+
+/**
+ * @brief Fork handler executed in the parent after `fork()`, releases the
+ * allocator mutexes.
+ */
+static void xd_malloc_atfork_parent() {
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+  pthread_mutex_unlock(&xd_tag_mutex);
+  pthread_mutex_unlock(&xd_predict_mutex);
+  pthread_mutex_unlock(&xd_internal_heap.mutex);
+  for (xd_iopool *pool = xd_iopools; pool != NULL; pool = pool->next) {
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  pthread_mutex_unlock(&xd_iopools_mutex);
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_unlock(&heap->mutex);
+  }
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+  pthread_mutex_unlock(&xd_shareable_heap.mutex);
+  pthread_mutex_unlock(&xd_cold_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_unlock(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
+  pthread_mutex_unlock(&xd_pressure_mutex);
+}  // xd_malloc_atfork_parent()
+
+/**
+ * @brief Fork handler executed in the child after `fork()`, releases the
+ * allocator mutexes and returns the pre-zeroed pool blocks to the heap, since
+ * the pool thread doesn't exist in the child.
+ */
+static void xd_malloc_atfork_child() {
+  // a write lock can only be released by the thread that acquired it, which
+  // has another id in the child
+  pthread_rwlock_init(&xd_chunk_registry_lock, NULL);
+  pthread_mutex_unlock(&xd_tag_mutex);
+  pthread_mutex_unlock(&xd_predict_mutex);
+  pthread_mutex_unlock(&xd_internal_heap.mutex);
+  for (xd_iopool *pool = xd_iopools; pool != NULL; pool = pool->next) {
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  pthread_mutex_unlock(&xd_iopools_mutex);
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_unlock(&heap->mutex);
+  }
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+  pthread_mutex_unlock(&xd_shareable_heap.mutex);
+  pthread_mutex_unlock(&xd_cold_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_unlock(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
+  pthread_mutex_unlock(&xd_pressure_mutex);
+
+  xd_fork_generation++;
+
+  // the chunks of the shareable heap are not inherited (see
+  // `xd_heap_chunk_map()`), its blocks are forgotten
+  xd_chunk_registry_forget(&xd_shareable_heap);
+  xd_shareable_heap.free_list_head = NULL;
+  xd_shareable_heap.recent_chunk_right_fencepost = NULL;
+  xd_shareable_heap.mapped = 0;
+  xd_shareable_heap.allocated = 0;
+
+  // only the calling thread exists in the child, the records of the other
+  // threads would block the epoch forever
+  for (xd_epoch_record *record = xd_epoch_records; record != NULL;
+       record = record->next) {
+    if (record != xd_epoch_thread_record) {
+      record->state = 0;
+      record->nesting = 0;
+      record->in_use = false;
+    }
+  }
+
+  if (__atomic_load_n(&xd_zero_pool_running, __ATOMIC_ACQUIRE)) {
+    __atomic_store_n(&xd_zero_pool_running, false, __ATOMIC_RELEASE);
+    for (size_t band = 0; band < XD_ZERO_POOL_BAND_COUNT; band++) {
+      while (xd_zero_pool[band].count > 0) {
+        xd_free(xd_zero_pool[band].blocks[--xd_zero_pool[band].count]);
+      }
+    }
+  }
+}  // xd_malloc_atfork_child()
+
+/**
+ * @brief Sets up the heap of the libc allocator below the heap of this library.
+ *
+ * The library itself makes libc allocate: creating the pre-zeroed pool and
+ * prefault threads allocates their thread-local storage. The first libc
+ * allocation extends the heap break, which would be seen as heap corruption if
+ * it happened after the heap of this library started. Once set up, the libc
+ * heap serves such small allocations from the space it already reserved.
+ */
+static void xd_libc_heap_init() {
+  // volatile so the allocation isn't optimized away
+  void *volatile block = malloc(1);
+  if (block == NULL) {
+    perror("fatal - libc heap setup failed");
+    exit(EXIT_FAILURE);
+  }
+  free(block);
+}  // xd_libc_heap_init()
+
+/**
+ * @brief Checks whether the heap break was changed from outside this library,
+ * in which case the library functions won't work.
+ *
+ * The check is done while holding `xd_main_heap.mutex`, since the heap break
+ * also moves while another thread is growing the heap.
+ *
+ * @return `true` if the heap is corrupted, `false` otherwise.
+ */
+static bool xd_heap_is_corrupted() {
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  bool corrupted = (sbrk(0) != xd_heap_end_address);
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return corrupted;
+}  // xd_heap_is_corrupted()
+
+/**
+ * @brief Adjusts a requested size to a valid block data size, making it large
+ * enough to hold the free list pointers and a multiple of `XD_ALIGNMENT`.
+ *
+ * @param size The requested size in bytes.
+ *
+ * @return The adjusted size in bytes.
+ */
+static inline size_t xd_block_adjust_size(size_t size) {
+  // make sure there is enough space for the next/prev pointers
+  // to be used when the block is freed
+  if (size < XD_MIN_ALLOC_SIZE) {
+    size = XD_MIN_ALLOC_SIZE;
+  }
+
+  // roundup to multiple of XD_ALIGNMENT
+  if (size % XD_ALIGNMENT != 0) {
+    size += XD_ALIGNMENT - (size % XD_ALIGNMENT);
+  }
+
+  return size;
+}  // xd_block_adjust_size()
+
+/**
+ * @brief Returns the header of a memory block from its data section address.
+ *
+ * @param ptr Pointer to the data section of a block.
+ *
+ * @return Pointer to the memory block's header.
+ */
+static inline xd_mem_block_header *xd_block_get_header_from_data(void *ptr) {
+  return (xd_mem_block_header *)((xd_byte *)ptr - XD_BLOCK_HEADER_SIZE);
+}  // xd_block_get_header_from_data()
+
+/**
+ * @brief Sets the size of a memory block header.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @param size Size of the block's data (in bytes).
+ */
+static inline void xd_block_set_size(xd_mem_block_header *header, size_t size) {
+  header->size = size | (header->size & XD_STATE_MASK);
+}  // xd_block_set_size()
+
+/**
+ * @brief Sets the state of a memory block header.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @param state Allocation state of the block.
+ */
+static inline void xd_block_set_state(xd_mem_block_header *header,
+                                      xd_mem_block_state state) {
+  header->size = (header->size & ~XD_STATE_MASK) | state;
+}  // xd_block_set_state()
+
+/**
+ * @brief Sets the size and state of a memory block from its header.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @param size Size of the block's data (in bytes).
+ * @param state Allocation state of the block.
+ */
+static inline void xd_block_set_size_and_state(xd_mem_block_header *header,
+                                               size_t size,
+                                               xd_mem_block_state state) {
+  header->size = (size & ~XD_STATE_MASK) | (state & XD_STATE_MASK);
+}  // xd_block_set_size_and_state()
+
+/**
+ * @brief Gets the state of a memory block from its header.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @return The state of the memory block.
+ */
+static inline xd_mem_block_state xd_block_get_state(
+    const xd_mem_block_header *header) {
+  return (xd_mem_block_state)(header->size & XD_STATE_MASK & ~XD_TRACKED_FLAG);
+}  // xd_block_get_state()
+
+/**
+ * @brief Gets the size of a memory block (excluding header, only user data).
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @return The size of the memory block.
+ */
+static inline size_t xd_block_get_size(const xd_mem_block_header *header) {
+  return (size_t)(header->size & ~XD_STATE_MASK);
+}  // xd_block_get_size()
+
+/**
+ * @brief Checks whether a memory block has a record in a side table.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @return `true` if the block is tracked, `false` otherwise.
+ */
+static inline bool xd_block_is_tracked(const xd_mem_block_header *header) {
+  return (header->size & XD_TRACKED_FLAG) != 0;
+}  // xd_block_is_tracked()
+
+/**
+ * @brief Sets or clears the tracked flag of an allocated memory block.
+ *
+ * @param header Pointer to the memory block header.
+ * @param tracked Whether the block has a record in a side table.
+ *
+ * @note Setting the state of the block clears the flag.
+ */
+static inline void xd_block_set_tracked(xd_mem_block_header *header,
+                                        bool tracked) {
+  if (tracked) {
+    header->size |= XD_TRACKED_FLAG;
+  }
+  else {
+    header->size &= ~(size_t)XD_TRACKED_FLAG;
+  }
+}  // xd_block_set_tracked()
+
+/**
+ * @brief Returns the header of the next block in memory.
+ *
+ * @param header Pointer to the current block's header.
+ *
+ * @return Pointer to the next block's header.
+ */
+static inline xd_mem_block_header *xd_block_get_next(
+    const xd_mem_block_header *header) {
+  return (xd_mem_block_header *)((xd_byte *)header + XD_BLOCK_HEADER_SIZE +
+                                 xd_block_get_size(header));
+}  // xd_block_get_next()
+
+/**
+ * @brief Returns the header of the previous block in memory.
+ *
+ * @param header Pointer to the current block's header.
+ *
+ * @return Pointer to the previous block's header.
+ */
+static inline xd_mem_block_header *xd_block_get_prev(
+    const xd_mem_block_header *header) {
+  return (xd_mem_block_header *)((xd_byte *)header - header->prev_size -
+                                 XD_BLOCK_HEADER_SIZE);
+}  // xd_block_get_prev()
+
+/**
+ * @brief Splits the block pointed to by the passed header into two blocks,
+ * making the first block with the passed required size, and the second block
+ * with the rest of the block size.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the block's header.
+ * @param size The required size of the first block after split.
+ *
+ * @note this function is a helpr for `xd_malloc()` and must be used only on
+ * unallocated memory blocks.
+ */
+static void xd_block_split(xd_heap *heap, xd_mem_block_header *header,
+                           size_t size) {
+  // get the size of the block before split
+  size_t block_size = xd_block_get_size(header);
+
+  // shrink the size of the block and mark it as allocated
+  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+
+  // create a new free block with the rest of the size
+  xd_mem_block_header *new_block = xd_block_get_next(header);
+  size_t new_block_size = block_size - size - XD_BLOCK_HEADER_SIZE;
+  xd_block_set_size_and_state(new_block, new_block_size,
+                              XD_MEM_BLOCK_UNALLOCATED);
+  new_block->prev_size = size;
+  xd_free_list_insert(heap, new_block);
+
+  // update the previous size of the block on the right of the new block
+  xd_mem_block_header *new_block_next = xd_block_get_next(new_block);
+  new_block_next->prev_size = new_block_size;
+}  // xd_block_split()
+
+/**
+ * @brief Coalesce the memory block pointed to by the passed header with both
+ * the block before it and the block after it in memory.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the block's header to be coalesced.
+ *
+ * @note This function is a helper for `xd_free()` and must be called only on a
+ * block when both the blocks before it and after it are unallocated.
+ */
+static void xd_block_coalesce_with_prev_and_next(xd_heap *heap,
+                                                 xd_mem_block_header *header) {
+  xd_mem_block_header *prev = xd_block_get_prev(header);
+  xd_mem_block_header *next = xd_block_get_next(header);
+  size_t size = xd_block_get_size(header) + xd_block_get_size(prev) +
+                xd_block_get_size(next) + (2 * XD_BLOCK_HEADER_SIZE);
+  xd_free_list_remove(heap, next);
+  header = prev;
+  xd_free_list_resize(heap, header, size);
+  next = xd_block_get_next(header);
+  next->prev_size = size;
+}  // xd_block_coalesce_with_prev_and_next()
+
+/**
+ * @brief Coalesce the memory block pointed to by the passed header with the
+ * block before it.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the block's header to be coalesced.
+ *
+ * @note This function is a helper for `xd_free()` and must be called only on a
+ * block when the block before it is unallocated.
+ */
+static void xd_block_coalesce_with_prev(xd_heap *heap,
+                                        xd_mem_block_header *header) {
+  xd_mem_block_header *prev = xd_block_get_prev(header);
+  size_t size = xd_block_get_size(header) + xd_block_get_size(prev) +
+                XD_BLOCK_HEADER_SIZE;
+  header = prev;
+  xd_free_list_resize(heap, header, size);
+  xd_mem_block_header *next = xd_block_get_next(header);
+  next->prev_size = size;
+}  // xd_block_coalesce_with_prev()
+
+/**
+ * @brief Coalesce the memory block pointed to by the passed header with the
+ * block after it.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the block's header to be coalesced.
+ *
+ * @note This function is a helper for `xd_free()` and must be called only on a
+ * block when the block after it is unallocated.
+ */
+static void xd_block_coalesce_with_next(xd_heap *heap,
+                                        xd_mem_block_header *header) {
+  xd_mem_block_header *next = xd_block_get_next(header);
+  size_t size = xd_block_get_size(header) + xd_block_get_size(next) +
+                XD_BLOCK_HEADER_SIZE;
+  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+  xd_free_list_replace(heap, next, header);
+  next = xd_block_get_next(header);
+  next->prev_size = size;
+}  // xd_block_coalesce_with_next()
+
+/**
+ * @brief Marks the passed allocated block as unallocated, coalescing it with
+ * the blocks before and after it in memory if they are unallocated, and
+ * inserts the result into the free list.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the header of the block to be freed.
+ */
+static void xd_block_free(xd_heap *heap, xd_mem_block_header *header) {
+  // get previous and next blocks
+  xd_mem_block_header *prev = xd_block_get_prev(header);
+  xd_mem_block_header *next = xd_block_get_next(header);
+  xd_mem_block_state prev_state = xd_block_get_state(prev);
+  xd_mem_block_state next_state = xd_block_get_state(next);
+
+  // coalesce with previous and/or next block if possible
+  if (prev_state == XD_MEM_BLOCK_UNALLOCATED &&
+      next_state == XD_MEM_BLOCK_UNALLOCATED) {
+    xd_block_coalesce_with_prev_and_next(heap, header);
+  }
+  else if (prev_state == XD_MEM_BLOCK_UNALLOCATED) {
+    xd_block_coalesce_with_prev(heap, header);
+  }
+  else if (next_state == XD_MEM_BLOCK_UNALLOCATED) {
+    xd_block_coalesce_with_next(heap, header);
+  }
+  else {
+    xd_block_set_state(header, XD_MEM_BLOCK_UNALLOCATED);
+    xd_free_list_insert(heap, header);
+  }
+}  // xd_block_free()
+
+/**
+ * @brief Marks the passed free block as allocated with the passed size,
+ * splitting the rest of the block into a new free block if it is large
+ * enough.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the header of the block, already removed from the
+ * free list.
+ * @param size The required size of the block (in bytes).
+ */
+static void xd_block_allocate(xd_heap *heap, xd_mem_block_header *header,
+                              size_t size) {
+  if (xd_block_get_size(header) - size >= sizeof(xd_mem_block_header)) {
+    // block size is enough to be split
+    xd_block_split(heap, header, size);
+  }
+
+  xd_block_set_state(header, XD_MEM_BLOCK_ALLOCATED);
+}  // xd_block_allocate()
+
+/**
+ * @brief Moves the unlocked relocatable block after the passed free block of
+ * the main heap to the start of the free block, so the free space ends up
+ * after it (coalesced with the following block if it is unallocated).
+ *
+ * @param header Pointer to the header of the free block.
+ *
+ * @return A pointer to the header of the free block after the moved block.
+ *
+ * @note Must be called while holding `xd_main_heap.mutex`.
+ */
+static xd_mem_block_header *xd_block_slide(xd_mem_block_header *header) {
+  xd_mem_block_header *block = xd_block_get_next(header);
+  size_t free_size = xd_block_get_size(header);
+  size_t block_size = xd_block_get_size(block);
+  size_t prev_size = header->prev_size;
+
+  // move the block (header and data) over the start of the free block
+  xd_free_list_remove(&xd_main_heap, header);
+  memmove(header, block, XD_BLOCK_HEADER_SIZE + block_size);
+  header->prev_size = prev_size;
+
+  xd_handle handle = *(xd_handle *)header->data;
+  xd_handle_entry_get(handle)->header = header;
+
+  // the rest is freed as an allocated block, to coalesce it with the next one
+  xd_mem_block_header *free_header = xd_block_get_next(header);
+  xd_block_set_size_and_state(free_header, free_size, XD_MEM_BLOCK_ALLOCATED);
+  free_header->prev_size = block_size;
+  xd_block_get_next(free_header)->prev_size = free_size;
+  xd_block_free(&xd_main_heap, free_header);
+  return free_header;
+}  // xd_block_slide()
+
+/**
+ * @brief Finds a free block of at least the passed size in the passed heap,
+ * growing the heap if no free block is large enough (except for the main heap
+ * in real-time mode and the emergency reserve).
+ *
+ * @param heap Pointer to the heap.
+ * @param size The required size of the block (adjusted, in bytes).
+ *
+ * @return A pointer to the free block's header (still in the free list), or
+ * `NULL` on failure.
+ *
+ * @note Must be called while holding the heap's mutex.
+ */
+static xd_mem_block_header *xd_heap_find_or_grow(xd_heap *heap, size_t size) {
+  // find the first block in the free list with the required size
+  xd_mem_block_header *header = xd_free_list_find_or_drain(heap, size);
+  if (header == NULL && !(heap == &xd_main_heap && xd_rt_mode) &&
+      heap != &xd_reserve_heap) {
+    // no block with enough size was found, get more heap memory from the OS
+    header = xd_heap_grow(heap, size);
+  }
+  return header;
+}  // xd_heap_find_or_grow()
+
+/**
+ * @brief Allocates a block of the passed size from the free list of the passed
+ * heap, growing the heap if no free block is large enough (except for the main
+ * heap in real-time mode).
+ *
+ * @param heap Pointer to the heap.
+ * @param size The required size of the block (adjusted, in bytes).
+ *
+ * @return A pointer to the allocated block's header, or `NULL` on failure.
+ *
+ * @note Must be called while holding the heap's mutex.
+ */
+static xd_mem_block_header *xd_heap_alloc(xd_heap *heap, size_t size) {
+  xd_mem_block_header *header = xd_heap_find_or_grow(heap, size);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  xd_free_list_remove(heap, header);
+  xd_block_allocate(heap, header, size);
+  return header;
+}  // xd_heap_alloc()
+
+/**
+ * @brief Allocates a block of the passed size whose data starts at a multiple
+ * of the passed alignment, the space before it is split into a free block.
+ *
+ * @param heap Pointer to the heap.
+ * @param size The required size of the block (adjusted, in bytes).
+ * @param alignment The required alignment, a power of two multiple of
+ * `XD_ALIGNMENT`.
+ *
+ * @return A pointer to the allocated block's header, or `NULL` on failure.
+ *
+ * @note Must be called while holding the heap's mutex.
+ */
+static xd_mem_block_header *xd_heap_alloc_aligned(xd_heap *heap, size_t size,
+                                                  size_t alignment) {
+  // enough space for the block after any leading free block
+  size_t search_size = size + alignment + sizeof(xd_mem_block_header);
+  xd_mem_block_header *header = xd_heap_find_or_grow(heap, search_size);
+  if (header == NULL) {
+    return NULL;
+  }
+  xd_free_list_remove(heap, header);
+
+  // the space before the aligned data must be large enough to be a free block
+  uintptr_t data = (uintptr_t)header->data;
+  uintptr_t aligned = (data + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  while (aligned != data && aligned - data < sizeof(xd_mem_block_header)) {
+    aligned += alignment;
+  }
+
+  if (aligned != data) {
+    xd_mem_block_header *leading_header = header;
+    xd_block_split(heap, leading_header,
+                   aligned - data - XD_BLOCK_HEADER_SIZE);
+    header = xd_block_get_next(leading_header);
+    xd_free_list_remove(heap, header);
+    xd_free_list_insert(heap, leading_header);
+  }
+
+  xd_block_allocate(heap, header, size);
+  return header;
+}  // xd_heap_alloc_aligned()
+
+/**
+ * @brief Allocates a block of the passed requested size, placed according to
+ * the calling thread's policy (see `xd_malloc_thread_policy()`).
+ *
+ * @param heap Pointer to the heap.
+ * @param size The requested size of the block (in bytes).
+ *
+ * @return A pointer to the allocated block's header, or `NULL` on failure.
+ *
+ * @note Must be called while holding the heap's mutex.
+ */
+static xd_mem_block_header *xd_heap_alloc_by_policy(xd_heap *heap,
+                                                    size_t size) {
+  if (xd_thread_policy == XD_THREAD_POLICY_CACHELINE) {
+    // keep the thread's blocks on cache lines of their own
+    if (size > SIZE_MAX - (4 * XD_CACHELINE_SIZE)) {
+      return NULL;
+    }
+    size = xd_block_adjust_size(size);
+    size = (size + XD_CACHELINE_SIZE - 1) & ~(size_t)(XD_CACHELINE_SIZE - 1);
+    return xd_heap_alloc_aligned(heap, size, XD_CACHELINE_SIZE);
+  }
+
+  return xd_heap_alloc(heap, xd_block_adjust_size(size));
+}  // xd_heap_alloc_by_policy()
+
+/**
+ * @brief Calls the quota callback of a heap that hit its quota (see
+ * `xd_heap_grow()`), without holding the heap's mutex since the callback may
+ * free blocks of the heap or raise the quota.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @note Must be called while holding the heap's mutex, it is released during
+ * the call and held again on return.
+ */
+static void xd_heap_quota_call(xd_heap *heap) {
+  xd_quota_callback callback = heap->quota_callback;
+  void *arg = heap->quota_arg;
+  size_t excess = xd_heap_quota_excess;
+  pthread_mutex_unlock(&heap->mutex);
+  xd_quota_active = true;
+  callback(heap, excess, arg);
+  xd_quota_active = false;
+  pthread_mutex_lock(&heap->mutex);
+}  // xd_heap_quota_call()
+
+/**
+ * @brief Allocates a block of the passed size from the passed heap.
+ *
+ * @param heap Pointer to the heap.
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on failure.
+ *
+ * @note If allocation fails due to lack of memory, `errno` is set to `ENOMEM`
+ * and `NULL` is returned.
+ */
+static void *xd_heap_malloc(xd_heap *heap, size_t size) {
+  pthread_mutex_lock(&heap->mutex);
+  xd_heap_grow_failed = false;
+
+  // corrupted heap, function wont work
+  if (heap == &xd_main_heap && sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&heap->mutex);
+    return NULL;
+  }
+
+  xd_heap_quota_excess = 0;
+  xd_mem_block_header *header = xd_heap_alloc_by_policy(heap, size);
+
+  // the heap hit its quota, the allocation is tried again once after the
+  // callback
+  if (header == NULL && xd_heap_quota_excess != 0) {
+    xd_heap_quota_call(heap);
+    header = xd_heap_alloc_by_policy(heap, size);
+  }
+
+  // out-of-memory failure, no free block and the heap couldn't grow
+  if (header == NULL) {
+    xd_heap_grow_failed = true;
+    errno = ENOMEM;
+    pthread_mutex_unlock(&heap->mutex);
+    return NULL;
+  }
+
+  // the blocks of the main heap are not freed by `xd_heap_free()`
+  if (heap != &xd_main_heap) {
+    heap->allocated += xd_block_get_size(header);
+  }
+  if (xd_tag_current != 0 && heap != &xd_internal_heap) {
+    xd_tag_add(heap, header);
+  }
+
+  pthread_mutex_unlock(&heap->mutex);
+  return (void *)header->data;
+}  // xd_heap_malloc()
+
+/**
+ * @brief Frees an allocated block of a heap other than the main heap.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the header of the block to be freed.
+ */
+static void xd_heap_free(xd_heap *heap, xd_mem_block_header *header) {
+  pthread_mutex_lock(&heap->mutex);
+
+  // double free is fatal abort
+  if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
+    pthread_mutex_unlock(&heap->mutex);
+    fprintf(stderr, "xd_free(): double free detected\n");
+    abort();
+  }
+
+  if (xd_block_is_tracked(header)) {
+    xd_block_untrack(header);
+  }
+
+  heap->allocated -= xd_block_get_size(header);
+  xd_block_free(heap, header);
+
+  pthread_mutex_unlock(&heap->mutex);
+}  // xd_heap_free()
+
+/**
+ * @brief Returns the heap of the passed lifetime hint.
+ *
+ * @param hint One of the `XD_HINT_*` constants.
+ *
+ * @return A pointer to the heap, or `NULL` if the hint is unknown.
+ */
+static xd_heap *xd_hint_heap(int hint) {
+  switch (hint) {
+    case XD_HINT_SHORT:
+      return &xd_hint_heaps[0];
+    case XD_HINT_LONG:
+      return &xd_hint_heaps[1];
+    case XD_HINT_PERMANENT:
+      return &xd_hint_heaps[2];
+    default:
+      return NULL;
+  }
+}  // xd_hint_heap()
+
+/**
+ * @brief Allocates a block of the passed size from the emergency reserve, used
+ * once the heaps failed to grow. The reserve hook is called when the first
+ * block is allocated (entering reserve mode).
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` with `errno`
+ * set to `ENOMEM` if the reserve is exhausted (or was never set up).
+ */
+static void *xd_reserve_malloc(size_t size) {
+  void *ptr = xd_heap_malloc(&xd_reserve_heap, size);
+  if (ptr == NULL) {
+    return NULL;
+  }
+  if (__atomic_fetch_add(&xd_reserve_blocks, 1, __ATOMIC_RELAXED) != 0) {
+    return ptr;
+  }
+
+  // call the hook without holding the mutex, it may allocate
+  pthread_mutex_lock(&xd_reserve_heap.mutex);
+  xd_reserve_hook hook = xd_reserve_hook_function;
+  void *arg = xd_reserve_hook_arg;
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+  if (hook != NULL) {
+    hook(size, arg);
+  }
+  return ptr;
+}  // xd_reserve_malloc()
+
+/**
+ * @brief Allocates a block of the passed size from the main heap, falling back
+ * to the emergency reserve once the heap failed to grow.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on failure.
+ */
+static void *xd_main_heap_malloc(size_t size) {
+  xd_soft_limit_check(size);
+  void *ptr = xd_heap_malloc(&xd_main_heap, size);
+  return (ptr == NULL && xd_heap_grow_failed) ? xd_reserve_malloc(size) : ptr;
+}  // xd_main_heap_malloc()
+
+/**
+ * @brief Allocates a block of the passed size for the passed call site, routing
+ * it to the heap of the site's predicted lifetime and sampling it when
+ * lifetime prediction is enabled.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ * @param site The return address of the allocation call.
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on failure.
+ */
+static void *xd_malloc_from(size_t size, uintptr_t site) {
+  // check the memory usage against the limit every few megabytes of growth
+  size_t interval = __atomic_load_n(&xd_memory_tight, __ATOMIC_RELAXED)
+                        ? XD_MEMORY_CHECK_INTERVAL / 4
+                        : XD_MEMORY_CHECK_INTERVAL;
+  if (__atomic_load_n(&xd_memory_grown, __ATOMIC_RELAXED) >= interval &&
+      __atomic_exchange_n(&xd_memory_grown, 0, __ATOMIC_RELAXED) >= interval) {
+    xd_memory_limit_check();
+  }
+
+  // allocations of a thread inside a mark are released together
+  if (xd_stage_depth > 0) {
+    return xd_stage_alloc(size);
+  }
+  if (xd_current_heap != NULL) {
+    return xd_heap_malloc(xd_current_heap, size);
+  }
+
+  size_t period = __atomic_load_n(&xd_predict_period, __ATOMIC_RELAXED);
+  if (period == 0) {
+    return xd_main_heap_malloc(size);
+  }
+
+  // the heap can't map chunks in real-time mode
+  xd_heap *heap = &xd_main_heap;
+  xd_predict_site *predict_site = xd_predict_site_find(site, false);
+  if (predict_site != NULL && !xd_rt_mode) {
+    xd_heap *hint_heap =
+        xd_hint_heap(__atomic_load_n(&predict_site->hint, __ATOMIC_RELAXED));
+    if (hint_heap != NULL) {
+      heap = hint_heap;
+    }
+  }
+
+  if (heap == &xd_main_heap) {
+    xd_soft_limit_check(size);
+  }
+  void *ptr = xd_heap_malloc(heap, size);
+  if (ptr == NULL) {
+    return xd_heap_grow_failed ? xd_reserve_malloc(size) : NULL;
+  }
+
+  // the cost of an allocation that is not sampled is the countdown
+  if (xd_predict_countdown > 0) {
+    xd_predict_countdown--;
+    return ptr;
+  }
+  xd_predict_countdown = period - 1;
+  xd_predict_sample_add(heap, xd_block_get_header_from_data(ptr), site);
+  return ptr;
+}  // xd_malloc_from()
+
+/**
+ * @brief Inserts the passed memory block header at the beginning of the free
+ * list.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param header A pointer to the memory block header to be inserted.
+ */
+static void xd_free_list_insert(xd_heap *heap, xd_mem_block_header *header) {
+  if (heap == &xd_main_heap) {
+    if (xd_rt_mode) {
+      xd_rt_bin_insert(header);
+      return;
+    }
+#ifdef XD_USE_DEFERRED_FREES
+    xd_free_index_set(header);
+    return;
+#endif
+  }
+
+  header->prev = NULL;
+  header->next = heap->free_list_head;
+
+  if (heap->free_list_head != NULL) {
+    heap->free_list_head->prev = header;
+  }
+
+  heap->free_list_head = header;
+}  // xd_free_list_insert()
+
+/**
+ * @brief Removes the passed memory block header from the free list.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param header A pointer to the memory block header to be removed.
+ */
+static void xd_free_list_remove(xd_heap *heap, xd_mem_block_header *header) {
+  if (heap == &xd_main_heap) {
+    if (xd_rt_mode) {
+      xd_rt_bin_remove(header);
+      return;
+    }
+#ifdef XD_USE_DEFERRED_FREES
+    xd_free_index_clear(header);
+    return;
+#endif
+  }
+
+  if (header->prev != NULL) {
+    header->prev->next = header->next;
+  }
+  if (header->next != NULL) {
+    header->next->prev = header->prev;
+  }
+
+  if (header == heap->free_list_head) {
+    heap->free_list_head = heap->free_list_head->next;
+  }
+}  // xd_free_list_remove()
+
+/**
+ * @brief Replaces a block in the free list with another block, keeping its
+ * position in the list.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param old_header A pointer to the header of the block in the free list.
+ * @param new_header A pointer to the header of the block to take its place.
+ *
+ * @note `old_header` must still hold its size when this function is called.
+ */
+static void xd_free_list_replace(xd_heap *heap,
+                                 xd_mem_block_header *old_header,
+                                 xd_mem_block_header *new_header) {
+  if (heap == &xd_main_heap) {
+    if (xd_rt_mode) {
+      // the new block may belong to a different bin
+      xd_rt_bin_remove(old_header);
+      xd_rt_bin_insert(new_header);
+      return;
+    }
+#ifdef XD_USE_DEFERRED_FREES
+    xd_free_index_clear(old_header);
+    xd_free_index_set(new_header);
+    return;
+#endif
+  }
+
+  new_header->prev = old_header->prev;
+  new_header->next = old_header->next;
+  if (new_header->prev != NULL) {
+    new_header->prev->next = new_header;
+  }
+  if (new_header->next != NULL) {
+    new_header->next->prev = new_header;
+  }
+  if (old_header == heap->free_list_head) {
+    heap->free_list_head = new_header;
+  }
+}  // xd_free_list_replace()
+
+/**
+ * @brief Changes the size of a block that is in the free list.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param header A pointer to the header of the block in the free list.
+ * @param size The new size of the block's data (in bytes).
+ */
+static void xd_free_list_resize(xd_heap *heap, xd_mem_block_header *header,
+                                size_t size) {
+  if (heap == &xd_main_heap && xd_rt_mode) {
+    // the block may move to a different bin
+    xd_rt_bin_remove(header);
+    xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+    xd_rt_bin_insert(header);
+    return;
+  }
+
+#ifdef XD_USE_DEFERRED_FREES
+  if (heap == &xd_main_heap) {
+    // the block may move to a different size class
+    xd_free_index_clear(header);
+    xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+    xd_free_index_set(header);
+    return;
+  }
+#endif
+
+  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+}  // xd_free_list_resize()
+
+/**
+ * @brief Searches the free list for a block that can satisfy the requested size
+ * and returns its header using First-Fit by default or Best-Fit if
+ * `XD_USE_BEST_FIT` is defined.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param size The requested size in bytes.
+ *
+ * @return A pointer to the header of a suitable free block, or `NULL` if no
+ * such block exists.
+ */
+static xd_mem_block_header *xd_free_list_find(xd_heap *heap, size_t size) {
+  if (heap == &xd_main_heap) {
+    if (xd_rt_mode) {
+      return xd_rt_bin_find(size);
+    }
+#ifdef XD_USE_DEFERRED_FREES
+    return xd_free_index_find(size);
+#endif
+  }
+
+#ifdef XD_USE_BEST_FIT
+  xd_mem_block_header *header = heap->free_list_head;
+  xd_mem_block_header *best_header = NULL;
+  while (header != NULL) {
+    if (xd_block_get_size(header) >= size) {
+      if (best_header == NULL ||
+          xd_block_get_size(header) < xd_block_get_size(best_header)) {
+        best_header = header;
+      }
+    }
+    header = header->next;
+  }
+  return best_header;
+#else
+  xd_mem_block_header *header = heap->free_list_head;
+  while (header != NULL && xd_block_get_size(header) < size) {
+    header = header->next;
+  }
+  return header;
+#endif
+}  // xd_free_list_find()
+
+/**
+ * @brief Searches the free list for a block that can satisfy the requested
+ * size, applying the pending frees first if no such block is found.
+ *
+ * @param heap Pointer to the heap owning the free list.
+ * @param size The requested size in bytes.
+ *
+ * @return A pointer to the header of a suitable free block, or `NULL` if no
+ * such block exists.
+ */
+static xd_mem_block_header *xd_free_list_find_or_drain(xd_heap *heap,
+                                                       size_t size) {
+  xd_mem_block_header *header = xd_free_list_find(heap, size);
+#ifdef XD_USE_DEFERRED_FREES
+  // only frees of the main heap are deferred
+  if (header == NULL && heap == &xd_main_heap && xd_pending_free_count > 0) {
+    xd_pending_free_drain();
+    header = xd_free_list_find(heap, size);
+  }
+#endif
+  return header;
+}  // xd_free_list_find_or_drain()
+
+/**
+ * @brief Returns the index of the real-time bin holding free blocks of the
+ * passed size.
+ *
+ * @param size The size of the block's data (in bytes), must not be `0`.
+ *
+ * @return The index of the bin (`floor(log2(size))`).
+ */
+static inline size_t xd_rt_bin_index(size_t size) {
+  return (XD_SIZE_BITS - 1) - (size_t)__builtin_clzl((unsigned long)size);
+}  // xd_rt_bin_index()
+
+/**
+ * @brief Inserts the passed memory block header at the beginning of its
+ * real-time bin.
+ *
+ * @param header A pointer to the memory block header to be inserted.
+ */
+static void xd_rt_bin_insert(xd_mem_block_header *header) {
+  size_t index = xd_rt_bin_index(xd_block_get_size(header));
+
+  header->prev = NULL;
+  header->next = xd_rt_bins[index];
+
+  if (xd_rt_bins[index] != NULL) {
+    xd_rt_bins[index]->prev = header;
+  }
+
+  xd_rt_bins[index] = header;
+  xd_rt_bins_bitmap |= (size_t)1 << index;
+}  // xd_rt_bin_insert()
+
+/**
+ * @brief Removes the passed memory block header from its real-time bin.
+ *
+ * @param header A pointer to the memory block header to be removed.
+ */
+static void xd_rt_bin_remove(xd_mem_block_header *header) {
+  size_t index = xd_rt_bin_index(xd_block_get_size(header));
+
+  if (header->prev != NULL) {
+    header->prev->next = header->next;
+  }
+  if (header->next != NULL) {
+    header->next->prev = header->prev;
+  }
+
+  if (header == xd_rt_bins[index]) {
+    xd_rt_bins[index] = header->next;
+    if (xd_rt_bins[index] == NULL) {
+      xd_rt_bins_bitmap &= ~((size_t)1 << index);
+    }
+  }
+}  // xd_rt_bin_remove()
+
+/**
+ * @brief Finds a free block that can satisfy the requested size in constant
+ * time using the real-time bins.
+ *
+ * Only the head of the bin the size falls in is checked, otherwise the head of
+ * the first non-empty bin whose blocks are all large enough is taken.
+ *
+ * @param size The requested size in bytes.
+ *
+ * @return A pointer to the header of a suitable free block, or `NULL` if no
+ * such block exists.
+ */
+static xd_mem_block_header *xd_rt_bin_find(size_t size) {
+  size_t index = xd_rt_bin_index(size);
+  xd_mem_block_header *header = xd_rt_bins[index];
+  if (header != NULL && xd_block_get_size(header) >= size) {
+    return header;
+  }
+
+  // all the blocks in the bins after `index` are larger than `size`
+  if (index + 1 >= XD_RT_BIN_COUNT) {
+    return NULL;
+  }
+  size_t bitmap = xd_rt_bins_bitmap & ~(((size_t)1 << (index + 1)) - 1);
+  if (bitmap == 0) {
+    return NULL;
+  }
+  return xd_rt_bins[__builtin_ctzl((unsigned long)bitmap)];
+}  // xd_rt_bin_find()
+
+/**
+ * @brief Locks all the heap pages managed by this library into RAM.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set by `mlock()`.
+ */
+static int xd_rt_lock_heap() {
+  size_t length = (size_t)((xd_byte *)xd_heap_end_address -
+                           (xd_byte *)xd_heap_start_address);
+  if (length == 0) {
+    return 0;
+  }
+  return mlock(xd_heap_start_address, length);
+}  // xd_rt_lock_heap()
+
+/**
+ * @brief Initializes a new chunk with fenceposts and a free block.
+ *
+ * @param chunk Pointer to the start of the chunk.
+ * @param size The size of the chunk (in bytes), including space for 2
+ * fenceposts and a block header.
+ *
+ * @return A pointer to the free block header.
+ */
+static xd_mem_block_header *xd_heap_chunk_format(void *chunk, size_t size) {
+  // clean block size (data section)
+  size -= 3 * XD_BLOCK_HEADER_SIZE;
+
+  // create the left fencepost
+  xd_mem_block_header *left_fencepost = (xd_mem_block_header *)chunk;
+  xd_block_set_size_and_state(left_fencepost, 0, XD_MEM_BLOCK_FENCEPOST);
+  left_fencepost->prev_size = 0;
+
+  // create the free block
+  xd_mem_block_header *chunk_header = xd_block_get_next(left_fencepost);
+  xd_block_set_size_and_state(chunk_header, size, XD_MEM_BLOCK_UNALLOCATED);
+  chunk_header->prev_size = 0;
+
+  // create the right fencepost
+  xd_mem_block_header *right_fencepost = xd_block_get_next(chunk_header);
+  xd_block_set_size_and_state(right_fencepost, 0, XD_MEM_BLOCK_FENCEPOST);
+  right_fencepost->prev_size = size;
+
+  return chunk_header;
+}  // xd_heap_chunk_format()
+
+/**
+ * @brief Requests a heap chunk from the OS and initializes it with fenceposts
+ * and a free block.
+ *
+ * The new chunk includes space for 2 fenceposts and a block header.
+ *
+ * @param size The required size of the usable data block in bytes.
+ *
+ * @return A pointer to the free block header on success, or `NULL` on
+ * failure.
+ */
+static void *xd_heap_chunk_create(size_t size) {
+  // ensure enough space for header and two fenceposts (left + right)
+  size += 3 * XD_BLOCK_HEADER_SIZE;
+
+  // roundup to multiple of XD_ARENA_SIZE
+  if (size % XD_ARENA_SIZE != 0) {
+    size += XD_ARENA_SIZE - (size % XD_ARENA_SIZE);
+  }
+
+#ifdef XD_USE_DEFERRED_FREES
+  // make sure the side tables cover the grown heap
+  size_t heap_size = (size_t)((xd_byte *)xd_heap_end_address -
+                              (xd_byte *)xd_heap_start_address) +
+                     size;
+  if (xd_side_tables_reserve(heap_size) != 0) {
+    return NULL;
+  }
+#endif
+
+  // increase heap size (request the chunk)
+  void *chunk = sbrk((intptr_t)size);
+  if (chunk == (void *)-1 || (intptr_t)chunk % XD_ALIGNMENT != 0) {
+    return NULL;
+  }
+
+  xd_heap_end_address = sbrk(0);
+
+  return xd_heap_chunk_format(chunk, size);
+}  // xd_heap_chunk_create()
+
+/**
+ * @brief Returns the size of the chunk `xd_heap_chunk_map()` maps for a block
+ * of the passed size.
+ *
+ * @param size The required size of the usable data block in bytes.
+ *
+ * @return The size of the chunk in bytes, or `0` if it overflows.
+ */
+static size_t xd_heap_chunk_map_size(size_t size) {
+  // ensure enough space for header and two fenceposts (left + right)
+  if (size > SIZE_MAX - XD_HEAP_CHUNK_SIZE) {
+    return 0;
+  }
+  size += 3 * XD_BLOCK_HEADER_SIZE;
+
+  // roundup to multiple of XD_HEAP_CHUNK_SIZE
+  if (size % XD_HEAP_CHUNK_SIZE != 0) {
+    size += XD_HEAP_CHUNK_SIZE - (size % XD_HEAP_CHUNK_SIZE);
+  }
+  return size;
+}  // xd_heap_chunk_map_size()
+
+/**
+ * @brief Maps a chunk for a heap other than the main heap and initializes it
+ * with fenceposts and a free block.
+ *
+ * The chunk is mapped right after the heap's recent chunk when that address
+ * range is free, so the two chunks can be coalesced. The chunks of
+ * `xd_shareable_heap` are instead backed by their own memfd each, only rounded
+ * up to whole pages since they hold a single block, and are not inherited by
+ * child processes (see `xd_malloc_atfork_child()`).
+ *
+ * @param heap Pointer to the heap.
+ * @param size The required size of the usable data block in bytes.
+ *
+ * @return A pointer to the free block header on success, or `NULL` on
+ * failure.
+ */
+static void *xd_heap_chunk_map(xd_heap *heap, size_t size) {
+  if (heap == &xd_shareable_heap) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > SIZE_MAX - (3 * XD_BLOCK_HEADER_SIZE) - page_size) {
+      return NULL;
+    }
+    size += 3 * XD_BLOCK_HEADER_SIZE;
+    size = (size + page_size - 1) & ~(page_size - 1);
+  }
+  else {
+    size = xd_heap_chunk_map_size(size);
+  }
+  if (size == 0) {
+    return NULL;
+  }
+
+  void *hint = NULL;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  int fd = -1;
+  if (heap == &xd_shareable_heap) {
+    flags = MAP_SHARED;
+    fd = memfd_create("xd_shareable", MFD_CLOEXEC);
+    if (fd == -1) {
+      return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+      close(fd);
+      return NULL;
+    }
+  }
+  else if (heap->recent_chunk_right_fencepost != NULL) {
+    hint = (xd_byte *)heap->recent_chunk_right_fencepost + XD_BLOCK_HEADER_SIZE;
+  }
+  void *chunk = mmap(hint, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if (chunk == MAP_FAILED) {
+    if (fd != -1) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  // a child would allocate from the free blocks of the shared chunk while the
+  // parent does too
+  if (fd != -1 && madvise(chunk, size, MADV_DONTFORK) != 0) {
+    munmap(chunk, size);
+    close(fd);
+    return NULL;
+  }
+
+  if (xd_chunk_registry_add(chunk, (xd_byte *)chunk + size, heap, fd) != 0) {
+    munmap(chunk, size);
+    if (fd != -1) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  return xd_heap_chunk_format(chunk, size);
+}  // xd_heap_chunk_map()
+
+/**
+ * @brief Frees a block of `xd_malloc_shareable()`, unmapping its chunk and
+ * closing its memfd.
+ *
+ * @param ptr Pointer to the block's data.
+ */
+static void xd_shareable_free(void *ptr) {
+  xd_chunk_range range;
+  if (!xd_chunk_registry_find(ptr, &range)) {
+    return;
+  }
+  size_t size = (size_t)((xd_byte *)range.end - (xd_byte *)range.start);
+
+  pthread_mutex_lock(&xd_shareable_heap.mutex);
+  xd_shareable_heap.mapped -= size;
+  xd_shareable_heap.allocated -=
+      xd_block_get_size(xd_block_get_header_from_data(ptr));
+  pthread_mutex_unlock(&xd_shareable_heap.mutex);
+
+  // removed first, so the range isn't found once another mapping reuses it
+  xd_chunk_registry_remove(range.start);
+  munmap(range.start, size);
+  close(range.fd);
+}  // xd_shareable_free()
+
+/**
+ * @brief Attempts to coalesce a new heap chunk with the chunk created before
+ * it.
+ *
+ * @param heap Pointer to the heap owning the chunks.
+ * @param chunk_header A pointer to the heap chunk (initialized as free block).
+ *
+ * @return `true` on success, `false` otherwise.
+ */
+static bool xd_heap_chunk_try_coalesce(xd_heap *heap,
+                                       xd_mem_block_header *chunk_header) {
+  // this is the first allocated chunk, can't coalesce
+  if (heap->recent_chunk_right_fencepost == NULL) {
+    return false;
+  }
+
+  xd_mem_block_header *left_fencepost = xd_block_get_prev(chunk_header);
+  xd_mem_block_header *prev_chunk_right_fencepost =
+      xd_block_get_prev(left_fencepost);
+
+  // the recent chunk is not adjacent to the new chunk, can't coalesce
+  if (prev_chunk_right_fencepost != heap->recent_chunk_right_fencepost) {
+    return false;
+  }
+
+  size_t chunk_size = xd_block_get_size(chunk_header);
+
+  // get the last block in the previous chunk
+  xd_mem_block_header *prev_chunk_last_block =
+      xd_block_get_prev(prev_chunk_right_fencepost);
+
+  if (xd_block_get_state(prev_chunk_last_block) == XD_MEM_BLOCK_UNALLOCATED) {
+    // last block is unallocated, coalesce with the block
+    // remove the fenceposts
+    chunk_header = prev_chunk_last_block;
+    chunk_size +=
+        xd_block_get_size(prev_chunk_last_block) + (3 * XD_BLOCK_HEADER_SIZE);
+
+    // remove the block from list to be re-inserted at the beginning
+    xd_free_list_remove(heap, chunk_header);
+  }
+  else {
+    // last block is allocated, just remove the fenceposts
+    chunk_header = prev_chunk_right_fencepost;
+    chunk_size += 2 * XD_BLOCK_HEADER_SIZE;
+
+    chunk_header->prev_size = xd_block_get_size(prev_chunk_last_block);
+  }
+
+  // initialize the header after coalescing
+  xd_block_set_size_and_state(chunk_header, chunk_size,
+                              XD_MEM_BLOCK_UNALLOCATED);
+
+  // update the right fencepost meta data
+  xd_mem_block_header *right_fencepost = xd_block_get_next(chunk_header);
+  right_fencepost->prev_size = chunk_size;
+  heap->recent_chunk_right_fencepost = right_fencepost;
+
+  // insert the coalesced block into the free list
+  xd_free_list_insert(heap, chunk_header);
+
+  // colaescing succeeded
+  return true;
+}  // xd_heap_chunk_try_coalesce()
+
+/**
+ * @brief Grows the heap by a new chunk large enough for a block of the passed
+ * size and adds it to the free list (coalescing it with the recent chunk if
+ * possible).
+ *
+ * @param heap Pointer to the heap, the main heap is grown using `sbrk()` and
+ * the other heaps using `mmap()`.
+ * @param size The required size of the usable data block in bytes.
+ *
+ * @return A pointer to the header of a free block of at least the passed size
+ * on success, or `NULL` on failure (setting `xd_heap_quota_excess` if the
+ * quota callback should be called).
+ *
+ * @note Must be called while holding the heap's mutex, it is never released.
+ */
+static xd_mem_block_header *xd_heap_grow(xd_heap *heap, size_t size) {
+  // keep the heap within its quota, the callback is called by
+  // `xd_heap_malloc()` once the mutex is released
+  size_t chunk_size = xd_heap_chunk_map_size(size);
+  if (heap != &xd_main_heap && heap->quota != 0 &&
+      (chunk_size == 0 || heap->mapped + chunk_size > heap->quota)) {
+    if (heap->quota_callback != NULL && !xd_quota_active && chunk_size != 0) {
+      xd_heap_quota_excess = heap->mapped + chunk_size - heap->quota;
+    }
+    return NULL;
+  }
+
+  xd_mem_block_header *chunk_header = (heap == &xd_main_heap)
+                                          ? xd_heap_chunk_create(size)
+                                          : xd_heap_chunk_map(heap, size);
+  if (chunk_header == NULL) {
+    return NULL;
+  }
+  if (heap != &xd_main_heap) {
+    heap->mapped += chunk_size;
+  }
+  __atomic_add_fetch(&xd_memory_grown, xd_block_get_size(chunk_header),
+                     __ATOMIC_RELAXED);
+
+  // coalesce or insert to free list
+  if (!xd_heap_chunk_try_coalesce(heap, chunk_header)) {
+    xd_free_list_insert(heap, chunk_header);
+    heap->recent_chunk_right_fencepost = xd_block_get_next(chunk_header);
+  }
+
+  return xd_free_list_find(heap, size);
+}  // xd_heap_grow()
+
+/**
+ * @brief Returns the free space at the top of the main heap to the OS, if the
+ * last block of the recent chunk is unallocated and at least `XD_ARENA_SIZE`
+ * bytes can be released.
+ *
+ * Nothing is returned in real-time mode, the heap was reserved up front and
+ * can't grow back implicitly.
+ *
+ * @note Must be called while holding `xd_main_heap.mutex`.
+ */
+static void xd_heap_trim() {
+  if (xd_rt_mode) {
+    return;
+  }
+
+  xd_mem_block_header *right_fencepost =
+      xd_main_heap.recent_chunk_right_fencepost;
+  if (right_fencepost == NULL ||
+      (xd_byte *)xd_block_get_next(right_fencepost) !=
+          (xd_byte *)xd_heap_end_address) {
+    return;
+  }
+
+  xd_mem_block_header *last_block = xd_block_get_prev(right_fencepost);
+  if (xd_block_get_state(last_block) != XD_MEM_BLOCK_UNALLOCATED) {
+    return;
+  }
+
+  // keep the block large enough to stay in the free list, release whole pages
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t excess = xd_block_get_size(last_block) - XD_MIN_ALLOC_SIZE;
+  excess -= excess % page_size;
+  if (excess < XD_ARENA_SIZE) {
+    return;
+  }
+
+  size_t size = xd_block_get_size(last_block) - excess;
+  xd_free_list_resize(&xd_main_heap, last_block, size);
+  right_fencepost = xd_block_get_next(last_block);
+  xd_block_set_size_and_state(right_fencepost, 0, XD_MEM_BLOCK_FENCEPOST);
+  right_fencepost->prev_size = size;
+  xd_main_heap.recent_chunk_right_fencepost = right_fencepost;
+
+  sbrk(-(intptr_t)excess);
+  xd_heap_end_address = sbrk(0);
+}  // xd_heap_trim()
+
+/**
+ * @brief Faults in the pages of the passed range, used as a prefault thread
+ * entry point.
+ *
+ * Every page is read and written back with the same value, so the contents of
+ * the range (such as free list pointers) are preserved.
+ *
+ * @param arg Pointer to the `xd_prefault_range` to be faulted in.
+ *
+ * @return Always `NULL`.
+ */
+static void *xd_prefault_worker(void *arg) {
+  xd_prefault_range *range = (xd_prefault_range *)arg;
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  for (xd_byte *page = range->start; page < range->end; page += page_size) {
+    volatile xd_byte *byte = page;
+    *byte = *byte;
+  }
+  return NULL;
+}  // xd_prefault_worker()
+
+/**
+ * @brief Faults in all pages starting within the passed range, the partial
+ * page holding its start is left alone.
+ *
+ * Uses `MADV_POPULATE_WRITE` when available (the `sbrk()` heap equivalent of
+ * `MAP_POPULATE`), and falls back to touching every page otherwise.
+ *
+ * @param start The start of the range (inclusive).
+ * @param end The end of the range (exclusive).
+ * @param parallel If `true`, the pages are touched by one thread per online
+ * CPU.
+ *
+ * @note Must be called while holding `xd_main_heap.mutex`, so no other thread
+ * can allocate from the range while its pages are being touched.
+ */
+static void xd_prefault(xd_byte *start, xd_byte *end, bool parallel) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+  // align the start up, the page holding it may also hold the tail of a block
+  // another thread is writing to, which touching it could undo
+  start = (xd_byte *)(((uintptr_t)start + page_size - 1) &
+                      ~(uintptr_t)(page_size - 1));
+  if (start >= end) {
+    return;
+  }
+
+  size_t length = (size_t)(end - start);
+
+#ifdef MADV_POPULATE_WRITE
+  if (!parallel && madvise(start, length, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+#endif
+
+  size_t thread_count = 1;
+  if (parallel) {
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = (cpu_count > 0) ? (size_t)cpu_count : 1;
+    if (thread_count > XD_PREFAULT_MAX_THREADS) {
+      thread_count = XD_PREFAULT_MAX_THREADS;
+    }
+    if (thread_count > length / XD_PREFAULT_MIN_SLICE) {
+      thread_count = length / XD_PREFAULT_MIN_SLICE;
+    }
+    if (thread_count == 0) {
+      thread_count = 1;
+    }
+  }
+
+  // split the range into page-aligned slices, one per thread
+  size_t slice = length / thread_count;
+  slice -= slice % page_size;
+
+  pthread_t threads[XD_PREFAULT_MAX_THREADS];
+  xd_prefault_range ranges[XD_PREFAULT_MAX_THREADS];
+  bool started[XD_PREFAULT_MAX_THREADS];
+  for (size_t i = 0; i < thread_count; i++) {
+    ranges[i].start = start + (i * slice);
+    ranges[i].end = (i == thread_count - 1) ? end : ranges[i].start + slice;
+    started[i] = (i != 0) &&
+                 pthread_create(&threads[i], NULL, xd_prefault_worker,
+                                &ranges[i]) == 0;
+  }
+
+  // the calling thread handles the first slice and any slice whose thread
+  // failed to start
+  for (size_t i = 0; i < thread_count; i++) {
+    if (!started[i]) {
+      xd_prefault_worker(&ranges[i]);
+    }
+  }
+  for (size_t i = 0; i < thread_count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}  // xd_prefault()
+
+/**
+ * @brief Returns the size of the blocks held by a band of the pre-zeroed pool.
+ *
+ * @param band The index of the band.
+ *
+ * @return The size of the band's blocks (in bytes).
+ */
+static inline size_t xd_zero_pool_band_size(size_t band) {
+  return (size_t)XD_ZERO_POOL_MIN_SIZE << band;
+}  // xd_zero_pool_band_size()
+
+/**
+ * @brief Returns the index of the pre-zeroed pool band serving the passed
+ * size.
+ *
+ * A band serves the sizes larger than half its block size, so no more than
+ * half of a pooled block is wasted.
+ *
+ * @param size The requested size (in bytes).
+ *
+ * @return The index of the band, or `-1` if the size is not served by the pool.
+ */
+static inline int xd_zero_pool_band_index(size_t size) {
+  if (size < XD_ZERO_POOL_MIN_SIZE) {
+    return -1;
+  }
+  for (size_t band = 0; band < XD_ZERO_POOL_BAND_COUNT; band++) {
+    if (size <= xd_zero_pool_band_size(band)) {
+      return (int)band;
+    }
+  }
+  return -1;
+}  // xd_zero_pool_band_index()
+
+/**
+ * @brief Takes a pre-zeroed block of at least the passed size from the pool
+ * and wakes the pool thread to refill it.
+ *
+ * @param size The requested size (in bytes).
+ *
+ * @return A pointer to the zeroed block, or `NULL` if the pool is not running
+ * or has no block for the passed size.
+ */
+static void *xd_zero_pool_take(size_t size) {
+  if (!__atomic_load_n(&xd_zero_pool_running, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  int band = xd_zero_pool_band_index(size);
+  if (band < 0) {
+    return NULL;
+  }
+
+  void *ptr = NULL;
+  pthread_mutex_lock(&xd_zero_pool_mutex);
+  if (xd_zero_pool[band].count > 0) {
+    ptr = xd_zero_pool[band].blocks[--xd_zero_pool[band].count];
+    pthread_cond_signal(&xd_zero_pool_cond);
+  }
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
+  return ptr;
+}  // xd_zero_pool_take()
+
+/**
+ * @brief Entry point of the pool thread, keeps every band of the pre-zeroed
+ * pool full by allocating blocks and zeroing them (which also faults their
+ * pages in) off the latency-critical threads.
+ *
+ * @param arg Unused.
+ *
+ * @return Always `NULL`.
+ */
+static void *xd_zero_pool_worker(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&xd_zero_pool_mutex);
+  while (xd_zero_pool_running) {
+    // find the first band that is not full
+    size_t band = 0;
+    while (band < XD_ZERO_POOL_BAND_COUNT &&
+           xd_zero_pool[band].count == XD_ZERO_POOL_BAND_DEPTH) {
+      band++;
+    }
+    // don't keep zeroed blocks around while memory is tight
+    if (band == XD_ZERO_POOL_BAND_COUNT ||
+        __atomic_load_n(&xd_memory_tight, __ATOMIC_RELAXED)) {
+      pthread_cond_wait(&xd_zero_pool_cond, &xd_zero_pool_mutex);
+      continue;
+    }
+
+    // allocate and zero the block without holding the pool mutex
+    size_t size = xd_zero_pool_band_size(band);
+    pthread_mutex_unlock(&xd_zero_pool_mutex);
+    void *ptr = xd_malloc(size);
+    if (ptr != NULL) {
+      memset(ptr, 0, size);
+    }
+    pthread_mutex_lock(&xd_zero_pool_mutex);
+
+    if (ptr == NULL) {
+      // out of memory, wait before trying again
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += XD_ZERO_POOL_RETRY_MS * 1000000L;
+      deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+      deadline.tv_nsec %= 1000000000L;
+      pthread_cond_timedwait(&xd_zero_pool_cond, &xd_zero_pool_mutex,
+                             &deadline);
+      continue;
+    }
+
+    if (xd_zero_pool_running &&
+        xd_zero_pool[band].count < XD_ZERO_POOL_BAND_DEPTH) {
+      xd_zero_pool[band].blocks[xd_zero_pool[band].count++] = ptr;
+    }
+    else {
+      pthread_mutex_unlock(&xd_zero_pool_mutex);
+      xd_free(ptr);
+      pthread_mutex_lock(&xd_zero_pool_mutex);
+    }
+  }
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
+
+  return NULL;
+}  // xd_zero_pool_worker()
+
+/**
+ * @brief Returns the current monotonic time in nanoseconds.
+ */
+static inline uint64_t xd_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}  // xd_now_ns()
+
+/**
+ * @brief Hashes an address for the lifetime prediction tables.
+ *
+ * @param address The address to be hashed.
+ *
+ * @return The hash of the address (to be masked by the table size).
+ */
+static inline size_t xd_hash_address(uintptr_t address) {
+  return (size_t)(((uint64_t)address * 0x9E3779B97F4A7C15ULL) >> 32);
+}  // xd_hash_address()
+
+/**
+ * @brief Finds the slot of a call site in `xd_predict_sites`.
+ *
+ * @param address The return address of the call site.
+ * @param insert Whether to add the site if it isn't found, must be `true` only
+ * while holding `xd_predict_mutex`.
+ *
+ * @return A pointer to the site's slot, or `NULL` if it isn't found (or can't
+ * be added).
+ */
+static xd_predict_site *xd_predict_site_find(uintptr_t address, bool insert) {
+  size_t index = xd_hash_address(address);
+  for (size_t probe = 0; probe < XD_PREDICT_SITE_PROBES; probe++) {
+    xd_predict_site *site =
+        &xd_predict_sites[(index + probe) & (XD_PREDICT_SITE_COUNT - 1)];
+    uintptr_t site_address =
+        __atomic_load_n(&site->address, __ATOMIC_ACQUIRE);
+    if (site_address == address) {
+      return site;
+    }
+    if (site_address == 0) {
+      if (!insert) {
+        return NULL;
+      }
+      __atomic_store_n(&site->address, address, __ATOMIC_RELEASE);
+      return site;
+    }
+  }
+  return NULL;
+}  // xd_predict_site_find()
+
+/**
+ * @brief Counts the observed lifetime of a sampled block of a call site and
+ * updates the site's predicted lifetime.
+ *
+ * A site is predicted short-lived (or long-lived) when at least 90% of its
+ * samples are.
+ *
+ * @param site Pointer to the call site.
+ * @param age_ns The lifetime of the block (in nanoseconds).
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_predict_site_count(xd_predict_site *site, uint64_t age_ns) {
+  if (age_ns < XD_PREDICT_SHORT_NS) {
+    site->short_count++;
+  }
+  else if (age_ns >= XD_PREDICT_LONG_NS) {
+    site->long_count++;
+  }
+  else {
+    site->medium_count++;
+  }
+
+  uint32_t total = site->short_count + site->medium_count + site->long_count;
+  if (total >= XD_PREDICT_MAX_SAMPLES) {
+    site->short_count /= 2;
+    site->medium_count /= 2;
+    site->long_count /= 2;
+  }
+  if (total < XD_PREDICT_MIN_SAMPLES) {
+    return;
+  }
+
+  int hint = 0;
+  if ((uint64_t)site->short_count * 10 >= (uint64_t)total * 9) {
+    hint = XD_HINT_SHORT;
+  }
+  else if ((uint64_t)site->long_count * 10 >= (uint64_t)total * 9) {
+    hint = XD_HINT_LONG;
+  }
+  __atomic_store_n(&site->hint, hint, __ATOMIC_RELAXED);
+}  // xd_predict_site_count()
+
+/**
+ * @brief Records a sampled block of a call site and marks it as tracked.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the header of the allocated block.
+ * @param address The return address of the call site.
+ */
+static void xd_predict_sample_add(xd_heap *heap, xd_mem_block_header *header,
+                                  uintptr_t address) {
+  // the stack is captured before taking the mutexes, it is only used by leak
+  // reports
+  uintptr_t stack[XD_LEAK_STACK_DEPTH] = {address};
+  if (__atomic_load_n(&xd_leak_stacks, __ATOMIC_RELAXED)) {
+    xd_leak_stack_capture(address, stack);
+  }
+
+  pthread_mutex_lock(&heap->mutex);
+  pthread_mutex_lock(&xd_predict_mutex);
+
+  xd_predict_age(heap);
+
+  xd_predict_site *site = xd_predict_site_find(address, true);
+  if (site != NULL &&
+      xd_predict_sample_count < (XD_PREDICT_SAMPLE_COUNT / 4) * 3) {
+    size_t index = xd_hash_address((uintptr_t)header);
+    while (xd_predict_samples[index & (XD_PREDICT_SAMPLE_COUNT - 1)].header !=
+           NULL) {
+      index++;
+    }
+    xd_predict_sample *sample =
+        &xd_predict_samples[index & (XD_PREDICT_SAMPLE_COUNT - 1)];
+    *sample = (xd_predict_sample){header, heap, site, xd_now_ns(), {0}};
+    memcpy(sample->stack, stack, sizeof(stack));
+    xd_predict_sample_count++;
+    xd_block_set_tracked(header, true);
+  }
+
+  pthread_mutex_unlock(&xd_predict_mutex);
+  pthread_mutex_unlock(&heap->mutex);
+}  // xd_predict_sample_add()
+
+/**
+ * @brief Removes the record of a sampled block being freed, counting its
+ * lifetime, and clears its tracked flag.
+ *
+ * @param header Pointer to the header of the sampled block.
+ *
+ * @note Must be called while holding the mutex of the heap owning the block.
+ */
+static void xd_predict_sample_remove(xd_mem_block_header *header) {
+  pthread_mutex_lock(&xd_predict_mutex);
+
+  // the block may be kept for leak reports only, or be tracked only by
+  // another side table
+  const size_t mask = XD_PREDICT_SAMPLE_COUNT - 1;
+  size_t index = xd_hash_address((uintptr_t)header) & mask;
+  while (xd_predict_samples[index].header != header) {
+    if (xd_predict_samples[index].header == NULL) {
+      xd_leak_sample_remove(header);
+      pthread_mutex_unlock(&xd_predict_mutex);
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+
+  xd_predict_sample *sample = &xd_predict_samples[index];
+  xd_predict_site_count(sample->site, xd_now_ns() - sample->time_ns);
+  xd_predict_sample_delete(index);
+
+  pthread_mutex_unlock(&xd_predict_mutex);
+
+  xd_block_set_tracked(header, false);
+}  // xd_predict_sample_remove()
+
+/**
+ * @brief Empties a sample slot, shifting back the following samples of its
+ * probe sequence.
+ *
+ * @param index The index of the slot.
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_predict_sample_delete(size_t index) {
+  const size_t mask = XD_PREDICT_SAMPLE_COUNT - 1;
+  size_t next = index;
+  while (true) {
+    next = (next + 1) & mask;
+    if (xd_predict_samples[next].header == NULL) {
+      break;
+    }
+    size_t home = xd_hash_address((uintptr_t)xd_predict_samples[next].header) &
+                  mask;
+    bool in_place = (index <= next) ? (index < home && home <= next)
+                                    : (index < home || home <= next);
+    if (!in_place) {
+      xd_predict_samples[index] = xd_predict_samples[next];
+      index = next;
+    }
+  }
+  xd_predict_samples[index].header = NULL;
+  xd_predict_sample_count--;
+}  // xd_predict_sample_delete()
+
+/**
+ * @brief Checks the next `XD_PREDICT_AGE_SCAN` sample slots, the samples that
+ * reached `XD_PREDICT_LONG_NS` are counted as long-lived and evicted, so the
+ * slots of blocks that are never freed are reused for new samples.
+ *
+ * While allocation stacks are recorded, an evicted block moves to
+ * `xd_leak_samples` and stays tracked, since it may be a leak. Otherwise its
+ * tracked flag is cleared if it belongs to the passed heap and has no tag, or
+ * left set (another thread may be freeing the block), and freeing the block
+ * finds no sample.
+ *
+ * @param heap Pointer to the heap whose mutex is held.
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_predict_age(xd_heap *heap) {
+  uint64_t now_ns = xd_now_ns();
+  for (size_t i = 0; i < XD_PREDICT_AGE_SCAN; i++) {
+    size_t index = xd_predict_age_cursor;
+    xd_predict_age_cursor = (index + 1) & (XD_PREDICT_SAMPLE_COUNT - 1);
+    xd_predict_sample *sample = &xd_predict_samples[index];
+    if (sample->header == NULL ||
+        now_ns - sample->time_ns < XD_PREDICT_LONG_NS) {
+      continue;
+    }
+    xd_predict_site_count(sample->site, now_ns - sample->time_ns);
+    if (__atomic_load_n(&xd_leak_stacks, __ATOMIC_RELAXED)) {
+      xd_leak_sample_add(sample->header, sample->stack);
+      xd_predict_sample_delete(index);
+      continue;
+    }
+
+    xd_mem_block_header *header = sample->header;
+    bool owned = (sample->heap == heap);
+    xd_predict_sample_delete(index);
+    if (owned) {
+      pthread_mutex_lock(&xd_tag_mutex);
+      if (xd_tag_find(header) == 0) {
+        xd_block_set_tracked(header, false);
+      }
+      pthread_mutex_unlock(&xd_tag_mutex);
+    }
+  }
+}  // xd_predict_age()
+
+/**
+ * @brief Maps the tag table with twice as many slots (or
+ * `XD_TAG_TABLE_MIN_COUNT` for the first one) and moves the records to it.
+ *
+ * @return `true` on success, `false` on failure.
+ *
+ * @note Must be called while holding `xd_tag_mutex`.
+ */
+static bool xd_tag_table_grow() {
+  size_t capacity = (xd_tag_record_capacity == 0) ? XD_TAG_TABLE_MIN_COUNT
+                                                  : 2 * xd_tag_record_capacity;
+  xd_tag_record *records =
+      mmap(NULL, capacity * sizeof(xd_tag_record), PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (records == MAP_FAILED) {
+    return false;
+  }
+
+  for (size_t i = 0; i < xd_tag_record_capacity; i++) {
+    if (xd_tag_records[i].header == NULL) {
+      continue;
+    }
+    size_t index = xd_hash_address((uintptr_t)xd_tag_records[i].header);
+    while (records[index & (capacity - 1)].header != NULL) {
+      index++;
+    }
+    records[index & (capacity - 1)] = xd_tag_records[i];
+  }
+  if (xd_tag_records != NULL) {
+    munmap(xd_tag_records, xd_tag_record_capacity * sizeof(xd_tag_record));
+  }
+  xd_tag_records = records;
+  xd_tag_record_capacity = capacity;
+  return true;
+}  // xd_tag_table_grow()
+
+/**
+ * @brief Empties a slot of the tag table, shifting back the following records
+ * of its probe sequence.
+ *
+ * @param index The index of the slot.
+ *
+ * @note Must be called while holding `xd_tag_mutex`.
+ */
+static void xd_tag_table_delete(size_t index) {
+  const size_t mask = xd_tag_record_capacity - 1;
+  size_t next = index;
+  while (true) {
+    next = (next + 1) & mask;
+    if (xd_tag_records[next].header == NULL) {
+      break;
+    }
+    size_t home = xd_hash_address((uintptr_t)xd_tag_records[next].header) &
+                  mask;
+    bool in_place = (index <= next) ? (index < home && home <= next)
+                                    : (index < home || home <= next);
+    if (!in_place) {
+      xd_tag_records[index] = xd_tag_records[next];
+      index = next;
+    }
+  }
+  xd_tag_records[index].header = NULL;
+  xd_tag_record_count--;
+}  // xd_tag_table_delete()
+
+/**
+ * @brief Records a block allocated while a tag is current, counts it in the
+ * tag's statistics, and marks it as tracked.
+ *
+ * @param heap Pointer to the heap owning the block.
+ * @param header Pointer to the header of the allocated block.
+ *
+ * @note Must be called while holding the mutex of the heap owning the block.
+ * @note The block is left untagged if the table cannot grow.
+ */
+static void xd_tag_add(xd_heap *heap, xd_mem_block_header *header) {
+  pthread_mutex_lock(&xd_tag_mutex);
+
+  if ((xd_tag_record_count + 1) * 4 > xd_tag_record_capacity * 3 &&
+      !xd_tag_table_grow()) {
+    pthread_mutex_unlock(&xd_tag_mutex);
+    return;
+  }
+
+  size_t index = xd_hash_address((uintptr_t)header);
+  while (xd_tag_records[index & (xd_tag_record_capacity - 1)].header != NULL) {
+    index++;
+  }
+  xd_tag_records[index & (xd_tag_record_capacity - 1)] =
+      (xd_tag_record){header, heap, xd_tag_current};
+  xd_tag_record_count++;
+
+  size_t size = xd_block_get_size(header);
+  xd_tag_stats *stats = &xd_tag_stats_table[xd_tag_current];
+  stats->live_bytes += size;
+  stats->live_blocks++;
+  stats->total_bytes += size;
+  stats->total_blocks++;
+
+  pthread_mutex_unlock(&xd_tag_mutex);
+
+  xd_block_set_tracked(header, true);
+}  // xd_tag_add()
+
+/**
+ * @brief Removes the record of a tagged block being freed, if any, and
+ * uncounts it from the live statistics of its tag.
+ *
+ * @param header Pointer to the header of the block.
+ *
+ * @note Must be called while holding the mutex of the heap owning the block.
+ */
+static void xd_tag_remove(xd_mem_block_header *header) {
+  pthread_mutex_lock(&xd_tag_mutex);
+
+  const size_t mask = xd_tag_record_capacity - 1;
+  size_t index = xd_hash_address((uintptr_t)header) & mask;
+  while (xd_tag_record_capacity != 0 && xd_tag_records[index].header != NULL) {
+    if (xd_tag_records[index].header == header) {
+      xd_tag_stats *stats = &xd_tag_stats_table[xd_tag_records[index].tag];
+      stats->live_bytes -= xd_block_get_size(header);
+      stats->live_blocks--;
+      xd_tag_table_delete(index);
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+
+  pthread_mutex_unlock(&xd_tag_mutex);
+}  // xd_tag_remove()
+
+/**
+ * @brief Removes the records of the tagged blocks of a heap being destroyed,
+ * uncounting them from the live statistics of their tags.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @note Must be called while holding the heap's mutex, or when no other thread
+ * uses the heap.
+ */
+static void xd_tag_heap_forget(xd_heap *heap) {
+  pthread_mutex_lock(&xd_tag_mutex);
+
+  // a slot is checked again after a record is shifted back into it
+  size_t i = 0;
+  while (i < xd_tag_record_capacity) {
+    xd_tag_record *record = &xd_tag_records[i];
+    if (record->header == NULL || record->heap != heap) {
+      i++;
+      continue;
+    }
+    xd_tag_stats *stats = &xd_tag_stats_table[record->tag];
+    stats->live_bytes -= xd_block_get_size(record->header);
+    stats->live_blocks--;
+    xd_tag_table_delete(i);
+  }
+
+  pthread_mutex_unlock(&xd_tag_mutex);
+}  // xd_tag_heap_forget()
+
+/**
+ * @brief Finds the tag of a block.
+ *
+ * @param header Pointer to the header of the block.
+ *
+ * @return The tag of the block, or `0` if it is not tagged.
+ *
+ * @note Must be called while holding `xd_tag_mutex`.
+ */
+static unsigned int xd_tag_find(const xd_mem_block_header *header) {
+  const size_t mask = xd_tag_record_capacity - 1;
+  size_t index = xd_hash_address((uintptr_t)header) & mask;
+  while (xd_tag_record_capacity != 0 && xd_tag_records[index].header != NULL) {
+    if (xd_tag_records[index].header == header) {
+      return xd_tag_records[index].tag;
+    }
+    index = (index + 1) & mask;
+  }
+  return 0;
+}  // xd_tag_find()
+
+/**
+ * @brief Removes the side table records of a tracked block being freed (its
+ * lifetime sample and tag), and clears its tracked flag.
+ *
+ * @param header Pointer to the header of the block.
+ *
+ * @note Must be called while holding the mutex of the heap owning the block.
+ */
+static void xd_block_untrack(xd_mem_block_header *header) {
+  xd_predict_sample_remove(header);
+  xd_tag_remove(header);
+  xd_block_set_tracked(header, false);
+}  // xd_block_untrack()
+
+/**
+ * @brief Captures the allocation stack of a sampled block, starting at the
+ * frame of the call site (the allocator's frames are skipped).
+ *
+ * @param address The return address of the call site.
+ * @param stack Where the stack is stored (`XD_LEAK_STACK_DEPTH` frames), it is
+ * left unchanged if the call site is not found in the captured frames.
+ */
+static void xd_leak_stack_capture(uintptr_t address, uintptr_t *stack) {
+  void *frames[XD_LEAK_STACK_DEPTH + XD_LEAK_STACK_SKIP];
+  int count = backtrace(frames, XD_LEAK_STACK_DEPTH + XD_LEAK_STACK_SKIP);
+  for (int i = 0; i < count; i++) {
+    if ((uintptr_t)frames[i] != address) {
+      continue;
+    }
+    for (int j = 0; j < XD_LEAK_STACK_DEPTH; j++) {
+      stack[j] = (i + j < count) ? (uintptr_t)frames[i + j] : 0;
+    }
+    return;
+  }
+}  // xd_leak_stack_capture()
+
+/**
+ * @brief Keeps a long-lived sampled block for leak reports. Once the table is
+ * full, the sample of a pseudo-random slot is replaced, its block stays
+ * tracked and freeing it finds no sample.
+ *
+ * @param header Pointer to the header of the sampled block.
+ * @param stack The allocation stack of the block (`XD_LEAK_STACK_DEPTH`
+ * frames).
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_leak_sample_add(xd_mem_block_header *header,
+                               const uintptr_t *stack) {
+  const size_t mask = XD_LEAK_SAMPLE_COUNT - 1;
+  if (xd_leak_sample_count >= (XD_LEAK_SAMPLE_COUNT / 4) * 3) {
+    size_t victim = xd_hash_address((uintptr_t)header ^ xd_now_ns()) & mask;
+    while (xd_leak_samples[victim].header == NULL) {
+      victim = (victim + 1) & mask;
+    }
+    xd_leak_sample_delete(victim);
+  }
+
+  size_t index = xd_hash_address((uintptr_t)header) & mask;
+  while (xd_leak_samples[index].header != NULL) {
+    index = (index + 1) & mask;
+  }
+  xd_leak_samples[index].header = header;
+  memcpy(xd_leak_samples[index].stack, stack,
+         sizeof(xd_leak_samples[index].stack));
+  xd_leak_sample_count++;
+}  // xd_leak_sample_add()
+
+/**
+ * @brief Removes the leak report sample of a block being freed, if any.
+ *
+ * @param header Pointer to the header of the block.
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_leak_sample_remove(xd_mem_block_header *header) {
+  const size_t mask = XD_LEAK_SAMPLE_COUNT - 1;
+  size_t index = xd_hash_address((uintptr_t)header) & mask;
+  while (xd_leak_samples[index].header != header) {
+    if (xd_leak_samples[index].header == NULL) {
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+  xd_leak_sample_delete(index);
+}  // xd_leak_sample_remove()
+
+/**
+ * @brief Empties a slot of `xd_leak_samples`, shifting back the following
+ * samples of its probe sequence.
+ *
+ * @param index The index of the slot.
+ *
+ * @note Must be called while holding `xd_predict_mutex`.
+ */
+static void xd_leak_sample_delete(size_t index) {
+  const size_t mask = XD_LEAK_SAMPLE_COUNT - 1;
+  size_t next = index;
+  while (true) {
+    next = (next + 1) & mask;
+    if (xd_leak_samples[next].header == NULL) {
+      break;
+    }
+    size_t home =
+        xd_hash_address((uintptr_t)xd_leak_samples[next].header) & mask;
+    bool in_place = (index <= next) ? (index < home && home <= next)
+                                    : (index < home || home <= next);
+    if (!in_place) {
+      xd_leak_samples[index] = xd_leak_samples[next];
+      index = next;
+    }
+  }
+  xd_leak_samples[index].header = NULL;
+  xd_leak_sample_count--;
+}  // xd_leak_sample_delete()
+
+/**
+ * @brief Locks the mutexes of all the heaps (except the stage heap), in the
+ * order of the fork handlers, so they can be walked.
+ */
+static void xd_heaps_lock() {
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_lock(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_lock(&xd_cold_heap.mutex);
+  pthread_mutex_lock(&xd_shareable_heap.mutex);
+  pthread_mutex_lock(&xd_reserve_heap.mutex);
+  pthread_mutex_lock(&xd_created_heaps_mutex);
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_lock(&heap->mutex);
+  }
+}  // xd_heaps_lock()
+
+/**
+ * @brief Unlocks the mutexes locked by `xd_heaps_lock()`.
+ */
+static void xd_heaps_unlock() {
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_unlock(&heap->mutex);
+  }
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+  pthread_mutex_unlock(&xd_shareable_heap.mutex);
+  pthread_mutex_unlock(&xd_cold_heap.mutex);
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    pthread_mutex_unlock(&xd_hint_heaps[i].mutex);
+  }
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+}  // xd_heaps_unlock()
+
+/**
+ * @brief Visits the blocks of a mapped chunk.
+ *
+ * @param left_fencepost Pointer to the left fencepost of the chunk.
+ * @param visit The function called for each block.
+ * @param arg The argument passed to `visit`.
+ *
+ * @return The end of the chunk (after its right fencepost), which is past the
+ * end of its mapping if it was coalesced with the chunks mapped after it.
+ *
+ * @note Must be called while holding the mutex of the heap owning the chunk.
+ */
+static xd_byte *xd_heap_chunk_walk(xd_mem_block_header *left_fencepost,
+                                   xd_block_visitor visit, void *arg) {
+  xd_mem_block_header *header = xd_block_get_next(left_fencepost);
+  while (xd_block_get_state(header) != XD_MEM_BLOCK_FENCEPOST) {
+    visit(header, arg);
+    header = xd_block_get_next(header);
+  }
+  return (xd_byte *)header + XD_BLOCK_HEADER_SIZE;
+}  // xd_heap_chunk_walk()
+
+/**
+ * @brief Visits the blocks of all the heaps in address order within each heap,
+ * the main heap first. Fenceposts, the blocks of marks and the allocator's own
+ * blocks (see `xd_internal_heap`) are not visited.
+ *
+ * @param visit The function called for each block.
+ * @param arg The argument passed to `visit`.
+ *
+ * @note Must be called while holding the mutexes locked by `xd_heaps_lock()`.
+ */
+static void xd_heaps_walk(xd_block_visitor visit, void *arg) {
+  if (sbrk(0) == xd_heap_end_address) {
+#ifdef XD_USE_DEFERRED_FREES
+    xd_pending_free_drain();
+#endif
+    xd_mem_block_header *header = (xd_mem_block_header *)xd_heap_start_address;
+    while ((void *)header < xd_heap_end_address) {
+      if (xd_block_get_state(header) != XD_MEM_BLOCK_FENCEPOST) {
+        visit(header, arg);
+      }
+      header = xd_block_get_next(header);
+    }
+  }
+
+  // a mapping reached by the walk of a previous chunk was coalesced with it
+  pthread_rwlock_rdlock(&xd_chunk_registry_lock);
+  const xd_chunk_range *ranges = (const xd_chunk_range *)xd_chunk_registry.base;
+  xd_byte *walked_end = NULL;
+  for (size_t i = 0; i < xd_chunk_registry_count; i++) {
+    if (ranges[i].heap == &xd_stage_heap ||
+        ranges[i].heap == &xd_internal_heap ||
+        (xd_byte *)ranges[i].start < walked_end) {
+      continue;
+    }
+    walked_end = xd_heap_chunk_walk((xd_mem_block_header *)ranges[i].start,
+                                    visit, arg);
+  }
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+}  // xd_heaps_walk()
+
+/**
+ * @brief Adds an allocated block to the totals of a leak report, used as an
+ * `xd_block_visitor`.
+ *
+ * @param header Pointer to the header of the block.
+ * @param arg Pointer to the `xd_leak_totals`.
+ */
+static void xd_leak_block_count(xd_mem_block_header *header, void *arg) {
+  if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
+    return;
+  }
+  xd_leak_totals *totals = (xd_leak_totals *)arg;
+  totals->bytes += xd_block_get_size(header);
+  totals->blocks++;
+}  // xd_leak_block_count()
+
+/**
+ * @brief Copies the record of a block to a heap snapshot, used as an
+ * `xd_block_visitor`.
+ *
+ * @param header Pointer to the header of the block.
+ * @param arg Pointer to the `xd_snapshot_writer`.
+ *
+ * @note Must be called while holding `xd_tag_mutex`.
+ */
+static void xd_snapshot_block_write(xd_mem_block_header *header, void *arg) {
+  xd_snapshot_writer *writer = (xd_snapshot_writer *)arg;
+  writer->blocks++;
+  if (writer->records == NULL) {
+    return;
+  }
+
+  xd_snapshot_block block = {(uint64_t)(uintptr_t)header->data,
+                             xd_block_get_size(header), 0, 0};
+  switch (xd_block_get_state(header)) {
+    case XD_MEM_BLOCK_ALLOCATED:
+      block.state = XD_SNAPSHOT_BLOCK_ALLOCATED;
+      break;
+    case XD_MEM_BLOCK_RELOCATABLE:
+      block.state = XD_SNAPSHOT_BLOCK_RELOCATABLE;
+      break;
+    default:
+      block.state = XD_SNAPSHOT_BLOCK_FREE;
+      break;
+  }
+  if (xd_block_is_tracked(header)) {
+    block.tag = xd_tag_find(header);
+  }
+  writer->records[writer->blocks - 1] = block;
+}  // xd_snapshot_block_write()
+
+/**
+ * @brief Adds a sampled block to the group of its allocation stack, creating
+ * the group if needed.
+ *
+ * @param groups The groups.
+ * @param count The number of groups.
+ * @param stack The allocation stack of the block (`XD_LEAK_STACK_DEPTH`
+ * frames).
+ * @param size The size of the block (in bytes).
+ *
+ * @return The new number of groups.
+ */
+static size_t xd_leak_group_add(xd_leak_group *groups, size_t count,
+                                const uintptr_t *stack, size_t size) {
+  const size_t stack_size = XD_LEAK_STACK_DEPTH * sizeof(uintptr_t);
+  size_t group = 0;
+  while (group < count && memcmp(groups[group].stack, stack, stack_size) != 0) {
+    group++;
+  }
+  if (group == count) {
+    memcpy(groups[group].stack, stack, stack_size);
+    groups[group].bytes = 0;
+    groups[group].blocks = 0;
+    count++;
+  }
+  groups[group].bytes += size;
+  groups[group].blocks++;
+  return count;
+}  // xd_leak_group_add()
+
+/**
+ * @brief Groups the live sampled blocks of lifetime prediction and the
+ * long-lived ones kept for leak reports by allocation stack.
+ *
+ * @param groups Where the groups are stored (`XD_PREDICT_SAMPLE_COUNT +
+ * XD_LEAK_SAMPLE_COUNT` slots).
+ *
+ * @return The number of groups.
+ *
+ * @note Must be called while holding the mutexes of the heaps, so the sampled
+ * blocks are not freed.
+ */
+static size_t xd_leak_groups_collect(xd_leak_group *groups) {
+  pthread_mutex_lock(&xd_predict_mutex);
+
+  size_t count = 0;
+  for (size_t i = 0; i < XD_PREDICT_SAMPLE_COUNT; i++) {
+    const xd_predict_sample *sample = &xd_predict_samples[i];
+    if (sample->header != NULL) {
+      count = xd_leak_group_add(groups, count, sample->stack,
+                                xd_block_get_size(sample->header));
+    }
+  }
+  for (size_t i = 0; i < XD_LEAK_SAMPLE_COUNT; i++) {
+    const xd_leak_sample *sample = &xd_leak_samples[i];
+    if (sample->header != NULL) {
+      count = xd_leak_group_add(groups, count, sample->stack,
+                                xd_block_get_size(sample->header));
+    }
+  }
+
+  pthread_mutex_unlock(&xd_predict_mutex);
+  return count;
+}  // xd_leak_groups_collect()
+
+/**
+ * @brief Orders leak report groups by decreasing size, for `qsort()`.
+ *
+ * @param a Pointer to the first `xd_leak_group`.
+ * @param b Pointer to the second `xd_leak_group`.
+ *
+ * @return A negative value if `a` is larger, positive if `b` is larger, `0`
+ * otherwise.
+ */
+static int xd_leak_group_compare(const void *a, const void *b) {
+  size_t a_bytes = ((const xd_leak_group *)a)->bytes;
+  size_t b_bytes = ((const xd_leak_group *)b)->bytes;
+  return (a_bytes < b_bytes) - (a_bytes > b_bytes);
+}  // xd_leak_group_compare()
+
+/**
+ * @brief Grows the mapping of a side table to at least the passed size, the
+ * added memory is zeroed.
+ *
+ * @param table Pointer to the side table.
+ * @param size The required size of the table (in bytes).
+ *
+ * @return `0` on success, or `-1` on failure.
+ */
+static int xd_side_table_reserve(xd_side_table *table, size_t size) {
+  if (size <= table->size) {
+    return 0;
+  }
+
+  // grow at least geometrically to keep remapping rare
+  if (size < 2 * table->size) {
+    size = 2 * table->size;
+  }
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size = (size + page_size - 1) & ~(page_size - 1);
+
+  void *base;
+  if (table->base == NULL) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  else {
+    base = mremap(table->base, table->size, size, MREMAP_MAYMOVE);
+  }
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+
+  table->base = base;
+  table->size = size;
+  return 0;
+}  // xd_side_table_reserve()
+
+/**
+ * @brief Adds the address range of a chunk mapped for a heap to the chunk
+ * registry.
+ *
+ * @param start The start of the chunk (inclusive).
+ * @param end The end of the chunk (exclusive).
+ * @param heap Pointer to the heap owning the chunk.
+ * @param fd The memfd backing the chunk, closed when the chunk is unmapped
+ * (`-1` if anonymous).
+ *
+ * @return `0` on success, or `-1` on failure.
+ */
+static int xd_chunk_registry_add(void *start, void *end, xd_heap *heap,
+                                 int fd) {
+  pthread_rwlock_wrlock(&xd_chunk_registry_lock);
+
+  size_t count = xd_chunk_registry_count;
+  if (xd_side_table_reserve(&xd_chunk_registry,
+                            (count + 1) * sizeof(xd_chunk_range)) != 0) {
+    pthread_rwlock_unlock(&xd_chunk_registry_lock);
+    return -1;
+  }
+
+  // keep the ranges sorted by address
+  xd_chunk_range *ranges = (xd_chunk_range *)xd_chunk_registry.base;
+  size_t index = count;
+  while (index > 0 && (uintptr_t)ranges[index - 1].start > (uintptr_t)start) {
+    ranges[index] = ranges[index - 1];
+    index--;
+  }
+  ranges[index] = (xd_chunk_range){start, end, heap, fd};
+  __atomic_store_n(&xd_chunk_registry_count, count + 1, __ATOMIC_RELEASE);
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+  return 0;
+}  // xd_chunk_registry_add()
+
+/**
+ * @brief Removes the address range of an unmapped chunk from the chunk
+ * registry.
+ *
+ * @param start The start of the chunk, as passed to `xd_chunk_registry_add()`.
+ */
+static void xd_chunk_registry_remove(void *start) {
+  pthread_rwlock_wrlock(&xd_chunk_registry_lock);
+
+  xd_chunk_range *ranges = (xd_chunk_range *)xd_chunk_registry.base;
+  size_t count = xd_chunk_registry_count;
+  size_t index = 0;
+  while (index < count && ranges[index].start != start) {
+    index++;
+  }
+  if (index < count) {
+    memmove(&ranges[index], &ranges[index + 1],
+            (count - index - 1) * sizeof(xd_chunk_range));
+    __atomic_store_n(&xd_chunk_registry_count, count - 1, __ATOMIC_RELEASE);
+  }
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+}  // xd_chunk_registry_remove()
+
+/**
+ * @brief Unmaps all the chunks of a heap and removes them from the chunk
+ * registry.
+ *
+ * @param heap Pointer to the heap.
+ */
+static void xd_chunk_registry_unmap(xd_heap *heap) {
+  pthread_rwlock_wrlock(&xd_chunk_registry_lock);
+
+  // compact the remaining ranges in place, keeping them sorted
+  xd_chunk_range *ranges = (xd_chunk_range *)xd_chunk_registry.base;
+  size_t count = 0;
+  for (size_t i = 0; i < xd_chunk_registry_count; i++) {
+    if (ranges[i].heap == heap) {
+      munmap(ranges[i].start,
+             (size_t)((xd_byte *)ranges[i].end - (xd_byte *)ranges[i].start));
+      if (ranges[i].fd != -1) {
+        close(ranges[i].fd);
+      }
+      continue;
+    }
+    ranges[count++] = ranges[i];
+  }
+  __atomic_store_n(&xd_chunk_registry_count, count, __ATOMIC_RELEASE);
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+}  // xd_chunk_registry_unmap()
+
+/**
+ * @brief Removes all the chunks of a heap from the chunk registry without
+ * unmapping them, used in a child process that didn't inherit them.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @note The memfds of the chunks are left open, they belong to the child.
+ */
+static void xd_chunk_registry_forget(xd_heap *heap) {
+  pthread_rwlock_wrlock(&xd_chunk_registry_lock);
+
+  xd_chunk_range *ranges = (xd_chunk_range *)xd_chunk_registry.base;
+  size_t count = 0;
+  for (size_t i = 0; i < xd_chunk_registry_count; i++) {
+    if (ranges[i].heap != heap) {
+      ranges[count++] = ranges[i];
+    }
+  }
+  __atomic_store_n(&xd_chunk_registry_count, count, __ATOMIC_RELEASE);
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+}  // xd_chunk_registry_forget()
+
+/**
+ * @brief Finds the chunk that contains the passed address.
+ *
+ * @param ptr The address to look up.
+ * @param range Pointer to where the range of the chunk is stored if found.
+ *
+ * @return `true` if the address is in a mapped chunk, `false` otherwise (such
+ * as for the addresses of the main heap).
+ */
+static bool xd_chunk_registry_find(const void *ptr, xd_chunk_range *range) {
+  if (__atomic_load_n(&xd_chunk_registry_count, __ATOMIC_ACQUIRE) == 0) {
+    return false;
+  }
+
+  pthread_rwlock_rdlock(&xd_chunk_registry_lock);
+
+  // binary search for the last range starting at or before the address
+  const xd_chunk_range *ranges = (const xd_chunk_range *)xd_chunk_registry.base;
+  size_t low = 0;
+  size_t high = xd_chunk_registry_count;
+  while (low < high) {
+    size_t middle = low + ((high - low) / 2);
+    if ((uintptr_t)ranges[middle].start <= (uintptr_t)ptr) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+
+  bool found = (low > 0 && (uintptr_t)ptr < (uintptr_t)ranges[low - 1].end);
+  if (found) {
+    *range = ranges[low - 1];
+  }
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+  return found;
+}  // xd_chunk_registry_find()
+
+/**
+ * @brief Finds the heap owning the chunk that contains the passed address.
+ *
+ * @param ptr The address to look up.
+ *
+ * @return A pointer to the heap, or `NULL` if the address is not in a mapped
+ * chunk (such as the addresses of the main heap).
+ */
+static xd_heap *xd_chunk_registry_lookup(const void *ptr) {
+  xd_chunk_range range;
+  if (!xd_chunk_registry_find(ptr, &range)) {
+    return NULL;
+  }
+  return range.heap;
+}  // xd_chunk_registry_lookup()
+
+/**
+ * @brief Gives the kernel the passed advice about all the chunks of a heap.
+ *
+ * @param heap Pointer to the heap.
+ * @param advice The `madvise()` advice.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set.
+ */
+static int xd_chunk_registry_advise(xd_heap *heap, int advice) {
+  int ret = 0;
+  pthread_rwlock_rdlock(&xd_chunk_registry_lock);
+
+  const xd_chunk_range *ranges = (const xd_chunk_range *)xd_chunk_registry.base;
+  for (size_t i = 0; i < xd_chunk_registry_count; i++) {
+    if (ranges[i].heap != heap) {
+      continue;
+    }
+    size_t length = (size_t)((xd_byte *)ranges[i].end -
+                             (xd_byte *)ranges[i].start);
+    if (madvise(ranges[i].start, length, advice) != 0) {
+      ret = -1;
+      break;
+    }
+  }
+
+  pthread_rwlock_unlock(&xd_chunk_registry_lock);
+  return ret;
+}  // xd_chunk_registry_advise()
+
+/**
+ * @brief Returns the handle table slot of the passed handle.
+ *
+ * @param handle The handle.
+ *
+ * @return A pointer to the slot, or `NULL` if the handle is not allocated.
+ *
+ * @note Must be called while holding `xd_main_heap.mutex`.
+ */
+static xd_handle_entry *xd_handle_entry_get(xd_handle handle) {
+  if (handle == 0 || handle > xd_handle_count) {
+    return NULL;
+  }
+  xd_handle_entry *entry =
+      &((xd_handle_entry *)xd_handle_table.base)[handle - 1];
+  return (entry->header != NULL) ? entry : NULL;
+}  // xd_handle_entry_get()
+
+/**
+ * @brief Creates `xd_stage_key`, called once.
+ */
+static void xd_stage_key_create() {
+  if (pthread_key_create(&xd_stage_key, xd_stage_thread_exit) != 0) {
+    perror("fatal - stage key creation failed");
+    exit(EXIT_FAILURE);
+  }
+}  // xd_stage_key_create()
+
+/**
+ * @brief Unmaps the stage region of an exiting thread.
+ *
+ * @param arg Pointer to the most recently mapped `xd_stage_segment`.
+ */
+static void xd_stage_thread_exit(void *arg) {
+  xd_stage_segment *segment = (xd_stage_segment *)arg;
+  while (segment != NULL) {
+    xd_stage_segment *prev = segment->prev;
+    xd_stage_segment_unmap(segment);
+    segment = prev;
+  }
+}  // xd_stage_thread_exit()
+
+/**
+ * @brief Unmaps a stage segment and removes it from the chunk registry.
+ *
+ * @param segment Pointer to the segment.
+ */
+static void xd_stage_segment_unmap(xd_stage_segment *segment) {
+  xd_chunk_registry_remove(segment);
+  munmap(segment, segment->size);
+}  // xd_stage_segment_unmap()
+
+/**
+ * @brief Allocates a block of the passed size at the top of the calling
+ * thread's stage region, mapping a new segment if the recent one is full.
+ *
+ * @param size The size of the memory block to be allocated (in bytes).
+ *
+ * @return A pointer to the allocated memory on success, or `NULL` on failure
+ * with `errno` set to `ENOMEM`.
+ */
+static void *xd_stage_alloc(size_t size) {
+  if (size > SIZE_MAX - (2 * XD_STAGE_SEGMENT_SIZE)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  size = xd_block_adjust_size(size);
+  size_t block_size = XD_BLOCK_HEADER_SIZE + size;
+
+  xd_stage_segment *segment = xd_stage_segment_top;
+  if (segment == NULL || xd_stage_top - segment->base + block_size >
+                             segment->size - XD_STAGE_SEGMENT_HEADER_SIZE) {
+    size_t map_size = XD_STAGE_SEGMENT_HEADER_SIZE + block_size;
+    if (map_size < XD_STAGE_SEGMENT_SIZE) {
+      map_size = XD_STAGE_SEGMENT_SIZE;
+    }
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    map_size = (map_size + page_size - 1) & ~(page_size - 1);
+
+    pthread_once(&xd_stage_key_once, xd_stage_key_create);
+    void *mapping = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    if (xd_chunk_registry_add(mapping, (xd_byte *)mapping + map_size,
+                              &xd_stage_heap, -1) != 0) {
+      munmap(mapping, map_size);
+      errno = ENOMEM;
+      return NULL;
+    }
+
+    // the unused end of the previous segment is skipped
+    segment = (xd_stage_segment *)mapping;
+    *segment = (xd_stage_segment){xd_stage_segment_top, map_size, xd_stage_top};
+    xd_stage_segment_top = segment;
+    pthread_setspecific(xd_stage_key, segment);
+  }
+
+  xd_mem_block_header *header =
+      (xd_mem_block_header *)((xd_byte *)segment +
+                              XD_STAGE_SEGMENT_HEADER_SIZE +
+                              (xd_stage_top - segment->base));
+  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_ALLOCATED);
+  header->prev_size = 0;
+  xd_stage_top += block_size;
+  return (void *)header->data;
+}  // xd_stage_alloc()
+
+/**
+ * @brief Returns the file header of a persistent heap.
+ *
+ * @param pheap Pointer to the persistent heap.
+ *
+ * @return A pointer to the file header, at the start of the mapping.
+ */
+static inline xd_pheap_file_header *xd_pheap_file(const xd_pheap *pheap) {
+  return (xd_pheap_file_header *)pheap->base;
+}  // xd_pheap_file()
+
+/**
+ * @brief Returns the free list links of a free block of a persistent heap.
+ *
+ * @param header Pointer to the header of the free block.
+ *
+ * @return A pointer to the offsets of the next (`[0]`) and previous (`[1]`)
+ * blocks in the free list, `0` if none.
+ */
+static inline size_t *xd_pheap_block_links(xd_mem_block_header *header) {
+  return (size_t *)header->data;
+}  // xd_pheap_block_links()
+
+/**
+ * @brief Returns the block header at an offset of a persistent heap.
+ *
+ * @param pheap Pointer to the persistent heap.
+ * @param offset The offset of the header (`0` for none).
+ *
+ * @return A pointer to the header, or `NULL` if the offset is `0`.
+ */
+static inline xd_mem_block_header *xd_pheap_block_at(const xd_pheap *pheap,
+                                                     size_t offset) {
+  if (offset == 0) {
+    return NULL;
+  }
+  return (xd_mem_block_header *)(pheap->base + offset);
+}  // xd_pheap_block_at()
+
+/**
+ * @brief Returns the offset of a block header of a persistent heap.
+ *
+ * @param pheap Pointer to the persistent heap.
+ * @param header Pointer to the header.
+ *
+ * @return The offset of the header from the start of the mapping.
+ */
+static inline size_t xd_pheap_block_offset(const xd_pheap *pheap,
+                                           const xd_mem_block_header *header) {
+  return (size_t)((const xd_byte *)header - pheap->base);
+}  // xd_pheap_block_offset()
+
+/**
+ * @brief Inserts a free block at the head of the free list of a persistent
+ * heap.
+ *
+ * @param pheap Pointer to the persistent heap.
+ * @param header Pointer to the header of the free block.
+ */
+static void xd_pheap_free_list_insert(xd_pheap *pheap,
+                                      xd_mem_block_header *header) {
+  xd_pheap_file_header *file = xd_pheap_file(pheap);
+  size_t offset = xd_pheap_block_offset(pheap, header);
+  size_t *links = xd_pheap_block_links(header);
+  links[0] = (size_t)file->free_list;
+  links[1] = 0;
+  xd_mem_block_header *head = xd_pheap_block_at(pheap, links[0]);
+  if (head != NULL) {
+    xd_pheap_block_links(head)[1] = offset;
+  }
+  file->free_list = offset;
+}  // xd_pheap_free_list_insert()
+
+/**
+ * @brief Removes a free block from the free list of a persistent heap.
+ *
+ * @param pheap Pointer to the persistent heap.
+ * @param header Pointer to the header of the free block.
+ */
+static void xd_pheap_free_list_remove(xd_pheap *pheap,
+                                      xd_mem_block_header *header) {
+  size_t *links = xd_pheap_block_links(header);
+  xd_mem_block_header *next = xd_pheap_block_at(pheap, links[0]);
+  xd_mem_block_header *prev = xd_pheap_block_at(pheap, links[1]);
+  if (next != NULL) {
+    xd_pheap_block_links(next)[1] = links[1];
+  }
+  if (prev != NULL) {
+    xd_pheap_block_links(prev)[0] = links[0];
+  }
+  else {
+    xd_pheap_file(pheap)->free_list = links[0];
+  }
+}  // xd_pheap_free_list_remove()
+
+/**
+ * @brief Sizes a new persistent or shared heap file to hold the passed heap
+ * size.
+ *
+ * @param fd The descriptor of the file.
+ * @param size The requested heap size (in bytes).
+ *
+ * @return The size of the file (in bytes), or `0` on failure with `errno` set.
+ */
+static size_t xd_pheap_file_size(int fd, size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  if (size > SIZE_MAX - (2 * page_size) - XD_PHEAP_FILE_HEADER_SIZE) {
+    errno = ENOMEM;
+    return 0;
+  }
+  size += XD_PHEAP_FILE_HEADER_SIZE + (3 * XD_BLOCK_HEADER_SIZE);
+  size = (size + page_size - 1) & ~(page_size - 1);
+  if (ftruncate(fd, (off_t)size) != 0) {
+    return 0;
+  }
+  return size;
+}  // xd_pheap_file_size()
+
+/**
+ * @brief Maps a persistent or shared heap file and creates its handle,
+ * formatting the file if it was just created.
+ *
+ * @param fd The descriptor of the file, closed on failure.
+ * @param size The size of the file (in bytes).
+ * @param hint The address to map the file at if possible, or `NULL`.
+ * @param created Whether the file was just created.
+ * @param flags The flags of the handle (see `xd_pheap.flags`).
+ *
+ * @return A pointer to the handle, or `NULL` on failure with `errno` set.
+ */
+static xd_pheap *xd_pheap_map(int fd, size_t size, void *hint, bool created,
+                              int flags) {
+  void *base = mmap(hint, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+
+  xd_pheap *pheap = xd_heap_malloc(&xd_internal_heap, sizeof(xd_pheap));
+  if (pheap == NULL) {
+    munmap(base, size);
+    close(fd);
+    errno = ENOMEM;
+    return NULL;
+  }
+  memset(pheap, 0, sizeof(xd_pheap));
+  int error = pthread_mutex_init(&pheap->mutex, NULL);
+  if (error != 0) {
+    xd_free(pheap);
+    munmap(base, size);
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+  pheap->base = (xd_byte *)base;
+  pheap->size = size;
+  pheap->fd = fd;
+  pheap->flags = flags;
+  pheap->generation = xd_fork_generation;
+  if (!created) {
+    return pheap;
+  }
+
+  xd_pheap_file_header *file = xd_pheap_file(pheap);
+  file->size = size;
+  if (flags & XD_PHEAP_SHARED) {
+    pthread_mutexattr_t attr;
+    error = pthread_mutexattr_init(&attr);
+    if (error == 0) {
+      error = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+      if (error == 0) {
+        error = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+      }
+      if (error == 0) {
+        error = pthread_mutex_init(&file->mutex, &attr);
+      }
+      pthread_mutexattr_destroy(&attr);
+    }
+    if (error != 0) {
+      pthread_mutex_destroy(&pheap->mutex);
+      xd_free(pheap);
+      munmap(base, size);
+      close(fd);
+      errno = error;
+      return NULL;
+    }
+  }
+  xd_mem_block_header *header =
+      xd_heap_chunk_format(pheap->base + XD_PHEAP_FILE_HEADER_SIZE,
+                           size - XD_PHEAP_FILE_HEADER_SIZE);
+  xd_pheap_free_list_insert(pheap, header);
+
+  // the magic is written last, other processes wait for it before using the
+  // heap
+  __atomic_store_n(&file->magic, XD_PHEAP_MAGIC, __ATOMIC_RELEASE);
+  return pheap;
+}  // xd_pheap_map()
+
+/**
+ * @brief Rebuilds the free list of a shared heap from its blocks, after a
+ * process died while holding its lock.
+ *
+ * The blocks are walked using their sizes, which are kept walkable at every
+ * step of an allocation or a free. Their `prev_size` fields are rewritten,
+ * adjacent unallocated blocks are coalesced and all unallocated blocks are
+ * linked into a new free list.
+ *
+ * @param pheap Pointer to the heap.
+ *
+ * @return `true` on success, or `false` if the blocks are inconsistent.
+ *
+ * @note Must be called while holding the lock of the heap.
+ */
+static bool xd_pheap_free_list_rebuild(xd_pheap *pheap) {
+  xd_byte *left_fencepost = pheap->base + XD_PHEAP_FILE_HEADER_SIZE;
+  xd_byte *right_fencepost = pheap->base + pheap->size - XD_BLOCK_HEADER_SIZE;
+  xd_mem_block_header *header = (xd_mem_block_header *)left_fencepost;
+  if (xd_block_get_state(header) != XD_MEM_BLOCK_FENCEPOST) {
+    return false;
+  }
+
+  // validate the walk before changing anything
+  header = xd_block_get_next(header);
+  while ((xd_byte *)header < right_fencepost) {
+    size_t state = xd_block_get_state(header);
+    size_t size = xd_block_get_size(header);
+    if ((state != XD_MEM_BLOCK_UNALLOCATED &&
+         state != XD_MEM_BLOCK_ALLOCATED) ||
+        size > (size_t)(right_fencepost - (xd_byte *)header) -
+                   XD_BLOCK_HEADER_SIZE) {
+      return false;
+    }
+    header = xd_block_get_next(header);
+  }
+  if ((xd_byte *)header != right_fencepost ||
+      xd_block_get_state(header) != XD_MEM_BLOCK_FENCEPOST) {
+    return false;
+  }
+
+  xd_pheap_file(pheap)->free_list = 0;
+  size_t prev_size = 0;
+  header = xd_block_get_next((xd_mem_block_header *)left_fencepost);
+  while ((xd_byte *)header < right_fencepost) {
+    header->prev_size = prev_size;
+    size_t size = xd_block_get_size(header);
+    if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
+      xd_mem_block_header *next = xd_block_get_next(header);
+      while ((xd_byte *)next < right_fencepost &&
+             xd_block_get_state(next) == XD_MEM_BLOCK_UNALLOCATED) {
+        size += xd_block_get_size(next) + XD_BLOCK_HEADER_SIZE;
+        next = xd_block_get_next(next);
+      }
+      xd_block_set_size(header, size);
+      xd_pheap_free_list_insert(pheap, header);
+    }
+    prev_size = size;
+    header = xd_block_get_next(header);
+  }
+  header->prev_size = prev_size;
+  return true;
+}  // xd_pheap_free_list_rebuild()
+
+/**
+ * @brief Locks the free list of a persistent or shared heap.
+ *
+ * @param pheap Pointer to the heap.
+ *
+ * @return `0` on success, or `ENOTRECOVERABLE` if a process died while
+ * holding the lock of a shared heap and its free list couldn't be rebuilt.
+ */
+static int xd_pheap_lock(xd_pheap *pheap) {
+  if (!(pheap->flags & XD_PHEAP_SHARED)) {
+    pthread_mutex_lock(&pheap->mutex);
+    return 0;
+  }
+
+  // a process died while holding the lock, the free list may be half updated
+  // so it is rebuilt before the mutex is marked consistent (a block it was
+  // moving may be lost), otherwise unlocking it without marking it consistent
+  // makes the heap unusable for all processes
+  pthread_mutex_t *mutex = &xd_pheap_file(pheap)->mutex;
+  int error = pthread_mutex_lock(mutex);
+  if (error == EOWNERDEAD) {
+    if (!xd_pheap_free_list_rebuild(pheap)) {
+      pthread_mutex_unlock(mutex);
+      return ENOTRECOVERABLE;
+    }
+    pthread_mutex_consistent(mutex);
+    error = 0;
+  }
+  return error;
+}  // xd_pheap_lock()
+
+/**
+ * @brief Unlocks the free list of a persistent or shared heap.
+ *
+ * @param pheap Pointer to the heap.
+ */
+static void xd_pheap_unlock(xd_pheap *pheap) {
+  if (!(pheap->flags & XD_PHEAP_SHARED)) {
+    pthread_mutex_unlock(&pheap->mutex);
+    return;
+  }
+  pthread_mutex_unlock(&xd_pheap_file(pheap)->mutex);
+}  // xd_pheap_unlock()
+
+/**
+ * @brief Empties the per-process cache of a shared heap if it was inherited
+ * from the parent process, whose blocks it holds.
+ *
+ * @param pheap Pointer to the heap.
+ *
+ * @note Must be called while holding `pheap->mutex`.
+ */
+static void xd_pheap_cache_reset(xd_pheap *pheap) {
+  if (pheap->generation == xd_fork_generation) {
+    return;
+  }
+  memset(pheap->cache, 0, sizeof(pheap->cache));
+  memset(pheap->cache_count, 0, sizeof(pheap->cache_count));
+  pheap->generation = xd_fork_generation;
+}  // xd_pheap_cache_reset()
+
+/**
+ * @brief Returns an allocated block to the free list of a persistent or shared
+ * heap, coalescing it with its unallocated neighbors.
+ *
+ * @param pheap Pointer to the heap.
+ * @param header Pointer to the header of the block.
+ */
+static void xd_pheap_block_release(xd_pheap *pheap,
+                                   xd_mem_block_header *header) {
+  // the heap is unusable, the block is lost
+  if (xd_pheap_lock(pheap) != 0) {
+    return;
+  }
+
+  // double free is fatal abort
+  if (xd_block_get_state(header) != XD_MEM_BLOCK_ALLOCATED) {
+    fprintf(stderr, "xd_pheap_free(): double free detected\n");
+    abort();
+  }
+
+  size_t size = xd_block_get_size(header);
+  xd_mem_block_header *prev = xd_block_get_prev(header);
+  if (xd_block_get_state(prev) == XD_MEM_BLOCK_UNALLOCATED) {
+    xd_pheap_free_list_remove(pheap, prev);
+    size += xd_block_get_size(prev) + XD_BLOCK_HEADER_SIZE;
+    header = prev;
+  }
+  xd_mem_block_header *next =
+      (xd_mem_block_header *)((xd_byte *)header + XD_BLOCK_HEADER_SIZE + size);
+  if (xd_block_get_state(next) == XD_MEM_BLOCK_UNALLOCATED) {
+    xd_pheap_free_list_remove(pheap, next);
+    size += xd_block_get_size(next) + XD_BLOCK_HEADER_SIZE;
+  }
+  xd_block_set_size_and_state(header, size, XD_MEM_BLOCK_UNALLOCATED);
+  xd_block_get_next(header)->prev_size = size;
+  xd_pheap_free_list_insert(pheap, header);
+
+  xd_pheap_unlock(pheap);
+}  // xd_pheap_block_release()
+
+/**
+ * @brief Creates `xd_epoch_key`, called once.
+ */
+static void xd_epoch_key_create() {
+  if (pthread_key_create(&xd_epoch_key, xd_epoch_thread_exit) != 0) {
+    perror("fatal - epoch key creation failed");
+    exit(EXIT_FAILURE);
+  }
+}  // xd_epoch_key_create()
+
+/**
+ * @brief Releases the epoch record of an exiting thread, its parked blocks are
+ * kept in the record and freed by the thread that reuses it.
+ *
+ * @param arg Pointer to the `xd_epoch_record` of the thread.
+ */
+static void xd_epoch_thread_exit(void *arg) {
+  xd_epoch_record *record = (xd_epoch_record *)arg;
+  record->nesting = 0;
+  __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&record->in_use, false, __ATOMIC_RELEASE);
+}  // xd_epoch_thread_exit()
+
+/**
+ * @brief Returns the epoch record of the calling thread, reusing the record of
+ * an exited thread or adding a new one on first use.
+ *
+ * @return A pointer to the record, or `NULL` on failure.
+ */
+static xd_epoch_record *xd_epoch_record_get() {
+  if (xd_epoch_thread_record != NULL) {
+    return xd_epoch_thread_record;
+  }
+  pthread_once(&xd_epoch_key_once, xd_epoch_key_create);
+
+  xd_epoch_record *record =
+      __atomic_load_n(&xd_epoch_records, __ATOMIC_ACQUIRE);
+  for (; record != NULL; record = record->next) {
+    bool in_use = false;
+    if (__atomic_compare_exchange_n(&record->in_use, &in_use, true, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  if (record == NULL) {
+    record = xd_heap_malloc(&xd_internal_heap, sizeof(xd_epoch_record));
+    if (record == NULL) {
+      return NULL;
+    }
+    *record = (xd_epoch_record){NULL, 0, true, 0, NULL, 0, 0};
+    record->next = __atomic_load_n(&xd_epoch_records, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&xd_epoch_records, &record->next,
+                                        record, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+  }
+
+  pthread_setspecific(xd_epoch_key, record);
+  xd_epoch_thread_record = record;
+  return record;
+}  // xd_epoch_record_get()
+
+/**
+ * @brief Advances the global epoch if every thread inside a critical section
+ * has observed it.
+ *
+ * @return `true` if the epoch was advanced (by this or another thread),
+ * `false` otherwise.
+ */
+static bool xd_epoch_try_advance() {
+  size_t epoch = __atomic_load_n(&xd_epoch_global, __ATOMIC_SEQ_CST);
+  xd_epoch_record *record =
+      __atomic_load_n(&xd_epoch_records, __ATOMIC_ACQUIRE);
+  for (; record != NULL; record = record->next) {
+    size_t state = __atomic_load_n(&record->state, __ATOMIC_SEQ_CST);
+    if ((state & 1) != 0 && (state >> 1) != epoch) {
+      return false;
+    }
+  }
+  __atomic_compare_exchange_n(&xd_epoch_global, &epoch, epoch + 1, false,
+                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return true;
+}  // xd_epoch_try_advance()
+
+/**
+ * @brief Frees the parked blocks of a record that no thread can still be
+ * reading, which are the blocks parked at least two epochs ago.
+ *
+ * @param record Pointer to the record, owned by the calling thread.
+ *
+ * @return The number of freed blocks.
+ */
+static size_t xd_epoch_record_reclaim(xd_epoch_record *record) {
+  size_t epoch = __atomic_load_n(&xd_epoch_global, __ATOMIC_ACQUIRE);
+  size_t kept = 0;
+  for (size_t i = 0; i < record->retired_count; i++) {
+    if (record->retired[i].epoch + 2 <= epoch) {
+      xd_free(record->retired[i].ptr);
+      continue;
+    }
+    record->retired[kept++] = record->retired[i];
+  }
+  size_t freed = record->retired_count - kept;
+  record->retired_count = kept;
+  return freed;
+}  // xd_epoch_record_reclaim()
+
+/**
+ * @brief Creates `xd_iopool_key`, called once.
+ */
+static void xd_iopool_key_create() {
+  if (pthread_key_create(&xd_iopool_key, xd_iopool_thread_exit) != 0) {
+    perror("fatal - I/O pool key creation failed");
+    exit(EXIT_FAILURE);
+  }
+}  // xd_iopool_key_create()
+
+/**
+ * @brief Returns the buffers cached by an exiting thread to their pools.
+ *
+ * @param arg Pointer to the thread's `xd_iopool_thread_caches` (unused).
+ */
+static void xd_iopool_thread_exit(void *arg) {
+  (void)arg;
+  for (size_t i = 0; i < XD_IOPOOL_THREAD_CACHES; i++) {
+    xd_iopool_cache_flush(&xd_iopool_thread_caches[i],
+                          xd_iopool_thread_caches[i].count);
+  }
+}  // xd_iopool_thread_exit()
+
+/**
+ * @brief Returns buffers of a thread's cache to their pool, or drops them if
+ * the pool was destroyed.
+ *
+ * @param cache Pointer to the cache.
+ * @param count The number of buffers to be returned, taken from the top of the
+ * cache.
+ */
+static void xd_iopool_cache_flush(xd_iopool_cache *cache, size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&xd_iopools_mutex);
+  xd_iopool *pool = xd_iopools;
+  while (pool != NULL && (pool != cache->pool || pool->id != cache->id)) {
+    pool = pool->next;
+  }
+  if (pool != NULL) {
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = cache->count - count; i < cache->count; i++) {
+      *(void **)cache->buffers[i] = pool->free_list;
+      pool->free_list = cache->buffers[i];
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  pthread_mutex_unlock(&xd_iopools_mutex);
+  cache->count -= count;
+}  // xd_iopool_cache_flush()
+
+/**
+ * @brief Maps a new chunk for an I/O buffer pool and adds its buffers to the
+ * pool's free list.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return `0` on success, or `-1` on failure with `errno` set.
+ *
+ * @note Must be called while holding `pool->mutex`.
+ */
+static int xd_iopool_grow(xd_iopool *pool) {
+  if (pool->region_count == pool->region_capacity) {
+    size_t capacity = (pool->region_capacity == 0)
+                          ? XD_IOPOOL_REGION_CAPACITY
+                          : 2 * pool->region_capacity;
+    xd_iopool_region *regions = xd_heap_malloc(
+        &xd_internal_heap, capacity * sizeof(xd_iopool_region));
+    if (regions == NULL) {
+      return -1;
+    }
+    if (pool->regions != NULL) {
+      memcpy(regions, pool->regions,
+             pool->region_count * sizeof(xd_iopool_region));
+      xd_free(pool->regions);
+    }
+    pool->regions = regions;
+    pool->region_capacity = capacity;
+  }
+
+  // prefer reserved huge pages, fall back to transparent ones
+  void *chunk = MAP_FAILED;
+  if (pool->flags & XD_IOPOOL_HUGEPAGE) {
+    chunk = mmap(NULL, pool->chunk_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+  if (chunk == MAP_FAILED) {
+    chunk = mmap(NULL, pool->chunk_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+      return -1;
+    }
+    if (pool->flags & XD_IOPOOL_HUGEPAGE) {
+      madvise(chunk, pool->chunk_size, MADV_HUGEPAGE);
+    }
+  }
+  if ((pool->flags & XD_IOPOOL_MLOCK) && mlock(chunk, pool->chunk_size) != 0) {
+    int error = errno;
+    munmap(chunk, pool->chunk_size);
+    errno = error;
+    return -1;
+  }
+  pool->regions[pool->region_count++] =
+      (xd_iopool_region){chunk, pool->chunk_size};
+
+  // link the buffers so the first one is handed out first
+  xd_byte *buffer = (xd_byte *)chunk + (pool->chunk_size -
+                                        (pool->chunk_size % pool->buffer_size));
+  while (buffer != (xd_byte *)chunk) {
+    buffer -= pool->buffer_size;
+    *(void **)buffer = pool->free_list;
+    pool->free_list = buffer;
+  }
+  return 0;
+}  // xd_iopool_grow()
+
+/**
+ * @brief Checks whether the system is under memory pressure using the pressure
+ * stall information of the kernel (`/proc/pressure/memory`).
+ *
+ * @return `true` if tasks were stalled on memory for more than
+ * `XD_COLD_PRESSURE_THRESHOLD` percent of the last 10 seconds, `false`
+ * otherwise (or if the information is unavailable).
+ *
+ * @note Uses `open()` and `read()` rather than `stdio`, which may allocate.
+ */
+static bool xd_memory_under_pressure() {
+  int fd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  char buffer[256];
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return false;
+  }
+  buffer[length] = '\0';
+
+  // the first line is "some avg10=<percent> avg60=... avg300=... total=..."
+  const char *avg10 = strstr(buffer, "some avg10=");
+  if (avg10 == NULL) {
+    return false;
+  }
+  return strtod(avg10 + strlen("some avg10="), NULL) >
+         XD_COLD_PRESSURE_THRESHOLD;
+}  // xd_memory_under_pressure()
+
+/**
+ * @brief Reads a value of the process's cgroup v2 (such as `memory.max`).
+ *
+ * @param name The name of the file in the cgroup directory.
+ * @param value Pointer to where the value is stored, `SIZE_MAX` for `max`.
+ *
+ * @return `true` on success, `false` if the value is unavailable.
+ *
+ * @note Uses `open()` and `read()` rather than `stdio`, which may allocate.
+ */
+static bool xd_cgroup_read(const char *name, size_t *value) {
+  if (xd_cgroup_dir[0] == '\0') {
+    return false;
+  }
+  char path[sizeof(xd_cgroup_dir) + 32];
+  size_t dir_length = strlen(xd_cgroup_dir);
+  size_t name_length = strlen(name);
+  if (name_length + 2 > sizeof(path) - dir_length) {
+    return false;
+  }
+  memcpy(path, xd_cgroup_dir, dir_length);
+  path[dir_length] = '/';
+  memcpy(path + dir_length + 1, name, name_length + 1);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  char buffer[32];
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return false;
+  }
+  buffer[length] = '\0';
+
+  if (strncmp(buffer, "max", 3) == 0) {
+    *value = SIZE_MAX;
+    return true;
+  }
+  char *end;
+  unsigned long long parsed = strtoull(buffer, &end, 10);
+  if (end == buffer) {
+    return false;
+  }
+  *value = (parsed > SIZE_MAX) ? SIZE_MAX : (size_t)parsed;
+  return true;
+}  // xd_cgroup_read()
+
+/**
+ * @brief Finds the cgroup v2 directory of the process and stores it in
+ * `xd_cgroup_dir`, left empty if the process is not in a cgroup v2.
+ */
+static void xd_cgroup_detect() {
+  xd_cgroup_dir[0] = '\0';
+  int fd = open("/proc/self/cgroup", O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  char buffer[512];
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return;
+  }
+  buffer[length] = '\0';
+
+  // the unified hierarchy is the line "0::<path>"
+  const char *line = strstr(buffer, "0::");
+  if (line == NULL || (line != buffer && line[-1] != '\n')) {
+    return;
+  }
+  line += strlen("0::");
+  size_t path_length = strcspn(line, "\n");
+  if (path_length == 1) {
+    path_length = 0;  // the root cgroup has no trailing directory
+  }
+  const char *mount = "/sys/fs/cgroup";
+  size_t mount_length = strlen(mount);
+  if (mount_length + path_length >= sizeof(xd_cgroup_dir)) {
+    return;
+  }
+  memcpy(xd_cgroup_dir, mount, mount_length);
+  memcpy(xd_cgroup_dir + mount_length, line, path_length);
+  xd_cgroup_dir[mount_length + path_length] = '\0';
+}  // xd_cgroup_detect()
+
+/**
+ * @brief Returns the memory usage the memory limit applies to, the cgroup's
+ * `memory.current` if available, or the resident set size of the process.
+ *
+ * @return The memory usage (in bytes), or `0` if unavailable.
+ */
+static size_t xd_memory_usage() {
+  size_t usage;
+  if (xd_cgroup_read("memory.current", &usage)) {
+    return usage;
+  }
+
+  int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return 0;
+  }
+  char buffer[128];
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return 0;
+  }
+  buffer[length] = '\0';
+
+  // "<size> <resident> ..." in pages
+  char *end;
+  strtoull(buffer, &end, 10);
+  size_t pages = (size_t)strtoull(end, NULL, 10);
+  return pages * (size_t)sysconf(_SC_PAGESIZE);
+}  // xd_memory_usage()
+
+/**
+ * @brief Checks the memory usage against the memory limit, emptying the
+ * pre-zeroed pool once the usage is tight and returning the free pages of all
+ * heaps to the OS once it is critical.
+ */
+static void xd_memory_limit_check() {
+  size_t limit = __atomic_load_n(&xd_memory_limit, __ATOMIC_RELAXED);
+  if (limit == 0) {
+    __atomic_store_n(&xd_memory_tight, false, __ATOMIC_RELAXED);
+    return;
+  }
+  size_t usage = xd_memory_usage();
+  if (usage == 0) {
+    return;
+  }
+
+  bool tight = usage >= (limit / 100) * XD_MEMORY_TIGHT_PERCENT;
+  __atomic_store_n(&xd_memory_tight, tight, __ATOMIC_RELAXED);
+  if (usage >= (limit / 100) * XD_MEMORY_CRITICAL_PERCENT) {
+    xd_malloc_purge();
+  }
+  else if (tight) {
+    xd_zero_pool_drain();
+  }
+}  // xd_memory_limit_check()
+
+/**
+ * @brief Returns the blocks of the pre-zeroed pool to the heap, the pool
+ * thread refills it unless memory is tight.
+ */
+static void xd_zero_pool_drain() {
+  for (size_t band = 0; band < XD_ZERO_POOL_BAND_COUNT; band++) {
+    while (true) {
+      pthread_mutex_lock(&xd_zero_pool_mutex);
+      void *ptr = NULL;
+      if (xd_zero_pool[band].count > 0) {
+        ptr = xd_zero_pool[band].blocks[--xd_zero_pool[band].count];
+      }
+      pthread_mutex_unlock(&xd_zero_pool_mutex);
+      if (ptr == NULL) {
+        break;
+      }
+      xd_free(ptr);
+    }
+  }
+}  // xd_zero_pool_drain()
+
+/**
+ * @brief Returns the whole pages of an unallocated block to the OS, they are
+ * zero-filled when touched again.
+ *
+ * The first `XD_MIN_ALLOC_SIZE` bytes of the block are kept, since they hold
+ * its free list links.
+ *
+ * @param header Pointer to the header of the unallocated block.
+ *
+ * @return The number of bytes returned.
+ */
+static size_t xd_block_purge(xd_mem_block_header *header) {
+  uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)header->data + XD_MIN_ALLOC_SIZE;
+  uintptr_t end = (uintptr_t)header->data + xd_block_get_size(header);
+  start = (start + page_size - 1) & ~(page_size - 1);
+  end &= ~(page_size - 1);
+  if (start >= end || madvise((void *)start, end - start, MADV_DONTNEED) != 0) {
+    return 0;
+  }
+  return end - start;
+}  // xd_block_purge()
+
+/**
+ * @brief Returns the free pages of a heap to the OS, the free space at the top
+ * of the main heap is released using `sbrk()`.
+ *
+ * @param heap Pointer to the heap.
+ *
+ * @return The number of bytes returned.
+ *
+ * @note Must be called while holding the heap's mutex.
+ */
+static size_t xd_heap_purge(xd_heap *heap) {
+  size_t purged = 0;
+  if (heap != &xd_main_heap) {
+    for (xd_mem_block_header *header = heap->free_list_head; header != NULL;
+         header = header->next) {
+      purged += xd_block_purge(header);
+    }
+    return purged;
+  }
+
+#ifdef XD_USE_DEFERRED_FREES
+  xd_pending_free_drain();
+#endif
+  xd_byte *end = (xd_byte *)xd_heap_end_address;
+  xd_heap_trim();
+  purged += (size_t)(end - (xd_byte *)xd_heap_end_address);
+
+  // the free blocks are found by walking the heap, whatever tracks them
+  xd_mem_block_header *header = (xd_mem_block_header *)xd_heap_start_address;
+  while ((void *)header < xd_heap_end_address) {
+    if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
+      purged += xd_block_purge(header);
+    }
+    header = xd_block_get_next(header);
+  }
+  return purged;
+}  // xd_heap_purge()
+
+/**
+ * @brief Relieves memory pressure before the main heap grows past the soft
+ * limit: returns the free memory to the OS, then calls the memory pressure
+ * callbacks if growing by the passed size still crosses the limit.
+ *
+ * @param size The size (in bytes) the main heap is about to grow by.
+ *
+ * @note Must be called without holding any allocator mutex, since the
+ * callbacks free memory.
+ */
+static void xd_memory_pressure_relieve(size_t size) {
+  xd_pressure_active = true;
+  xd_malloc_purge();
+
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  size_t heap_size = (size_t)((xd_byte *)xd_heap_end_address -
+                              (xd_byte *)xd_heap_start_address);
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  size_t soft_limit = __atomic_load_n(&xd_soft_limit, __ATOMIC_RELAXED);
+  if (soft_limit == 0 || heap_size + size <= soft_limit) {
+    xd_pressure_active = false;
+    return;
+  }
+
+  // call the callbacks without holding the mutex, they may (un)register
+  pthread_mutex_lock(&xd_pressure_mutex);
+  size_t count = xd_pressure_callback_count;
+  xd_pressure_callback callbacks[XD_PRESSURE_CALLBACK_COUNT];
+  void *args[XD_PRESSURE_CALLBACK_COUNT];
+  memcpy(callbacks, xd_pressure_callbacks, count * sizeof(callbacks[0]));
+  memcpy(args, xd_pressure_callback_args, count * sizeof(args[0]));
+  pthread_mutex_unlock(&xd_pressure_mutex);
+  for (size_t i = 0; i < count; i++) {
+    callbacks[i](heap_size + size - soft_limit, args[i]);
+  }
+  xd_pressure_active = false;
+}  // xd_memory_pressure_relieve()
+
+/**
+ * @brief Relieves memory pressure if allocating a block of the passed size may
+ * grow the main heap past the soft limit, at most once per size of the heap so
+ * allocations served by the free list near the limit stay cheap.
+ *
+ * @param size The size (in bytes) of the block about to be allocated from the
+ * main heap.
+ *
+ * @note Must be called without holding any allocator mutex, before the main
+ * heap is locked for the allocation.
+ */
+static void xd_soft_limit_check(size_t size) {
+  size_t soft_limit = __atomic_load_n(&xd_soft_limit, __ATOMIC_RELAXED);
+  if (soft_limit == 0 || xd_pressure_active || xd_rt_mode) {
+    return;
+  }
+
+  void *heap_end = __atomic_load_n(&xd_heap_end_address, __ATOMIC_RELAXED);
+  size_t heap_size =
+      (size_t)((xd_byte *)heap_end - (xd_byte *)xd_heap_start_address);
+  if (heap_size + size <= soft_limit ||
+      heap_end == __atomic_load_n(&xd_pressure_heap_end, __ATOMIC_RELAXED)) {
+    return;
+  }
+
+  xd_memory_pressure_relieve(size);
+  __atomic_store_n(&xd_pressure_heap_end,
+                   __atomic_load_n(&xd_heap_end_address, __ATOMIC_RELAXED),
+                   __ATOMIC_RELAXED);
+}  // xd_soft_limit_check()
+
+#ifdef XD_USE_DEFERRED_FREES
+
+/**
+ * @brief Returns the index of a block's header in the side bitmaps, which have
+ * a bit per `XD_ALIGNMENT` bytes of the heap.
+ *
+ * @param header Pointer to the memory block header.
+ *
+ * @return The index of the header's bit.
+ */
+static inline size_t xd_block_granule_index(
+    const xd_mem_block_header *header) {
+  return (size_t)((const xd_byte *)header -
+                  (const xd_byte *)xd_heap_start_address) /
+         XD_ALIGNMENT;
+}  // xd_block_granule_index()
+
+/**
+ * @brief Tests a bit of a side bitmap.
+ *
+ * @param table Pointer to the side table holding the bitmap.
+ * @param index The index of the bit.
+ *
+ * @return `true` if the bit is set, `false` otherwise.
+ */
+static inline bool xd_side_bitmap_test(const xd_side_table *table,
+                                       size_t index) {
+  const size_t *words = (const size_t *)table->base;
+  return (words[index / XD_SIZE_BITS] >> (index % XD_SIZE_BITS)) & 1;
+}  // xd_side_bitmap_test()
+
+/**
+ * @brief Sets a bit of a side bitmap.
+ *
+ * @param table Pointer to the side table holding the bitmap.
+ * @param index The index of the bit.
+ */
+static inline void xd_side_bitmap_set(xd_side_table *table, size_t index) {
+  size_t *words = (size_t *)table->base;
+  words[index / XD_SIZE_BITS] |= (size_t)1 << (index % XD_SIZE_BITS);
+}  // xd_side_bitmap_set()
+
+/**
+ * @brief Clears a bit of a side bitmap.
+ *
+ * @param table Pointer to the side table holding the bitmap.
+ * @param index The index of the bit.
+ */
+static inline void xd_side_bitmap_clear(xd_side_table *table, size_t index) {
+  size_t *words = (size_t *)table->base;
+  words[index / XD_SIZE_BITS] &= ~((size_t)1 << (index % XD_SIZE_BITS));
+}  // xd_side_bitmap_clear()
+
+/**
+ * @brief Records the free of an allocated block in the side tables without
+ * writing to the heap, applying the pending frees first if the log is full.
+ *
+ * @param header Pointer to the header of the block to be freed.
+ *
+ * @return `true` if the free is pending, or `false` if the log could not be
+ * mapped and the block must be freed right away.
+ */
+static bool xd_pending_free_push(xd_mem_block_header *header) {
+  if (xd_side_table_reserve(&xd_pending_free_log,
+                            XD_PENDING_FREE_CAPACITY *
+                                sizeof(xd_mem_block_header *)) != 0) {
+    return false;
+  }
+
+  if (xd_pending_free_count == XD_PENDING_FREE_CAPACITY) {
+    xd_pending_free_drain();
+  }
+
+  xd_side_bitmap_set(&xd_pending_free_bitmap, xd_block_granule_index(header));
+  ((xd_mem_block_header **)xd_pending_free_log.base)[xd_pending_free_count++] =
+      header;
+  return true;
+}  // xd_pending_free_push()
+
+/**
+ * @brief Applies all the pending frees to the heap.
+ */
+static void xd_pending_free_drain() {
+  xd_mem_block_header **log = (xd_mem_block_header **)xd_pending_free_log.base;
+  for (size_t i = 0; i < xd_pending_free_count; i++) {
+    xd_side_bitmap_clear(&xd_pending_free_bitmap,
+                         xd_block_granule_index(log[i]));
+    xd_block_free(&xd_main_heap, log[i]);
+  }
+  xd_pending_free_count = 0;
+}  // xd_pending_free_drain()
+
+/**
+ * @brief Grows the side bitmaps so they cover a heap of the passed size.
+ *
+ * @param heap_size The size of the heap (in bytes).
+ *
+ * @return `0` on success, or `-1` on failure.
+ */
+static int xd_side_tables_reserve(size_t heap_size) {
+  size_t bit_count = (heap_size / XD_ALIGNMENT) + 1;
+  size_t size = ((bit_count / XD_SIZE_BITS) + 1) * sizeof(size_t);
+  if (xd_side_table_reserve(&xd_pending_free_bitmap, size) != 0) {
+    return -1;
+  }
+
+  // no block of the heap is larger than the heap
+  size_t class_count = xd_rt_bin_index(heap_size) + 1;
+  for (size_t class = 0; class < class_count; class++) {
+    size_t level_bit_count = bit_count;
+    for (size_t level = 0; level < XD_FREE_INDEX_LEVELS; level++) {
+      size = ((level_bit_count / XD_SIZE_BITS) + 1) * sizeof(size_t);
+      if (xd_side_table_reserve(&xd_free_index[class][level], size) != 0) {
+        return -1;
+      }
+      level_bit_count = (level_bit_count / XD_SIZE_BITS) + 1;
+    }
+  }
+  return 0;
+}  // xd_side_tables_reserve()
+
+/**
+ * @brief Returns the header of the block at the passed index of the side
+ * bitmaps.
+ *
+ * @param index The index of the header's bit.
+ *
+ * @return Pointer to the memory block header.
+ */
+static inline xd_mem_block_header *xd_block_from_granule_index(size_t index) {
+  return (xd_mem_block_header *)((xd_byte *)xd_heap_start_address +
+                                 (index * XD_ALIGNMENT));
+}  // xd_block_from_granule_index()
+
+/**
+ * @brief Marks the passed free block as free in the free index, under its size
+ * class.
+ *
+ * @param header Pointer to the header of the free block.
+ */
+static void xd_free_index_set(xd_mem_block_header *header) {
+  size_t class = xd_rt_bin_index(xd_block_get_size(header));
+  size_t index = xd_block_granule_index(header);
+  for (size_t level = 0; level < XD_FREE_INDEX_LEVELS; level++) {
+    xd_side_bitmap_set(&xd_free_index[class][level], index);
+    index /= XD_SIZE_BITS;
+  }
+  xd_free_index_counts[class]++;
+  xd_free_index_classes |= (size_t)1 << class;
+}  // xd_free_index_set()
+
+/**
+ * @brief Removes the passed free block from the free index.
+ *
+ * @param header Pointer to the header of the free block, must still hold the
+ * size it was indexed with.
+ */
+static void xd_free_index_clear(xd_mem_block_header *header) {
+  size_t class = xd_rt_bin_index(xd_block_get_size(header));
+  if (--xd_free_index_counts[class] == 0) {
+    xd_free_index_classes &= ~((size_t)1 << class);
+  }
+
+  size_t index = xd_block_granule_index(header);
+  for (size_t level = 0; level < XD_FREE_INDEX_LEVELS; level++) {
+    xd_side_table *table = &xd_free_index[class][level];
+    xd_side_bitmap_clear(table, index);
+
+    // the upper levels stay set while the word has other bits set
+    if (((size_t *)table->base)[index / XD_SIZE_BITS] != 0) {
+      return;
+    }
+    index /= XD_SIZE_BITS;
+  }
+}  // xd_free_index_clear()
+
+/**
+ * @brief Finds the first set bit of a level of a size class of the free index
+ * at or after the passed index, using the level above it to skip empty words.
+ *
+ * @param class The size class.
+ * @param level The level of the size class.
+ * @param from The index to start searching from.
+ *
+ * @return The index of the set bit, or `SIZE_MAX` if there is none.
+ */
+static size_t xd_free_index_next(size_t class, size_t level, size_t from) {
+  const size_t *words = (const size_t *)xd_free_index[class][level].base;
+  size_t word_count = xd_free_index[class][level].size / sizeof(size_t);
+  size_t word = from / XD_SIZE_BITS;
+  if (words == NULL || word >= word_count) {
+    return SIZE_MAX;
+  }
+
+  size_t bits = words[word] & (SIZE_MAX << (from % XD_SIZE_BITS));
+  while (bits == 0) {
+    if (level + 1 < XD_FREE_INDEX_LEVELS) {
+      word = xd_free_index_next(class, level + 1, word + 1);
+    }
+    else {
+      word++;
+    }
+    if (word == SIZE_MAX || word >= word_count) {
+      return SIZE_MAX;
+    }
+    bits = words[word];
+  }
+  return (word * XD_SIZE_BITS) + (size_t)__builtin_ctzl((unsigned long)bits);
+}  // xd_free_index_next()
+
+/**
+ * @brief Searches a size class of the free index for a block that can satisfy
+ * the requested size, in address order, using First-Fit by default or
+ * Best-Fit if `XD_USE_BEST_FIT` is defined.
+ *
+ * @param class The size class.
+ * @param size The requested size in bytes.
+ *
+ * @return A pointer to the header of a suitable free block, or `NULL` if no
+ * such block exists.
+ */
+static xd_mem_block_header *xd_free_index_class_find(size_t class,
+                                                     size_t size) {
+  // only the headers of the free blocks of the class are read
+  xd_mem_block_header *best_header = NULL;
+  size_t index = xd_free_index_next(class, 0, 0);
+  while (index != SIZE_MAX) {
+    xd_mem_block_header *header = xd_block_from_granule_index(index);
+    size_t header_size = xd_block_get_size(header);
+    if (header_size >= size) {
+#ifdef XD_USE_BEST_FIT
+      if (best_header == NULL || header_size < xd_block_get_size(best_header)) {
+        best_header = header;
+      }
+#else
+      return header;
+#endif
+    }
+    index = xd_free_index_next(class, 0, index + 1);
+  }
+  return best_header;
+}  // xd_free_index_class_find()
+
+/**
+ * @brief Searches the free index for a block that can satisfy the requested
+ * size: in the size class of the requested size first, whose blocks may be too
+ * small, then in the smallest non-empty class above it, whose blocks all fit.
+ *
+ * @param size The requested size in bytes.
+ *
+ * @return A pointer to the header of a suitable free block, or `NULL` if no
+ * such block exists.
+ */
+static xd_mem_block_header *xd_free_index_find(size_t size) {
+  size_t class = xd_rt_bin_index(size);
+  if ((xd_free_index_classes >> class) & 1) {
+    xd_mem_block_header *header = xd_free_index_class_find(class, size);
+    if (header != NULL) {
+      return header;
+    }
+  }
+
+  if (class + 1 == XD_RT_BIN_COUNT) {
+    return NULL;
+  }
+  size_t classes = xd_free_index_classes & (SIZE_MAX << (class + 1));
+  if (classes == 0) {
+    return NULL;
+  }
+  size_t next_class = (size_t)__builtin_ctzl((unsigned long)classes);
+  return xd_free_index_class_find(next_class, size);
+}  // xd_free_index_find()
+#endif
+
+// ========================
+// non-static functions
+// ========================
+
+void *xd_malloc(size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  return xd_malloc_from(size, (uintptr_t)__builtin_return_address(0));
+}  // xd_malloc()
+
+void xd_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  // blocks of the other heaps are in mapped chunks
+  xd_heap *heap = xd_chunk_registry_lookup(ptr);
+  if (heap != NULL) {
+    // the blocks of a stage are released together by `xd_heap_release_to()`
+    if (heap == &xd_shareable_heap) {
+      xd_shareable_free(ptr);
+    }
+    else if (heap != &xd_stage_heap) {
+      xd_heap_free(heap, xd_block_get_header_from_data(ptr));
+    }
+    if (heap == &xd_reserve_heap) {
+      __atomic_sub_fetch(&xd_reserve_blocks, 1, __ATOMIC_RELAXED);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&xd_main_heap.mutex);
+
+  // corrupted heap, function wont work
+  if (sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return;
+  }
+
+  // fail if the address is outside the heap
+  if (ptr < xd_heap_start_address || ptr > xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return;
+  }
+
+  xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
+
+  // double free is fatal abort
+  bool double_free = (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED);
+#ifdef XD_USE_DEFERRED_FREES
+  double_free = double_free ||
+                xd_side_bitmap_test(&xd_pending_free_bitmap,
+                                    xd_block_granule_index(header));
+#endif
+  if (double_free) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    fprintf(stderr, "xd_free(): double free detected\n");
+    abort();
+  }
+
+  if (xd_block_is_tracked(header)) {
+    xd_block_untrack(header);
+  }
+
+#ifdef XD_USE_DEFERRED_FREES
+  // only record the free in the side tables, the heap pages are written when
+  // the pending frees are applied
+  if (xd_pending_free_push(header)) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return;
+  }
+#endif
+
+  xd_block_free(&xd_main_heap, header);
+
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+}  // xd_free()
+
+void *xd_calloc(size_t n, size_t size) {
+  // corrupted heap, function wont work
+  if (xd_heap_is_corrupted()) {
+    return NULL;
+  }
+
+  if (n == 0 || size == 0) {
+    return NULL;
+  }
+  if (SIZE_MAX / n < size) {
+    return NULL;
+  }
+  size_t total_size = n * size;
+
+  // large requests are served already zeroed by the pool when possible, the
+  // pooled blocks are not cache line aligned nor released by marks
+  void *ptr = NULL;
+  if (xd_thread_policy == XD_THREAD_POLICY_SHARED && xd_stage_depth == 0 &&
+      xd_current_heap == NULL && xd_tag_current == 0) {
+    ptr = xd_zero_pool_take(total_size);
+    if (ptr != NULL) {
+      return ptr;
+    }
+  }
+
+  ptr = xd_malloc_from(total_size, (uintptr_t)__builtin_return_address(0));
+  if (ptr == NULL) {
+    return NULL;
+  }
+  memset(ptr, 0, total_size);
+  return ptr;
+}  // xd_calloc()
+
+void *xd_realloc(void *ptr, size_t size) {
+  // corrupted heap, function wont work
+  if (xd_heap_is_corrupted()) {
+    return NULL;
+  }
+
+  if (size == 0) {
+    xd_free(ptr);
+    return NULL;
+  }
+  if (ptr == NULL) {
+    return xd_malloc_from(size, (uintptr_t)__builtin_return_address(0));
+  }
+
+  xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
+  size_t old_size = xd_block_get_size(header);
+
+  // the moved block keeps the tag of the block, not the current one
+  unsigned int tag = 0;
+  if (xd_block_is_tracked(header)) {
+    pthread_mutex_lock(&xd_tag_mutex);
+    tag = xd_tag_find(header);
+    pthread_mutex_unlock(&xd_tag_mutex);
+  }
+  unsigned int current_tag = xd_tag_current;
+  xd_tag_current = tag;
+
+  // allocate-copy-free, keeping the block in its heap (the blocks of the
+  // reserve leave it when possible), only the blocks of a stage are moved to
+  // the stage since the others must outlive the mark
+  xd_heap *heap = xd_chunk_registry_lookup(ptr);
+  void *new_ptr;
+  if (heap == &xd_shareable_heap) {
+    // the block stays in its memfd while it fits, so its descriptor and
+    // offset remain valid
+    if (size <= old_size) {
+      xd_tag_current = current_tag;
+      return ptr;
+    }
+    int fd;
+    size_t offset;
+    new_ptr = xd_malloc_shareable(size, &fd, &offset);
+  }
+  else if (heap != NULL && heap != &xd_stage_heap &&
+           heap != &xd_reserve_heap) {
+    new_ptr = xd_heap_malloc(heap, size);
+  }
+  else if (heap != &xd_stage_heap && xd_stage_depth > 0) {
+    new_ptr = xd_main_heap_malloc(size);
+  }
+  else {
+    new_ptr = xd_malloc_from(size, (uintptr_t)__builtin_return_address(0));
+  }
+  xd_tag_current = current_tag;
+  if (new_ptr == NULL) {
+    return NULL;
+  }
+  memcpy(new_ptr, ptr, (old_size < size) ? old_size : size);
+  xd_free(ptr);
+  return new_ptr;
+}  // xd_realloc()
+
+int xd_malloc_reserve(size_t bytes, int flags) {
+  if (bytes == 0) {
+    return 0;
+  }
+
+  xd_soft_limit_check(bytes);
+  pthread_mutex_lock(&xd_main_heap.mutex);
+
+  // corrupted heap, function wont work
+  if (sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return -1;
+  }
+
+  bytes = xd_block_adjust_size(bytes);
+
+  // reuse a large enough free block or grow the heap
+  xd_mem_block_header *block_header =
+      xd_free_list_find_or_drain(&xd_main_heap, bytes);
+  if (block_header == NULL) {
+    block_header = xd_heap_grow(&xd_main_heap, bytes);
+    if (block_header == NULL) {
+      errno = ENOMEM;
+      pthread_mutex_unlock(&xd_main_heap.mutex);
+      return -1;
+    }
+  }
+
+  if ((flags & (XD_RESERVE_PREFAULT | XD_RESERVE_PREFAULT_PARALLEL)) != 0) {
+    xd_prefault((xd_byte *)block_header,
+                (xd_byte *)xd_block_get_next(block_header),
+                (flags & XD_RESERVE_PREFAULT_PARALLEL) != 0);
+  }
+
+  // in real-time mode all the heap must stay locked into RAM
+  if (xd_rt_mode && xd_rt_lock_heap() != 0) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return -1;
+  }
+
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return 0;
+}  // xd_malloc_reserve()
+
+void *xd_malloc_cacheline(size_t size) {
+  // allocate under the cache line policy regardless of the thread's policy
+  int policy = xd_thread_policy;
+  xd_thread_policy = XD_THREAD_POLICY_CACHELINE;
+  void *ptr = xd_malloc(size);
+  xd_thread_policy = policy;
+  return ptr;
+}  // xd_malloc_cacheline()
+
+int xd_malloc_thread_policy(int policy) {
+  if (policy != XD_THREAD_POLICY_SHARED &&
+      policy != XD_THREAD_POLICY_CACHELINE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int previous_policy = xd_thread_policy;
+  xd_thread_policy = policy;
+  return previous_policy;
+}  // xd_malloc_thread_policy()
+
+void *xd_malloc_hint(size_t size, int hint) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  // the heap can't map chunks in real-time mode
+  xd_heap *heap = xd_hint_heap(hint);
+  if (heap == NULL || xd_rt_mode) {
+    return xd_malloc(size);
+  }
+  return xd_heap_malloc(heap, size);
+}  // xd_malloc_hint()
+
+void *xd_malloc_cold(size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  // the heap can't map chunks in real-time mode
+  if (xd_rt_mode) {
+    return xd_malloc(size);
+  }
+  return xd_heap_malloc(&xd_cold_heap, size);
+}  // xd_malloc_cold()
+
+int xd_heap_mark_cold(void) {
+#if defined(MADV_COLD) && defined(MADV_PAGEOUT)
+  // only reclaim the pages right away when memory is actually short, they are
+  // faulted back in on the next access either way
+  int advice = xd_memory_under_pressure() ? MADV_PAGEOUT : MADV_COLD;
+  return xd_chunk_registry_advise(&xd_cold_heap, advice);
+#else
+  errno = ENOTSUP;
+  return -1;
+#endif
+}  // xd_heap_mark_cold()
+
+void *xd_malloc_shareable(size_t size, int *fd, size_t *offset) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  // the heap can't map chunks in real-time mode
+  if (xd_rt_mode) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (size > SIZE_MAX - (2 * XD_ALIGNMENT)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  // the block takes its whole chunk, so the memfd holds nothing else
+  pthread_mutex_lock(&xd_shareable_heap.mutex);
+  xd_mem_block_header *header =
+      xd_heap_chunk_map(&xd_shareable_heap, xd_block_adjust_size(size));
+  if (header == NULL) {
+    pthread_mutex_unlock(&xd_shareable_heap.mutex);
+    errno = ENOMEM;
+    return NULL;
+  }
+  xd_block_set_state(header, XD_MEM_BLOCK_ALLOCATED);
+  xd_shareable_heap.mapped +=
+      xd_block_get_size(header) + (3 * XD_BLOCK_HEADER_SIZE);
+  xd_shareable_heap.allocated += xd_block_get_size(header);
+  pthread_mutex_unlock(&xd_shareable_heap.mutex);
+
+  void *ptr = (void *)header->data;
+  xd_shareable_info(ptr, fd, offset);
+  return ptr;
+}  // xd_malloc_shareable()
+
+int xd_shareable_info(const void *ptr, int *fd, size_t *offset) {
+  xd_chunk_range range;
+  if (ptr == NULL || fd == NULL || offset == NULL ||
+      !xd_chunk_registry_find(ptr, &range) ||
+      range.heap != &xd_shareable_heap) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *fd = range.fd;
+  *offset = (size_t)((const xd_byte *)ptr - (xd_byte *)range.start);
+  return 0;
+}  // xd_shareable_info()
+
+xd_iopool *xd_iopool_create(size_t buffer_size, size_t count, int flags) {
+  if (buffer_size == 0 || count == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  // buffers are whole pages, chunks are whole huge pages if requested
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t granularity =
+      (flags & XD_IOPOOL_HUGEPAGE) ? XD_HUGE_PAGE_SIZE : page_size;
+  if (buffer_size > SIZE_MAX - granularity ||
+      count > (SIZE_MAX - granularity) / (buffer_size + page_size)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  buffer_size = (buffer_size + page_size - 1) & ~(page_size - 1);
+  size_t chunk_size = buffer_size * count;
+  chunk_size = (chunk_size + granularity - 1) & ~(granularity - 1);
+
+  xd_iopool *pool = xd_heap_malloc(&xd_internal_heap, sizeof(xd_iopool));
+  if (pool == NULL) {
+    return NULL;
+  }
+  memset(pool, 0, sizeof(xd_iopool));
+  int error = pthread_mutex_init(&pool->mutex, NULL);
+  if (error != 0) {
+    xd_free(pool);
+    errno = error;
+    return NULL;
+  }
+  pool->buffer_size = buffer_size;
+  pool->chunk_size = chunk_size;
+  pool->flags = flags;
+
+  // map the first chunk right away, so its region can be registered
+  if (xd_iopool_grow(pool) != 0) {
+    error = errno;
+    xd_free(pool->regions);
+    pthread_mutex_destroy(&pool->mutex);
+    xd_free(pool);
+    errno = error;
+    return NULL;
+  }
+
+  pthread_mutex_lock(&xd_iopools_mutex);
+  pool->id = xd_iopool_next_id++;
+  pool->next = xd_iopools;
+  xd_iopools = pool;
+  pthread_mutex_unlock(&xd_iopools_mutex);
+  return pool;
+}  // xd_iopool_create()
+
+void xd_iopool_destroy(xd_iopool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&xd_iopools_mutex);
+  xd_iopool **link = &xd_iopools;
+  while (*link != pool) {
+    link = &(*link)->next;
+  }
+  *link = pool->next;
+  pthread_mutex_unlock(&xd_iopools_mutex);
+
+  // the caches of other threads are dropped when they next use the slot
+  xd_iopool_cache *cache =
+      &xd_iopool_thread_caches[pool->id % XD_IOPOOL_THREAD_CACHES];
+  if (cache->pool == pool && cache->id == pool->id) {
+    cache->pool = NULL;
+    cache->count = 0;
+  }
+
+  for (size_t i = 0; i < pool->region_count; i++) {
+    munmap(pool->regions[i].base, pool->regions[i].size);
+  }
+  xd_free(pool->regions);
+  pthread_mutex_destroy(&pool->mutex);
+  xd_free(pool);
+}  // xd_iopool_destroy()
+
+void *xd_iopool_get(xd_iopool *pool) {
+  // reuse the buffers recently put back by the thread without locking
+  xd_iopool_cache *cache =
+      &xd_iopool_thread_caches[pool->id % XD_IOPOOL_THREAD_CACHES];
+  if (cache->pool == pool && cache->id == pool->id && cache->count > 0) {
+    return cache->buffers[--cache->count];
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->free_list == NULL && xd_iopool_grow(pool) != 0) {
+    pthread_mutex_unlock(&pool->mutex);
+    errno = ENOMEM;
+    return NULL;
+  }
+  void *buffer = pool->free_list;
+  pool->free_list = *(void **)buffer;
+  pthread_mutex_unlock(&pool->mutex);
+  return buffer;
+}  // xd_iopool_get()
+
+void xd_iopool_put(xd_iopool *pool, void *buffer) {
+  if (buffer == NULL) {
+    return;
+  }
+
+  // take over the slot, returning the buffers of the pool using it
+  xd_iopool_cache *cache =
+      &xd_iopool_thread_caches[pool->id % XD_IOPOOL_THREAD_CACHES];
+  if (cache->pool != pool || cache->id != pool->id) {
+    xd_iopool_cache_flush(cache, cache->count);
+    pthread_once(&xd_iopool_key_once, xd_iopool_key_create);
+    pthread_setspecific(xd_iopool_key, xd_iopool_thread_caches);
+    cache->pool = pool;
+    cache->id = pool->id;
+  }
+
+  if (cache->count == XD_IOPOOL_CACHE_SIZE) {
+    xd_iopool_cache_flush(cache, XD_IOPOOL_CACHE_SIZE / 2);
+  }
+  cache->buffers[cache->count++] = buffer;
+}  // xd_iopool_put()
+
+size_t xd_iopool_regions(xd_iopool *pool, xd_iopool_region *regions,
+                         size_t max_regions) {
+  pthread_mutex_lock(&pool->mutex);
+  size_t count = pool->region_count;
+  for (size_t i = 0; i < count && i < max_regions; i++) {
+    regions[i] = pool->regions[i];
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return count;
+}  // xd_iopool_regions()
+
+int xd_malloc_memory_limit(size_t limit) {
+  // read the limit of the cgroup again
+  if (limit == 0) {
+    xd_cgroup_detect();
+    if (!xd_cgroup_read("memory.max", &limit) || limit == SIZE_MAX) {
+      __atomic_store_n(&xd_memory_limit, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&xd_memory_tight, false, __ATOMIC_RELAXED);
+      errno = ENOENT;
+      return -1;
+    }
+  }
+  __atomic_store_n(&xd_memory_limit, limit, __ATOMIC_RELAXED);
+  xd_memory_limit_check();
+  return 0;
+}  // xd_malloc_memory_limit()
+
+size_t xd_malloc_purge(void) {
+  // locked pages must stay resident in real-time mode
+  if (xd_rt_mode) {
+    return 0;
+  }
+
+  xd_zero_pool_drain();
+  xd_epoch_reclaim();
+
+  size_t purged = 0;
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  if (sbrk(0) == xd_heap_end_address) {
+    purged += xd_heap_purge(&xd_main_heap);
+  }
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+
+  xd_heap *heaps[XD_HINT_HEAP_COUNT + 2];
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT; i++) {
+    heaps[i] = &xd_hint_heaps[i];
+  }
+  heaps[XD_HINT_HEAP_COUNT] = &xd_cold_heap;
+  heaps[XD_HINT_HEAP_COUNT + 1] = &xd_internal_heap;
+  for (size_t i = 0; i < XD_HINT_HEAP_COUNT + 2; i++) {
+    pthread_mutex_lock(&heaps[i]->mutex);
+    purged += xd_heap_purge(heaps[i]);
+    pthread_mutex_unlock(&heaps[i]->mutex);
+  }
+
+  pthread_mutex_lock(&xd_created_heaps_mutex);
+  for (xd_heap *heap = xd_created_heaps; heap != NULL; heap = heap->next) {
+    pthread_mutex_lock(&heap->mutex);
+    purged += xd_heap_purge(heap);
+    pthread_mutex_unlock(&heap->mutex);
+  }
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+  return purged;
+}  // xd_malloc_purge()
+
+void xd_malloc_set_soft_limit(size_t bytes) {
+  __atomic_store_n(&xd_soft_limit, bytes, __ATOMIC_RELAXED);
+  __atomic_store_n(&xd_pressure_heap_end, NULL, __ATOMIC_RELAXED);
+}  // xd_malloc_set_soft_limit()
+
+int xd_malloc_pressure_callback_add(xd_pressure_callback callback, void *arg) {
+  if (callback == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&xd_pressure_mutex);
+  if (xd_pressure_callback_count == XD_PRESSURE_CALLBACK_COUNT) {
+    pthread_mutex_unlock(&xd_pressure_mutex);
+    errno = ENOMEM;
+    return -1;
+  }
+  xd_pressure_callbacks[xd_pressure_callback_count] = callback;
+  xd_pressure_callback_args[xd_pressure_callback_count] = arg;
+  xd_pressure_callback_count++;
+  pthread_mutex_unlock(&xd_pressure_mutex);
+  return 0;
+}  // xd_malloc_pressure_callback_add()
+
+int xd_malloc_pressure_callback_remove(xd_pressure_callback callback,
+                                       void *arg) {
+  pthread_mutex_lock(&xd_pressure_mutex);
+  for (size_t i = 0; i < xd_pressure_callback_count; i++) {
+    if (xd_pressure_callbacks[i] == callback &&
+        xd_pressure_callback_args[i] == arg) {
+      // keep the callbacks in registration order
+      xd_pressure_callback_count--;
+      memmove(&xd_pressure_callbacks[i], &xd_pressure_callbacks[i + 1],
+              (xd_pressure_callback_count - i) * sizeof(xd_pressure_callback));
+      memmove(&xd_pressure_callback_args[i], &xd_pressure_callback_args[i + 1],
+              (xd_pressure_callback_count - i) * sizeof(void *));
+      pthread_mutex_unlock(&xd_pressure_mutex);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&xd_pressure_mutex);
+  errno = ENOENT;
+  return -1;
+}  // xd_malloc_pressure_callback_remove()
+
+int xd_malloc_emergency_reserve(size_t bytes) {
+  if (bytes == 0) {
+    return 0;
+  }
+  if (bytes > SIZE_MAX - XD_HEAP_CHUNK_SIZE) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  pthread_mutex_lock(&xd_reserve_heap.mutex);
+  xd_mem_block_header *chunk_header =
+      xd_heap_chunk_map(&xd_reserve_heap, xd_block_adjust_size(bytes));
+  if (chunk_header == NULL) {
+    pthread_mutex_unlock(&xd_reserve_heap.mutex);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  // fault the pages in now, the reserve is used when memory is short
+  xd_prefault_range range = {
+      .start = (xd_byte *)chunk_header->data,
+      .end = (xd_byte *)xd_block_get_next(chunk_header),
+  };
+  xd_prefault_worker(&range);
+
+  if (!xd_heap_chunk_try_coalesce(&xd_reserve_heap, chunk_header)) {
+    xd_free_list_insert(&xd_reserve_heap, chunk_header);
+    xd_reserve_heap.recent_chunk_right_fencepost =
+        xd_block_get_next(chunk_header);
+  }
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+  return 0;
+}  // xd_malloc_emergency_reserve()
+
+void xd_malloc_set_reserve_hook(xd_reserve_hook hook, void *arg) {
+  pthread_mutex_lock(&xd_reserve_heap.mutex);
+  xd_reserve_hook_function = hook;
+  xd_reserve_hook_arg = arg;
+  pthread_mutex_unlock(&xd_reserve_heap.mutex);
+}  // xd_malloc_set_reserve_hook()
+
+int xd_malloc_in_reserve_mode(void) {
+  return __atomic_load_n(&xd_reserve_blocks, __ATOMIC_RELAXED) != 0;
+}  // xd_malloc_in_reserve_mode()
+
+int xd_malloc_tag_push(unsigned int tag) {
+  if (tag == 0 || tag > XD_TAG_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (xd_tag_stack_depth == XD_TAG_STACK_SIZE) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  xd_tag_stack[xd_tag_stack_depth++] = xd_tag_current;
+  xd_tag_current = tag;
+  return 0;
+}  // xd_malloc_tag_push()
+
+void xd_malloc_tag_pop(void) {
+  if (xd_tag_stack_depth == 0) {
+    return;
+  }
+  xd_tag_current = xd_tag_stack[--xd_tag_stack_depth];
+}  // xd_malloc_tag_pop()
+
+int xd_malloc_tag_stats(unsigned int tag, xd_tag_stats *stats) {
+  if (tag == 0 || tag > XD_TAG_MAX || stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&xd_tag_mutex);
+  *stats = xd_tag_stats_table[tag];
+  pthread_mutex_unlock(&xd_tag_mutex);
+  return 0;
+}  // xd_malloc_tag_stats()
+
+void xd_malloc_leak_detection(FILE *out) {
+  __atomic_store_n(&xd_leak_stacks, out != NULL, __ATOMIC_RELAXED);
+  xd_leak_report_stream = out;
+}  // xd_malloc_leak_detection()
+
+size_t xd_malloc_leak_report(FILE *out) {
+  // blocks held by the allocator itself are not leaks
+  xd_zero_pool_drain();
+
+  xd_heaps_lock();
+  xd_leak_totals totals = {0, 0};
+  xd_heaps_walk(xd_leak_block_count, &totals);
+  fprintf(out, "xd_malloc: %zu bytes leaked in %zu blocks\n", totals.bytes,
+          totals.blocks);
+
+  // group the sampled blocks, scaled by the sample period
+  size_t groups_size =
+      (XD_PREDICT_SAMPLE_COUNT + XD_LEAK_SAMPLE_COUNT) * sizeof(xd_leak_group);
+  xd_leak_group *groups = mmap(NULL, groups_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  size_t count = 0;
+  if (groups != MAP_FAILED) {
+    count = xd_leak_groups_collect(groups);
+  }
+  xd_heaps_unlock();
+
+  if (groups == MAP_FAILED) {
+    fflush(out);
+    return totals.bytes;
+  }
+  size_t period = __atomic_load_n(&xd_predict_period, __ATOMIC_RELAXED);
+  if (period == 0) {
+    period = 1;
+  }
+  qsort(groups, count, sizeof(xd_leak_group), xd_leak_group_compare);
+  for (size_t i = 0; i < count && i < XD_LEAK_REPORT_STACKS; i++) {
+    fprintf(out, "xd_malloc: ~%zu bytes in ~%zu blocks allocated at:\n",
+            groups[i].bytes * period, groups[i].blocks * period);
+    for (size_t j = 0; j < XD_LEAK_STACK_DEPTH && groups[i].stack[j] != 0;
+         j++) {
+      fprintf(out, "    #%zu 0x%" PRIxPTR "\n", j, groups[i].stack[j]);
+    }
+  }
+  munmap(groups, groups_size);
+  fflush(out);
+  return totals.bytes;
+}  // xd_malloc_leak_report()
+
+int xd_malloc_snapshot(FILE *out) {
+  // blocks held by the allocator itself are free in the snapshot
+  xd_zero_pool_drain();
+
+  xd_heaps_lock();
+  pthread_mutex_lock(&xd_predict_mutex);
+  pthread_mutex_lock(&xd_tag_mutex);
+
+  // the records are copied to a buffer and written once the allocator is
+  // unlocked, so writing can't wait on a thread that is allocating (such as
+  // the reader of a pipe)
+  xd_snapshot_writer writer = {NULL, 0};
+  xd_heaps_walk(xd_snapshot_block_write, &writer);
+  xd_snapshot_header header = {
+      .magic = XD_SNAPSHOT_MAGIC,
+      .version = XD_SNAPSHOT_VERSION,
+      .stack_depth = XD_SNAPSHOT_STACK_DEPTH,
+      .sample_period = __atomic_load_n(&xd_predict_period, __ATOMIC_RELAXED),
+      .block_count = writer.blocks,
+      .sample_count = xd_predict_sample_count + xd_leak_sample_count,
+  };
+  size_t samples_offset =
+      sizeof(header) + (header.block_count * sizeof(xd_snapshot_block));
+  size_t buffer_size =
+      samples_offset + (header.sample_count * sizeof(xd_snapshot_sample));
+  unsigned char *buffer = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer == MAP_FAILED) {
+    pthread_mutex_unlock(&xd_tag_mutex);
+    pthread_mutex_unlock(&xd_predict_mutex);
+    xd_heaps_unlock();
+    errno = ENOMEM;
+    return -1;
+  }
+
+  memcpy(buffer, &header, sizeof(header));
+  writer = (xd_snapshot_writer){(xd_snapshot_block *)(buffer + sizeof(header)),
+                                0};
+  xd_heaps_walk(xd_snapshot_block_write, &writer);
+
+  xd_snapshot_sample *samples = (xd_snapshot_sample *)(buffer + samples_offset);
+  size_t sample_count = 0;
+  for (size_t i = 0; i < XD_PREDICT_SAMPLE_COUNT; i++) {
+    const xd_predict_sample *predict_sample = &xd_predict_samples[i];
+    if (predict_sample->header == NULL) {
+      continue;
+    }
+    xd_snapshot_sample *sample = &samples[sample_count++];
+    sample->address = (uint64_t)(uintptr_t)predict_sample->header->data;
+    sample->size = xd_block_get_size(predict_sample->header);
+    for (size_t j = 0; j < XD_SNAPSHOT_STACK_DEPTH; j++) {
+      sample->stack[j] = predict_sample->stack[j];
+    }
+  }
+  for (size_t i = 0; i < XD_LEAK_SAMPLE_COUNT; i++) {
+    const xd_leak_sample *leak_sample = &xd_leak_samples[i];
+    if (leak_sample->header == NULL) {
+      continue;
+    }
+    xd_snapshot_sample *sample = &samples[sample_count++];
+    sample->address = (uint64_t)(uintptr_t)leak_sample->header->data;
+    sample->size = xd_block_get_size(leak_sample->header);
+    for (size_t j = 0; j < XD_SNAPSHOT_STACK_DEPTH; j++) {
+      sample->stack[j] = leak_sample->stack[j];
+    }
+  }
+
+  pthread_mutex_unlock(&xd_tag_mutex);
+  pthread_mutex_unlock(&xd_predict_mutex);
+  xd_heaps_unlock();
+
+  bool failed = (fwrite(buffer, 1, buffer_size, out) != buffer_size);
+  munmap(buffer, buffer_size);
+  if (failed || fflush(out) != 0) {
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}  // xd_malloc_snapshot()
+
+void xd_malloc_lifetime_prediction(size_t sample_period) {
+  __atomic_store_n(&xd_predict_period, sample_period, __ATOMIC_RELAXED);
+}  // xd_malloc_lifetime_prediction()
+
+int xd_malloc_group(const size_t *sizes, size_t n, void **out_ptrs) {
+  if (n == 0) {
+    return 0;
+  }
+  if (sizes == NULL || out_ptrs == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // the members are laid out block after block, so the first member's header
+  // is the only one not counted
+  size_t total_size = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (sizes[i] == 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    if (sizes[i] > SIZE_MAX - (2 * XD_ALIGNMENT) - XD_BLOCK_HEADER_SIZE) {
+      errno = ENOMEM;
+      return -1;
+    }
+    size_t member_size = xd_block_adjust_size(sizes[i]) + XD_BLOCK_HEADER_SIZE;
+    if (total_size > SIZE_MAX - member_size) {
+      errno = ENOMEM;
+      return -1;
+    }
+    total_size += member_size;
+  }
+  total_size -= XD_BLOCK_HEADER_SIZE;
+
+  // the members belong to the current heap like any other block of the task
+  xd_heap *heap = (xd_current_heap != NULL) ? xd_current_heap : &xd_main_heap;
+  if (heap == &xd_main_heap) {
+    xd_soft_limit_check(total_size);
+  }
+  pthread_mutex_lock(&heap->mutex);
+
+  // corrupted heap, function wont work
+  if (heap == &xd_main_heap && sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&heap->mutex);
+    return -1;
+  }
+
+  xd_heap_quota_excess = 0;
+  xd_mem_block_header *block_header = xd_heap_find_or_grow(heap, total_size);
+  if (block_header == NULL && xd_heap_quota_excess != 0) {
+    xd_heap_quota_call(heap);
+    block_header = xd_heap_find_or_grow(heap, total_size);
+  }
+  if (block_header == NULL) {
+    errno = ENOMEM;
+    pthread_mutex_unlock(&heap->mutex);
+    return -1;
+  }
+
+  // carve the members from the start of the free block, the rest is inserted
+  // into the free list by every split and taken back for the next member
+  xd_free_list_remove(heap, block_header);
+  xd_mem_block_header *header = block_header;
+  for (size_t i = 0; i < n - 1; i++) {
+    xd_block_split(heap, header, xd_block_adjust_size(sizes[i]));
+    xd_block_set_state(header, XD_MEM_BLOCK_ALLOCATED);
+    out_ptrs[i] = (void *)header->data;
+    header = xd_block_get_next(header);
+    xd_free_list_remove(heap, header);
+  }
+  xd_block_allocate(heap, header, xd_block_adjust_size(sizes[n - 1]));
+  out_ptrs[n - 1] = (void *)header->data;
+
+  // the blocks of the main heap are not freed by `xd_heap_free()`
+  if (heap != &xd_main_heap) {
+    for (size_t i = 0; i < n; i++) {
+      heap->allocated +=
+          xd_block_get_size(xd_block_get_header_from_data(out_ptrs[i]));
+    }
+  }
+
+  pthread_mutex_unlock(&heap->mutex);
+  return 0;
+}  // xd_malloc_group()
+
+xd_mark xd_heap_mark(void) {
+  xd_mark mark = {xd_stage_top, xd_stage_depth};
+  xd_stage_depth++;
+  return mark;
+}  // xd_heap_mark()
+
+void xd_heap_release_to(xd_mark mark) {
+  // the mark was already released
+  if (mark.depth >= xd_stage_depth) {
+    return;
+  }
+
+  // unmap the segments mapped after the mark, the rest is reused
+  xd_stage_segment *segment = xd_stage_segment_top;
+  while (segment != NULL && segment->base > mark.top) {
+    xd_stage_segment *prev = segment->prev;
+    xd_stage_segment_unmap(segment);
+    segment = prev;
+  }
+
+  // the key only exists once a segment was mapped
+  if (segment != xd_stage_segment_top) {
+    xd_stage_segment_top = segment;
+    pthread_setspecific(xd_stage_key, xd_stage_segment_top);
+  }
+
+  xd_stage_top = mark.top;
+  xd_stage_depth = mark.depth;
+}  // xd_heap_release_to()
+
+xd_heap *xd_heap_create(void) {
+  xd_heap *heap = xd_heap_malloc(&xd_internal_heap, sizeof(xd_heap));
+  if (heap == NULL) {
+    return NULL;
+  }
+  heap->free_list_head = NULL;
+  heap->recent_chunk_right_fencepost = NULL;
+  heap->mapped = 0;
+  heap->allocated = 0;
+  heap->quota = 0;
+  heap->quota_callback = NULL;
+  heap->quota_arg = NULL;
+  if (pthread_mutex_init(&heap->mutex, NULL) != 0) {
+    xd_free(heap);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  pthread_mutex_lock(&xd_created_heaps_mutex);
+  heap->next = xd_created_heaps;
+  xd_created_heaps = heap;
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+  return heap;
+}  // xd_heap_create()
+
+void xd_heap_destroy(xd_heap *heap) {
+  if (heap == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&xd_created_heaps_mutex);
+  xd_heap **link = &xd_created_heaps;
+  while (*link != heap) {
+    link = &(*link)->next;
+  }
+  *link = heap->next;
+  pthread_mutex_unlock(&xd_created_heaps_mutex);
+
+  // all the blocks are freed at once with their chunks
+  xd_tag_heap_forget(heap);
+  xd_chunk_registry_unmap(heap);
+  pthread_mutex_destroy(&heap->mutex);
+  xd_free(heap);
+}  // xd_heap_destroy()
+
+int xd_heap_set_quota(xd_heap *heap, size_t bytes, xd_quota_callback callback,
+                      void *arg) {
+  if (heap == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&heap->mutex);
+  heap->quota = bytes;
+  heap->quota_callback = callback;
+  heap->quota_arg = arg;
+  pthread_mutex_unlock(&heap->mutex);
+  return 0;
+}  // xd_heap_set_quota()
+
+int xd_heap_get_usage(xd_heap *heap, xd_heap_usage *usage) {
+  if (heap == NULL || usage == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&heap->mutex);
+  usage->quota = heap->quota;
+  usage->mapped = heap->mapped;
+  usage->allocated = heap->allocated;
+  pthread_mutex_unlock(&heap->mutex);
+  return 0;
+}  // xd_heap_get_usage()
+
+int xd_heap_push_current(xd_heap *heap) {
+  if (heap == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (xd_heap_stack_depth == XD_HEAP_STACK_SIZE) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  xd_heap_stack[xd_heap_stack_depth++] = xd_current_heap;
+  xd_current_heap = heap;
+  return 0;
+}  // xd_heap_push_current()
+
+void xd_heap_pop_current(void) {
+  if (xd_heap_stack_depth == 0) {
+    return;
+  }
+  xd_current_heap = xd_heap_stack[--xd_heap_stack_depth];
+}  // xd_heap_pop_current()
+
+void xd_epoch_enter(void) {
+  xd_epoch_record *record = xd_epoch_record_get();
+  if (record == NULL || record->nesting++ > 0) {
+    return;
+  }
+
+  // publish the observed epoch before reading any shared pointer
+  size_t epoch = __atomic_load_n(&xd_epoch_global, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&record->state, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}  // xd_epoch_enter()
+
+void xd_epoch_exit(void) {
+  xd_epoch_record *record = xd_epoch_thread_record;
+  if (record == NULL || record->nesting == 0 || --record->nesting > 0) {
+    return;
+  }
+  __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+}  // xd_epoch_exit()
+
+void xd_free_deferred(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  // the block is leaked rather than freed while it may still be read
+  xd_epoch_record *record = xd_epoch_record_get();
+  if (record == NULL) {
+    return;
+  }
+  if (record->retired_count == record->retired_capacity) {
+    xd_epoch_try_advance();
+    xd_epoch_record_reclaim(record);
+  }
+  if (record->retired_count == record->retired_capacity) {
+    size_t capacity = (record->retired_capacity == 0)
+                          ? XD_EPOCH_BATCH
+                          : 2 * record->retired_capacity;
+    xd_epoch_retired *retired = xd_heap_malloc(
+        &xd_internal_heap, capacity * sizeof(xd_epoch_retired));
+    if (retired == NULL) {
+      return;
+    }
+    if (record->retired != NULL) {
+      memcpy(retired, record->retired,
+             record->retired_count * sizeof(xd_epoch_retired));
+      xd_free(record->retired);
+    }
+    record->retired = retired;
+    record->retired_capacity = capacity;
+  }
+
+  record->retired[record->retired_count++] = (xd_epoch_retired){
+      ptr, __atomic_load_n(&xd_epoch_global, __ATOMIC_SEQ_CST)};
+
+  // free the safe blocks in batches
+  if (record->retired_count % XD_EPOCH_BATCH == 0) {
+    xd_epoch_try_advance();
+    xd_epoch_record_reclaim(record);
+  }
+}  // xd_free_deferred()
 
-  // roundup to multiple of XD_ARENA_SIZE
-  if (size % XD_ARENA_SIZE != 0) {
-    size += XD_ARENA_SIZE - (size % XD_ARENA_SIZE);
+size_t xd_epoch_reclaim(void) {
+  xd_epoch_record *record = xd_epoch_thread_record;
+  if (record == NULL) {
+    return 0;
   }
+  xd_epoch_try_advance();
+  return xd_epoch_record_reclaim(record);
+}  // xd_epoch_reclaim()
 
-  // increase heap size (request the chunk)
-  void *chunk = sbrk((intptr_t)size);
-  if (chunk == (void *)-1 || (intptr_t)chunk % XD_ALIGNMENT != 0) {
-    return NULL;
+xd_handle xd_halloc(size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  if (size > SIZE_MAX - (2 * XD_ALIGNMENT) - XD_HANDLE_HEADER_SIZE) {
+    errno = ENOMEM;
+    return 0;
   }
 
-  xd_heap_end_address = sbrk(0);
+  pthread_mutex_lock(&xd_main_heap.mutex);
 
-  // clean block size (data section)
-  size -= 3 * XD_BLOCK_HEADER_SIZE;
+  // corrupted heap, function wont work
+  if (sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return 0;
+  }
 
-  // create the left fencepost
-  xd_mem_block_header *left_fencepost = (xd_mem_block_header *)chunk;
-  xd_block_set_size_and_state(left_fencepost, 0, XD_MEM_BLOCK_FENCEPOST);
-  left_fencepost->prev_size = 0;
+  // take a free slot, or add one
+  xd_handle handle = xd_handle_free_head;
+  if (handle == 0) {
+    size_t table_size = (xd_handle_count + 1) * sizeof(xd_handle_entry);
+    if (xd_side_table_reserve(&xd_handle_table, table_size) != 0) {
+      errno = ENOMEM;
+      pthread_mutex_unlock(&xd_main_heap.mutex);
+      return 0;
+    }
+    handle = xd_handle_count + 1;
+  }
 
-  // create the free block
-  xd_mem_block_header *chunk_header = xd_block_get_next(left_fencepost);
-  xd_block_set_size_and_state(chunk_header, size, XD_MEM_BLOCK_UNALLOCATED);
-  chunk_header->prev_size = 0;
+  xd_mem_block_header *header = xd_heap_alloc(
+      &xd_main_heap, xd_block_adjust_size(size + XD_HANDLE_HEADER_SIZE));
+  if (header == NULL) {
+    errno = ENOMEM;
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return 0;
+  }
+  xd_block_set_state(header, XD_MEM_BLOCK_RELOCATABLE);
+  *(xd_handle *)header->data = handle;
 
-  // create the right fencepost
-  xd_mem_block_header *right_fencepost = xd_block_get_next(chunk_header);
-  xd_block_set_size_and_state(right_fencepost, 0, XD_MEM_BLOCK_FENCEPOST);
-  right_fencepost->prev_size = size;
+  xd_handle_entry *entry =
+      &((xd_handle_entry *)xd_handle_table.base)[handle - 1];
+  if (handle == xd_handle_free_head) {
+    xd_handle_free_head = entry->next_free;
+  }
+  else {
+    xd_handle_count++;
+  }
+  *entry = (xd_handle_entry){header, 0, 0};
 
-  return chunk_header;
-}  // xd_heap_chunk_create()
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return handle;
+}  // xd_halloc()
 
-/**
- * @brief Attempts to coalesce a new heap chunk with the chunk created before
- * it.
- *
- * @param chunk_header A pointer to the heap chunk (initialized as free block).
- *
- * @return `true` on success, `false` otherwise.
- */
-static bool xd_heap_chunk_try_coalesce(xd_mem_block_header *chunk_header) {
-  // this is the first allocated chunk, can't coalesce
-  if (xd_recent_chunk_right_fencepost == NULL) {
-    return false;
+void *xd_hlock(xd_handle handle) {
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  xd_handle_entry *entry = xd_handle_entry_get(handle);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return NULL;
   }
+  entry->lock_count++;
+  void *ptr = (void *)(entry->header->data + XD_HANDLE_HEADER_SIZE);
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return ptr;
+}  // xd_hlock()
 
-  xd_mem_block_header *left_fencepost = xd_block_get_prev(chunk_header);
-  xd_mem_block_header *prev_chunk_right_fencepost =
-      xd_block_get_prev(left_fencepost);
+void xd_hunlock(xd_handle handle) {
+  pthread_mutex_lock(&xd_main_heap.mutex);
+  xd_handle_entry *entry = xd_handle_entry_get(handle);
+  if (entry != NULL && entry->lock_count > 0) {
+    entry->lock_count--;
+  }
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+}  // xd_hunlock()
 
-  // the recent chunk is not adjacent to the new chunk, can't coalesce
-  if (prev_chunk_right_fencepost != xd_recent_chunk_right_fencepost) {
-    return false;
+void xd_hfree(xd_handle handle) {
+  if (handle == 0) {
+    return;
   }
 
-  size_t chunk_size = xd_block_get_size(chunk_header);
+  pthread_mutex_lock(&xd_main_heap.mutex);
 
-  // get the last block in the previous chunk
-  xd_mem_block_header *prev_chunk_last_block =
-      xd_block_get_prev(prev_chunk_right_fencepost);
+  // corrupted heap, function wont work
+  if (sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return;
+  }
 
-  if (xd_block_get_state(prev_chunk_last_block) == XD_MEM_BLOCK_UNALLOCATED) {
-    // last block is unallocated, coalesce with the block
-    // remove the fenceposts
-    chunk_header = prev_chunk_last_block;
-    chunk_size +=
-        xd_block_get_size(prev_chunk_last_block) + (3 * XD_BLOCK_HEADER_SIZE);
+  // double free is fatal abort
+  xd_handle_entry *entry = xd_handle_entry_get(handle);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    fprintf(stderr, "xd_hfree(): double free detected\n");
+    abort();
+  }
 
-    // remove the block from list to be re-inserted at the beginning
-    xd_free_list_remove(chunk_header);
+  xd_block_free(&xd_main_heap, entry->header);
+  *entry = (xd_handle_entry){NULL, 0, xd_handle_free_head};
+  xd_handle_free_head = handle;
+
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+}  // xd_hfree()
+
+size_t xd_heap_compact(size_t max_bytes) {
+  pthread_mutex_lock(&xd_main_heap.mutex);
+
+  // corrupted heap, function wont work
+  if (sbrk(0) != xd_heap_end_address) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return 0;
   }
-  else {
-    // last block is allocated, just remove the fenceposts
-    chunk_header = prev_chunk_right_fencepost;
-    chunk_size += 2 * XD_BLOCK_HEADER_SIZE;
 
-    chunk_header->prev_size = xd_block_get_size(prev_chunk_last_block);
+  // walk the heap from its start, every unlocked relocatable block after a
+  // free block is moved down and the free block continues after it
+  size_t moved = 0;
+  xd_mem_block_header *header = (xd_mem_block_header *)xd_heap_start_address;
+  while ((void *)header < xd_heap_end_address && moved < max_bytes) {
+    if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
+      xd_mem_block_header *next = xd_block_get_next(header);
+      if (xd_block_get_state(next) == XD_MEM_BLOCK_RELOCATABLE &&
+          xd_handle_entry_get(*(xd_handle *)next->data)->lock_count == 0) {
+        moved += xd_block_get_size(next);
+        header = xd_block_slide(header);
+        continue;
+      }
+    }
+    header = xd_block_get_next(header);
   }
 
-  // initialize the header after coalescing
-  xd_block_set_size_and_state(chunk_header, chunk_size,
-                              XD_MEM_BLOCK_UNALLOCATED);
+  xd_heap_trim();
 
-  // update the right fencepost meta data
-  xd_mem_block_header *right_fencepost = xd_block_get_next(chunk_header);
-  right_fencepost->prev_size = chunk_size;
-  xd_recent_chunk_right_fencepost = right_fencepost;
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return moved;
+}  // xd_heap_compact()
 
-  // insert the coalesced block into the free list
-  xd_free_list_insert(chunk_header);
+int xd_malloc_reserve_blocks(size_t size, size_t count) {
+  if (size == 0 || count == 0) {
+    return 0;
+  }
 
-  // colaescing succeeded
-  return true;
-}  // xd_heap_chunk_try_coalesce()
+  size = xd_block_adjust_size(size);
+  if ((SIZE_MAX - XD_BLOCK_HEADER_SIZE) / count < size + XD_BLOCK_HEADER_SIZE) {
+    errno = ENOMEM;
+    return -1;
+  }
 
-// ========================
-// non-static functions
-// ========================
+  // the blocks plus a remainder large enough to be a block
+  size_t total_size =
+      (count * (size + XD_BLOCK_HEADER_SIZE)) + XD_MIN_ALLOC_SIZE;
+
+  xd_soft_limit_check(total_size);
+  pthread_mutex_lock(&xd_main_heap.mutex);
 
-void *xd_malloc(size_t size) {
   // corrupted heap, function wont work
   if (sbrk(0) != xd_heap_end_address) {
-    return NULL;
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return -1;
   }
 
-  if (size == 0) {
-    return NULL;
+  xd_mem_block_header *block_header =
+      xd_free_list_find_or_drain(&xd_main_heap, total_size);
+  if (block_header == NULL) {
+    block_header = xd_heap_grow(&xd_main_heap, total_size);
+    if (block_header == NULL) {
+      errno = ENOMEM;
+      pthread_mutex_unlock(&xd_main_heap.mutex);
+      return -1;
+    }
   }
 
-  pthread_mutex_lock(&xd_malloc_mutex);
+  // carve the blocks from the start of the free block, the remainder is
+  // inserted into the free list by every split
+  xd_free_list_remove(&xd_main_heap, block_header);
+  xd_mem_block_header *remainder = block_header;
+  for (size_t i = 0; i < count; i++) {
+    xd_block_split(&xd_main_heap, remainder, size);
+    remainder = xd_block_get_next(remainder);
+    xd_free_list_remove(&xd_main_heap, remainder);
+  }
 
-  // make sure there is enough space for the next/prev pointers
-  // to be used when the block is freed
-  if (size < XD_MIN_ALLOC_SIZE) {
-    size = XD_MIN_ALLOC_SIZE;
+  // insert the remainder first and then the blocks in reverse address order,
+  // so the blocks end up in front of the remainder and in address order
+  xd_free_list_insert(&xd_main_heap, remainder);
+  xd_mem_block_header *header = xd_block_get_prev(remainder);
+  for (size_t i = 0; i < count; i++) {
+    xd_free_list_insert(&xd_main_heap, header);
+    header = xd_block_get_prev(header);
   }
 
-  // roundup to multiple of XD_ALIGNMENT
-  if (size % XD_ALIGNMENT != 0) {
-    size += XD_ALIGNMENT - (size % XD_ALIGNMENT);
+  // in real-time mode all the heap must stay locked into RAM
+  if (xd_rt_mode && xd_rt_lock_heap() != 0) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return -1;
   }
 
-  // find the first block in the free list with the required size
-  xd_mem_block_header *block_header = xd_free_list_find(size);
-  if (block_header == NULL) {
-    // no block with enough size was found, get more heap memory from the OS
-    xd_mem_block_header *chunk_header = xd_heap_chunk_create(size);
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return 0;
+}  // xd_malloc_reserve_blocks()
 
-    // out-of-memory failure
-    if (chunk_header == NULL) {
-      errno = ENOMEM;
-      pthread_mutex_unlock(&xd_malloc_mutex);
-      return NULL;
-    }
+int xd_malloc_rt_enable(size_t bytes) {
+  // corrupted heap, function wont work
+  if (xd_heap_is_corrupted()) {
+    return -1;
+  }
 
-    // coalesce or insert to free list
-    if (!xd_heap_chunk_try_coalesce(chunk_header)) {
-      xd_free_list_insert(chunk_header);
-      xd_recent_chunk_right_fencepost = xd_block_get_next(chunk_header);
-    }
+  if (xd_rt_mode) {
+    return xd_malloc_reserve(bytes, 0);
+  }
 
-    block_header = xd_free_list_find(size);
+#ifdef XD_USE_DEFERRED_FREES
+  // the bins link the free blocks through their data
+  errno = ENOTSUP;
+  return -1;
+#endif
+
+  // re-initialize the mutex with priority inheritance, so a low priority
+  // thread holding it is boosted instead of blocking a real-time thread
+  pthread_mutexattr_t mutex_attr;
+  pthread_mutexattr_init(&mutex_attr);
+  int error = pthread_mutexattr_setprotocol(&mutex_attr, PTHREAD_PRIO_INHERIT);
+  if (error == 0) {
+    pthread_mutex_destroy(&xd_main_heap.mutex);
+    error = pthread_mutex_init(&xd_main_heap.mutex, &mutex_attr);
+  }
+  pthread_mutexattr_destroy(&mutex_attr);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+
+  // grow the heap while growth is still allowed
+  if (xd_malloc_reserve(bytes, 0) != 0) {
+    return -1;
   }
 
-  // remove the block from the free list and get its size
-  xd_free_list_remove(block_header);
-  size_t block_size = xd_block_get_size(block_header);
+  pthread_mutex_lock(&xd_main_heap.mutex);
 
-  if (block_size - size >= sizeof(xd_mem_block_header)) {
-    // block size is enough to be split
-    xd_block_split(block_header, size);
+  // locking the pages also faults them in
+  if (xd_rt_lock_heap() != 0) {
+    pthread_mutex_unlock(&xd_main_heap.mutex);
+    return -1;
   }
 
-  xd_block_set_state(block_header, XD_MEM_BLOCK_ALLOCATED);
+  // move all the free blocks from the free list into the bins
+  xd_mem_block_header *header = xd_main_heap.free_list_head;
+  xd_main_heap.free_list_head = NULL;
+  xd_rt_mode = true;
+  while (header != NULL) {
+    xd_mem_block_header *next = header->next;
+    xd_rt_bin_insert(header);
+    header = next;
+  }
 
-  pthread_mutex_unlock(&xd_malloc_mutex);
-  return (void *)block_header->data;
-}  // xd_malloc()
+  pthread_mutex_unlock(&xd_main_heap.mutex);
+  return 0;
+}  // xd_malloc_rt_enable()
 
-void xd_free(void *ptr) {
-  // corrupted heap, function wont work
-  if (sbrk(0) != xd_heap_end_address) {
-    return;
+int xd_calloc_pool_start(void) {
+  pthread_mutex_lock(&xd_zero_pool_mutex);
+  if (xd_zero_pool_running) {
+    pthread_mutex_unlock(&xd_zero_pool_mutex);
+    return 0;
   }
 
-  if (ptr == NULL) {
-    return;
+  __atomic_store_n(&xd_zero_pool_running, true, __ATOMIC_RELEASE);
+  int error =
+      pthread_create(&xd_zero_pool_thread, NULL, xd_zero_pool_worker, NULL);
+  if (error != 0) {
+    __atomic_store_n(&xd_zero_pool_running, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&xd_zero_pool_mutex);
+    errno = error;
+    return -1;
   }
 
-  // fail if the address is outside the heap
-  if (ptr < xd_heap_start_address || ptr > xd_heap_end_address) {
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
+  return 0;
+}  // xd_calloc_pool_start()
+
+void xd_calloc_pool_stop(void) {
+  pthread_mutex_lock(&xd_zero_pool_mutex);
+  if (!xd_zero_pool_running) {
+    pthread_mutex_unlock(&xd_zero_pool_mutex);
     return;
   }
+  __atomic_store_n(&xd_zero_pool_running, false, __ATOMIC_RELEASE);
+  pthread_cond_signal(&xd_zero_pool_cond);
+  pthread_mutex_unlock(&xd_zero_pool_mutex);
 
-  pthread_mutex_lock(&xd_malloc_mutex);
-
-  xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
+  pthread_join(xd_zero_pool_thread, NULL);
 
-  // double free is fatal abort
-  if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
-    pthread_mutex_unlock(&xd_malloc_mutex);
-    fprintf(stderr, "xd_free(): double free detected\n");
-    abort();
+  // return the pooled blocks to the heap
+  for (size_t band = 0; band < XD_ZERO_POOL_BAND_COUNT; band++) {
+    while (xd_zero_pool[band].count > 0) {
+      xd_free(xd_zero_pool[band].blocks[--xd_zero_pool[band].count]);
+    }
   }
+}  // xd_calloc_pool_stop()
 
-  // get previous and next blocks
-  xd_mem_block_header *prev = xd_block_get_prev(header);
-  xd_mem_block_header *next = xd_block_get_next(header);
-  xd_mem_block_state prev_state = xd_block_get_state(prev);
-  xd_mem_block_state next_state = xd_block_get_state(next);
+xd_pheap *xd_pheap_open(const char *path, size_t size) {
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return NULL;
+  }
 
-  // coalesce with previous and/or next block if possible
-  if (prev_state == XD_MEM_BLOCK_UNALLOCATED &&
-      next_state == XD_MEM_BLOCK_UNALLOCATED) {
-    xd_block_coalesce_with_prev_and_next(header);
+  // only one process may use the heap at a time
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    int error = (errno == EWOULDBLOCK) ? EBUSY : errno;
+    close(fd);
+    errno = error;
+    return NULL;
   }
-  else if (prev_state == XD_MEM_BLOCK_UNALLOCATED) {
-    xd_block_coalesce_with_prev(header);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
   }
-  else if (next_state == XD_MEM_BLOCK_UNALLOCATED) {
-    xd_block_coalesce_with_next(header);
+
+  // a new file is sized and formatted, an existing one keeps its size
+  bool created = (st.st_size == 0);
+  void *hint = NULL;
+  if (created) {
+    size = xd_pheap_file_size(fd, size);
   }
   else {
-    xd_block_set_state(header, XD_MEM_BLOCK_UNALLOCATED);
-    xd_free_list_insert(header);
+    size = (size_t)st.st_size;
+    xd_pheap_file_header file;
+    if (pread(fd, &file, sizeof(file), 0) != (ssize_t)sizeof(file) ||
+        file.magic != XD_PHEAP_MAGIC || file.size != size) {
+      errno = EINVAL;
+      size = 0;
+    }
+    // map the file where it was mapped before when possible, so pointers
+    // stored in the blocks stay valid
+    hint = (void *)(uintptr_t)file.base;
+  }
+  if (size == 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
   }
 
-  pthread_mutex_unlock(&xd_malloc_mutex);
-}  // xd_free()
+  xd_pheap *pheap = xd_pheap_map(fd, size, hint, created, 0);
+  if (pheap != NULL) {
+    xd_pheap_file(pheap)->base = (uint64_t)(uintptr_t)pheap->base;
+  }
+  return pheap;
+}  // xd_pheap_open()
 
-void *xd_calloc(size_t n, size_t size) {
-  // corrupted heap, function wont work
-  if (sbrk(0) != xd_heap_end_address) {
+xd_pheap *xd_shm_heap_open(const char *name, size_t size, int flags) {
+  // anonymous heaps are shared with child processes only
+  int fd;
+  bool created = true;
+  if (name == NULL) {
+    fd = memfd_create("xd_shm_heap", MFD_CLOEXEC);
+  }
+  else {
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST) {
+      fd = shm_open(name, O_RDWR, 0);
+      created = false;
+    }
+  }
+  if (fd == -1) {
     return NULL;
   }
 
-  if (n == 0 || size == 0) {
+  if (created) {
+    size = xd_pheap_file_size(fd, size);
+  }
+  else {
+    // wait for the process that created the heap to format it
+    size = 0;
+    xd_pheap_file_header file = {0};
+    for (int i = 0; i < XD_SHM_HEAP_OPEN_RETRIES; i++) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size != 0 &&
+          pread(fd, &file, sizeof(file), 0) == (ssize_t)sizeof(file) &&
+          file.magic != 0) {
+        size = (size_t)st.st_size;
+        break;
+      }
+      usleep(1000);
+    }
+    if (file.magic != XD_PHEAP_MAGIC || file.size != size) {
+      errno = EINVAL;
+      size = 0;
+    }
+  }
+  if (size == 0) {
+    int error = errno;
+    if (created && name != NULL) {
+      shm_unlink(name);
+    }
+    close(fd);
+    errno = error;
     return NULL;
   }
-  if (SIZE_MAX / n < size) {
+
+  xd_pheap *pheap = xd_pheap_map(fd, size, NULL, created,
+                                 flags | XD_PHEAP_SHARED);
+  if (pheap == NULL && created && name != NULL) {
+    shm_unlink(name);
+  }
+  return pheap;
+}  // xd_shm_heap_open()
+
+int xd_pheap_close(xd_pheap *pheap) {
+  if (pheap == NULL) {
+    return 0;
+  }
+
+  // return the blocks cached by this process to the heap
+  if (pheap->flags & XD_SHM_HEAP_CACHE) {
+    xd_pheap_cache_reset(pheap);
+    for (size_t i = 0; i < XD_SHM_HEAP_CACHE_CLASSES; i++) {
+      while (pheap->cache[i] != 0) {
+        xd_mem_block_header *header = xd_pheap_block_at(pheap, pheap->cache[i]);
+        pheap->cache[i] = xd_pheap_block_links(header)[0];
+        xd_pheap_block_release(pheap, header);
+      }
+    }
+  }
+
+  int ret = 0;
+  int error = errno;
+  if (!(pheap->flags & XD_PHEAP_SHARED)) {
+    ret = msync(pheap->base, pheap->size, MS_SYNC);
+    error = errno;
+  }
+  munmap(pheap->base, pheap->size);
+  close(pheap->fd);
+  pthread_mutex_destroy(&pheap->mutex);
+  xd_free(pheap);
+  errno = error;
+  return ret;
+}  // xd_pheap_close()
+
+void *xd_pheap_malloc(xd_pheap *pheap, size_t size) {
+  if (size == 0) {
     return NULL;
   }
-  size_t total_size = n * size;
-  void *ptr = xd_malloc(total_size);
-  if (ptr == NULL) {
+  if (size > pheap->size) {
+    errno = ENOMEM;
     return NULL;
   }
-  memset(ptr, 0, total_size);
-  return ptr;
-}  // xd_calloc()
+  size = xd_block_adjust_size(size);
 
-void *xd_realloc(void *ptr, size_t size) {
-  // corrupted heap, function wont work
-  if (sbrk(0) != xd_heap_end_address) {
+  // small blocks freed by this process are reused without the shared lock
+  if ((pheap->flags & XD_SHM_HEAP_CACHE) &&
+      size <= XD_SHM_HEAP_CACHE_MAX_SIZE) {
+    size_t index = (size - 1) / XD_SHM_HEAP_CACHE_GRANULARITY;
+    pthread_mutex_lock(&pheap->mutex);
+    xd_pheap_cache_reset(pheap);
+    xd_mem_block_header *header = xd_pheap_block_at(pheap, pheap->cache[index]);
+    if (header != NULL) {
+      pheap->cache[index] = xd_pheap_block_links(header)[0];
+      pheap->cache_count[index]--;
+    }
+    pthread_mutex_unlock(&pheap->mutex);
+    if (header != NULL) {
+      return (void *)header->data;
+    }
+  }
+
+  int error = xd_pheap_lock(pheap);
+  if (error != 0) {
+    errno = error;
     return NULL;
   }
 
-  if (size == 0) {
-    xd_free(ptr);
+  // first fit, the file can't grow
+  xd_mem_block_header *header =
+      xd_pheap_block_at(pheap, xd_pheap_file(pheap)->free_list);
+  while (header != NULL && xd_block_get_size(header) < size) {
+    header = xd_pheap_block_at(pheap, xd_pheap_block_links(header)[0]);
+  }
+  if (header == NULL) {
+    xd_pheap_unlock(pheap);
+    errno = ENOMEM;
     return NULL;
   }
+  xd_pheap_free_list_remove(pheap, header);
+
+  // split the rest into a new free block if it is large enough, the rest is
+  // formatted before the block shrinks so the blocks stay walkable (see
+  // `xd_pheap_free_list_rebuild()`)
+  size_t block_size = xd_block_get_size(header);
+  if (block_size - size >= sizeof(xd_mem_block_header)) {
+    xd_mem_block_header *rest = (xd_mem_block_header *)((xd_byte *)header +
+                                                        XD_BLOCK_HEADER_SIZE +
+                                                        size);
+    size_t rest_size = block_size - size - XD_BLOCK_HEADER_SIZE;
+    xd_block_set_size_and_state(rest, rest_size, XD_MEM_BLOCK_UNALLOCATED);
+    rest->prev_size = size;
+    xd_block_get_next(rest)->prev_size = rest_size;
+    xd_block_set_size(header, size);
+    xd_pheap_free_list_insert(pheap, rest);
+  }
+  xd_block_set_state(header, XD_MEM_BLOCK_ALLOCATED);
+
+  xd_pheap_unlock(pheap);
+  return (void *)header->data;
+}  // xd_pheap_malloc()
+
+void xd_pheap_free(xd_pheap *pheap, void *ptr) {
   if (ptr == NULL) {
-    return xd_malloc(size);
+    return;
   }
 
+  // keep small blocks in the cache of this process, the state is only checked
+  // under a lock since another process may be coalescing the block
   xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
-  size_t old_size = xd_block_get_size(header);
+  if (pheap->flags & XD_SHM_HEAP_CACHE) {
+    pthread_mutex_lock(&pheap->mutex);
+    bool cached = false;
+    size_t size = xd_block_get_size(header);
+    if (xd_block_get_state(header) == XD_MEM_BLOCK_ALLOCATED &&
+        size >= XD_SHM_HEAP_CACHE_GRANULARITY &&
+        size < XD_SHM_HEAP_CACHE_MAX_SIZE + XD_SHM_HEAP_CACHE_GRANULARITY) {
+      size_t index = (size / XD_SHM_HEAP_CACHE_GRANULARITY) - 1;
+      xd_pheap_cache_reset(pheap);
+      cached = (pheap->cache_count[index] < XD_SHM_HEAP_CACHE_COUNT);
+      if (cached) {
+        xd_pheap_block_links(header)[0] = pheap->cache[index];
+        pheap->cache[index] = xd_pheap_block_offset(pheap, header);
+        pheap->cache_count[index]++;
+      }
+    }
+    pthread_mutex_unlock(&pheap->mutex);
+    if (cached) {
+      return;
+    }
+  }
 
-  // TODO: Optimization
+  // the double free check is done under the lock of the heap
+  xd_pheap_block_release(pheap, header);
+}  // xd_pheap_free()
 
-  // allocate-copy-free
-  void *new_ptr = xd_malloc(size);
-  if (new_ptr == NULL) {
+void *xd_pheap_root(xd_pheap *pheap) {
+  int error = xd_pheap_lock(pheap);
+  if (error != 0) {
+    errno = error;
     return NULL;
   }
-  memcpy(new_ptr, ptr, old_size);
-  xd_free(ptr);
-  return new_ptr;
-}  // xd_realloc()
+  size_t root = xd_pheap_file(pheap)->root;
+  xd_pheap_unlock(pheap);
+  return (root == 0) ? NULL : (void *)(pheap->base + root);
+}  // xd_pheap_root()
+
+void xd_pheap_set_root(xd_pheap *pheap, void *ptr) {
+  if (xd_pheap_lock(pheap) != 0) {
+    return;
+  }
+  xd_pheap_file(pheap)->root = (ptr == NULL) ? 0 : xd_pheap_offset(pheap, ptr);
+  xd_pheap_unlock(pheap);
+}  // xd_pheap_set_root()
+
+size_t xd_pheap_offset(const xd_pheap *pheap, const void *ptr) {
+  return (size_t)((const xd_byte *)ptr - pheap->base);
+}  // xd_pheap_offset()
+
+void *xd_pheap_pointer(const xd_pheap *pheap, size_t offset) {
+  return (void *)(pheap->base + offset);
+}  // xd_pheap_pointer()
 
 // ========================
 // Debug/Test Functions
@@ -792,12 +7140,34 @@ void xd_free_list_headers_dump(FILE *out) {
   fprintf(out, "-----------------------\n");
   fprintf(out, "FREE LIST HEADERS DUMP\n");
   fprintf(out, "-----------------------\n");
-  xd_mem_block_header *header = xd_free_list_head;
+#ifdef XD_USE_DEFERRED_FREES
+  // the free blocks are dumped by size class, each in address order
+  for (size_t class = 0; class < XD_RT_BIN_COUNT; class++) {
+    size_t index = xd_free_index_next(class, 0, 0);
+    while (index != SIZE_MAX) {
+      xd_block_header_dump(out, xd_block_from_granule_index(index));
+      index = xd_free_index_next(class, 0, index + 1);
+      fprintf(out, "-----------------------\n");
+    }
+  }
+#else
+  xd_mem_block_header *header = xd_main_heap.free_list_head;
   while (header != NULL) {
     xd_block_header_dump(out, header);
     header = header->next;
     fprintf(out, "-----------------------\n");
   }
+#endif
+
+  // in real-time mode dump the bins from the smallest to the largest
+  for (size_t i = 0; xd_rt_mode && i < XD_RT_BIN_COUNT; i++) {
+    xd_mem_block_header *bin_header = xd_rt_bins[i];
+    while (bin_header != NULL) {
+      xd_block_header_dump(out, bin_header);
+      bin_header = bin_header->next;
+      fprintf(out, "-----------------------\n");
+    }
+  }
 }  // xd_free_list_headers_dump()
 
 /**
@@ -832,11 +7202,21 @@ static inline void xd_block_header_dump(FILE *out,
       fprintf(out, "[UNALLOCATED]\n");
       break;
     case XD_MEM_BLOCK_ALLOCATED:
+#ifdef XD_USE_DEFERRED_FREES
+      if (xd_side_bitmap_test(&xd_pending_free_bitmap,
+                              xd_block_granule_index(header))) {
+        fprintf(out, "[FREE PENDING]\n");
+        break;
+      }
+#endif
       fprintf(out, "[ALLOCATED]\n");
       break;
     case XD_MEM_BLOCK_FENCEPOST:
       fprintf(out, "[FENCEPOST]\n");
       break;
+    case XD_MEM_BLOCK_RELOCATABLE:
+      fprintf(out, "[RELOCATABLE]\n");
+      break;
     default:
       fprintf(out, "[INVALID BLOCK]\n");
       break;
@@ -846,6 +7226,8 @@ static inline void xd_block_header_dump(FILE *out,
   fprintf(out, "  size:      %zu\n", xd_block_get_size(header));
   fprintf(out, "  prev_size: %zu\n", header->prev_size);
 
+#ifndef XD_USE_DEFERRED_FREES
+  // free blocks carry no links when they are tracked by the free index
   if (xd_block_get_state(header) == XD_MEM_BLOCK_UNALLOCATED) {
     if (header->prev == NULL) {
       fprintf(out, "  prev:   NULL\n");
@@ -862,4 +7244,5 @@ static inline void xd_block_header_dump(FILE *out,
               xd_block_header_relative_address(header->next));
     }
   }
+#endif
 }  // xd_block_header_dump()
@@ -52,6 +52,12 @@
  */
 #define XD_STATE_MASK (0b111)
 
+/**
+ * @brief Flag stored in the state bits of an allocated block that has a record
+ * in a side table.
+ */
+#define XD_TRACKED_FLAG (0b100)
+
 // ========================
 // Types
 // ========================
@@ -67,7 +73,8 @@ typedef char xd_byte;
 typedef enum xd_mem_block_state {
   XD_MEM_BLOCK_UNALLOCATED = 0b000,  // Unallocated memory block
   XD_MEM_BLOCK_ALLOCATED = 0b001,    // Allocated memory block
-  XD_MEM_BLOCK_FENCEPOST = 0b010     // Separator between two OS chunks
+  XD_MEM_BLOCK_FENCEPOST = 0b010,    // Separator between two OS chunks
+  XD_MEM_BLOCK_RELOCATABLE = 0b011   // Allocated block owned by a handle
 } xd_mem_block_state;
 
 /**
@@ -119,7 +126,7 @@ static inline xd_mem_block_header *xd_block_get_header_from_data(void *ptr) {
  */
 static inline xd_mem_block_state xd_block_get_state(
     const xd_mem_block_header *header) {
-  return (xd_mem_block_state)(header->size & XD_STATE_MASK);
+  return (xd_mem_block_state)(header->size & XD_STATE_MASK & ~XD_TRACKED_FLAG);
 }  // xd_block_get_state()
 
 /**
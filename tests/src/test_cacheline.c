@@ -0,0 +1,115 @@
+/*
+ * ==============================================================================
+ * File: test_cacheline.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (64)
+#define THREAD_COUNT (4)
+
+static xd_byte *thread_ptrs[THREAD_COUNT][PTR_COUNT];
+
+/**
+ * @brief Asserts that the passed block starts on a cache line and that its
+ * cache lines are not shared with any other block's data.
+ */
+static void assert_cacheline_isolated(xd_byte *ptr) {
+  assert((uintptr_t)ptr % XD_CACHELINE_SIZE == 0);
+  xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
+  assert(xd_block_get_size(header) % XD_CACHELINE_SIZE == 0);
+
+  // the next block's header starts on the line following the data
+  assert((uintptr_t)xd_block_get_next(header) % XD_CACHELINE_SIZE == 0);
+
+  // only free blocks share the line holding the header, so no other block's
+  // data is written next to it
+  uintptr_t line = (uintptr_t)header & ~(uintptr_t)(XD_CACHELINE_SIZE - 1);
+  xd_mem_block_header *prev = xd_block_get_prev(header);
+  while (xd_block_get_state(prev) != XD_MEM_BLOCK_FENCEPOST &&
+         (uintptr_t)prev->data + xd_block_get_size(prev) > line) {
+    assert(xd_block_get_state(prev) == XD_MEM_BLOCK_UNALLOCATED);
+    prev = xd_block_get_prev(prev);
+  }
+}  // assert_cacheline_isolated()
+
+/**
+ * @brief Allocates small blocks under the cache line policy.
+ */
+static void *thread_routine(void *arg) {
+  xd_byte **ptrs = (xd_byte **)arg;
+  assert(xd_malloc_thread_policy(XD_THREAD_POLICY_CACHELINE) ==
+         XD_THREAD_POLICY_SHARED);
+  for (int i = 0; i < PTR_COUNT; i++) {
+    ptrs[i] = xd_malloc(sizeof(long));
+    assert(ptrs[i] != NULL);
+  }
+  return NULL;
+}  // thread_routine()
+
+/**
+ * @brief Used for testing cache line isolated allocations:
+ * - `xd_malloc_cacheline()` returns blocks that start on a cache line and span
+ *   whole cache lines.
+ * - Under `XD_THREAD_POLICY_CACHELINE`, small blocks allocated concurrently by
+ *   different threads never share a cache line.
+ * - The thread policy is per thread and invalid policies are rejected.
+ */
+int main() {
+  xd_byte *ptrs[PTR_COUNT];
+
+  // mix shared and cache line blocks
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(xd_malloc((size_t)(i + 1)));
+    ptrs[i] = xd_malloc_cacheline((size_t)((i * 13) + 1));
+    assert(ptrs[i] != NULL);
+    assert_cacheline_isolated(ptrs[i]);
+  }
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(ptrs[i]);
+  }
+
+  // allocate concurrently under the cache line policy
+  pthread_t threads[THREAD_COUNT];
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    assert(pthread_create(&threads[i], NULL, thread_routine, thread_ptrs[i]) ==
+           0);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    assert(pthread_join(threads[i], NULL) == 0);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    for (int j = 0; j < PTR_COUNT; j++) {
+      assert_cacheline_isolated(thread_ptrs[i][j]);
+      xd_free(thread_ptrs[i][j]);
+    }
+  }
+
+  // the main thread's policy is unchanged
+  assert(xd_malloc_thread_policy(XD_THREAD_POLICY_SHARED) ==
+         XD_THREAD_POLICY_SHARED);
+  errno = 0;
+  assert(xd_malloc_thread_policy(42) == -1);
+  assert(errno == EINVAL);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
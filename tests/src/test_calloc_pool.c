@@ -0,0 +1,59 @@
+/*
+ * ==============================================================================
+ * File: test_calloc_pool.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+
+#define ROUND_COUNT (200)
+
+/**
+ * @brief Used for testing `xd_calloc()` with the pre-zeroed pool running:
+ * - Every block returned by `xd_calloc()` is zeroed, whether it is taken from
+ *   the pool or zeroed synchronously.
+ * - Blocks are dirtied before being freed, so a block reused without zeroing
+ *   would be detected.
+ */
+int main() {
+  size_t sizes[] = {100, 4096, 5000, 20000, 70000, 300000, 1048576, 2000000};
+  size_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+  assert(xd_calloc_pool_start() == 0);
+  assert(xd_calloc_pool_start() == 0);
+
+  // give the pool thread time to fill the pool
+  usleep(100000);
+
+  for (size_t round = 0; round < ROUND_COUNT; round++) {
+    size_t size = sizes[round % size_count];
+    unsigned char *ptr = xd_calloc(1, size);
+    assert(ptr != NULL);
+    for (size_t i = 0; i < size; i++) {
+      assert(ptr[i] == 0);
+    }
+    memset(ptr, 0xAB, size);
+    xd_free(ptr);
+  }
+
+  xd_calloc_pool_stop();
+  xd_calloc_pool_stop();
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,148 @@
+/*
+ * ==============================================================================
+ * File: test_current_heap.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (64)
+#define PTR_SIZE (256)
+
+static void *heap_start;
+static void *heap_end;
+
+/**
+ * @brief Checks whether the passed block is outside the heap used by
+ * `xd_malloc()`.
+ */
+static int is_outside_heap(void *ptr) {
+  return ptr < heap_start || ptr >= heap_end;
+}  // is_outside_heap()
+
+/**
+ * @brief Checks whether the page containing the passed address is mapped.
+ */
+static int is_mapped(void *ptr) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  void *page = (void *)((uintptr_t)ptr & ~(uintptr_t)(page_size - 1));
+  return msync(page, page_size, MS_ASYNC) == 0;
+}  // is_mapped()
+
+/**
+ * @brief Frees the passed blocks from another thread.
+ */
+static void *free_thread(void *arg) {
+  void **ptrs = (void **)arg;
+  for (int i = 0; i < PTR_COUNT; i += 2) {
+    xd_free(ptrs[i]);
+  }
+  return NULL;
+}  // free_thread()
+
+/**
+ * @brief Used for testing `xd_heap_create()`, `xd_heap_destroy()`,
+ * `xd_heap_push_current()` and `xd_heap_pop_current()`:
+ * - While a heap is current, `xd_malloc()`, `xd_calloc()` and `xd_realloc()`
+ *   place blocks in it, and heaps nest.
+ * - Blocks of a heap can be freed from another thread, and their space is
+ *   reused by the heap.
+ * - After popping all heaps, blocks are placed in the default heap again.
+ * - Destroying a heap unmaps all its blocks.
+ * - Pushing `NULL` or too many heaps fails.
+ */
+int main() {
+  void *ptrs[PTR_COUNT];
+
+  heap_start = sbrk(0);
+  xd_free(xd_malloc(1));
+  heap_end = sbrk(0);
+
+  xd_heap *task_heap = xd_heap_create();
+  xd_heap *nested_heap = xd_heap_create();
+  assert(task_heap != NULL && nested_heap != NULL);
+
+  assert(xd_heap_push_current(task_heap) == 0);
+  for (int i = 0; i < PTR_COUNT; i++) {
+    ptrs[i] = (i % 2 == 0) ? xd_malloc(PTR_SIZE) : xd_calloc(1, PTR_SIZE);
+    assert(ptrs[i] != NULL);
+    assert(is_outside_heap(ptrs[i]));
+    memset(ptrs[i], i, PTR_SIZE);
+  }
+
+  // nested heap
+  assert(xd_heap_push_current(nested_heap) == 0);
+  void *nested_ptr = xd_malloc(PTR_SIZE);
+  assert(is_outside_heap(nested_ptr));
+  xd_heap_pop_current();
+
+  // cross-thread frees, the space is reused by the task heap
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, free_thread, ptrs) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+  void *ptr = xd_malloc(PTR_SIZE);
+  int reused = 0;
+  for (int i = 0; i < PTR_COUNT; i += 2) {
+    reused = reused || (ptr == ptrs[i]);
+  }
+  assert(reused);
+  xd_free(ptr);
+
+  // realloc keeps a block in its heap
+  ptrs[1] = xd_realloc(ptrs[1], 4 * PTR_SIZE);
+  assert(is_outside_heap(ptrs[1]));
+  for (int j = 0; j < PTR_SIZE; j++) {
+    assert(((xd_byte *)ptrs[1])[j] == 1);
+  }
+  xd_heap_pop_current();
+
+  ptr = xd_malloc(PTR_SIZE);
+  assert(!is_outside_heap(ptr));
+  xd_free(ptr);
+
+  // destroying a heap unmaps its blocks
+  xd_heap_destroy(task_heap);
+  for (int i = 1; i < PTR_COUNT; i += 2) {
+    assert(!is_mapped(ptrs[i]));
+  }
+  assert(is_mapped(nested_ptr));
+  xd_heap_destroy(nested_heap);
+  assert(!is_mapped(nested_ptr));
+
+  // invalid pushes
+  errno = 0;
+  assert(xd_heap_push_current(NULL) == -1 && errno == EINVAL);
+  xd_heap *heap = xd_heap_create();
+  int pushed = 0;
+  while (xd_heap_push_current(heap) == 0) {
+    pushed++;
+  }
+  assert(errno == EOVERFLOW && pushed == 16);
+  for (int i = 0; i < pushed; i++) {
+    xd_heap_pop_current();
+  }
+  xd_heap_destroy(heap);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
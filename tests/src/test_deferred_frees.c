@@ -0,0 +1,127 @@
+/*
+ * ==============================================================================
+ * File: test_deferred_frees.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (32)
+#define PTR_SIZE (64)
+#define SMALL_SIZE (48)
+#define MEDIUM_SIZE (504)
+#define LARGE_SIZE (4000)
+#define DRAIN_SIZE (1024 * 1024)
+
+static xd_byte heap_copy[PTR_COUNT * (PTR_SIZE + 16)];
+
+/**
+ * @brief Used for testing `xd_free()` in the deferred frees mode:
+ * - Freeing blocks (in the parent or in a forked child) doesn't write to the
+ *   heap pages holding the blocks, so they are not copied on write.
+ * - The pending frees are applied once an allocation needs them, coalescing
+ *   the freed blocks without growing the heap.
+ * - Free blocks are tracked out of line, so the data of the freed blocks is
+ *   never overwritten by free list links.
+ * - Free blocks are found by size class instead of in address order.
+ *
+ * @note This program must be compiled with `-DXD_USE_DEFERRED_FREES` in order
+ * for the test to work correctly.
+ */
+int main() {
+  xd_byte *ptrs[PTR_COUNT];
+  for (int i = 0; i < PTR_COUNT; i++) {
+    ptrs[i] = xd_malloc(PTR_SIZE);
+    memset(ptrs[i], i, PTR_SIZE);
+  }
+  void *heap_end = sbrk(0);
+
+  xd_byte *range_start = (xd_byte *)xd_block_get_header_from_data(ptrs[0]);
+  size_t range_size = (size_t)(ptrs[PTR_COUNT - 1] + PTR_SIZE - range_start);
+  assert(range_size <= sizeof(heap_copy));
+  memcpy(heap_copy, range_start, range_size);
+
+  // free the odd blocks in the parent
+  for (int i = 1; i < PTR_COUNT; i += 2) {
+    xd_free(ptrs[i]);
+  }
+  assert(memcmp(heap_copy, range_start, range_size) == 0);
+
+  // free the even blocks in a child
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    for (int i = 0; i < PTR_COUNT; i += 2) {
+      xd_free(ptrs[i]);
+    }
+    exit(memcmp(heap_copy, range_start, range_size) == 0 ? EXIT_SUCCESS
+                                                          : EXIT_FAILURE);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+  // free the even blocks in the parent, the block only fits after all the
+  // pending frees are applied and coalesced
+  for (int i = 0; i < PTR_COUNT; i += 2) {
+    xd_free(ptrs[i]);
+  }
+  void *ptr = xd_malloc(PTR_COUNT * PTR_SIZE);
+  assert(ptr == ptrs[0]);
+  assert(sbrk(0) == heap_end);
+  // the blocks covered by the new block (the rest is split off)
+  for (int i = 0; ptrs[i] + PTR_SIZE <= (xd_byte *)ptr + (PTR_COUNT * PTR_SIZE);
+       i++) {
+    for (int j = 0; j < PTR_SIZE; j++) {
+      assert(ptrs[i][j] == (xd_byte)i);
+    }
+  }
+
+  // free blocks of different size classes, kept apart by allocated guards,
+  // the largest one first in address order
+  xd_byte *large = xd_malloc(LARGE_SIZE);
+  void *guards[3];
+  guards[0] = xd_malloc(PTR_SIZE);
+  xd_byte *medium = xd_malloc(MEDIUM_SIZE);
+  guards[1] = xd_malloc(PTR_SIZE);
+  xd_byte *small = xd_malloc(SMALL_SIZE);
+  guards[2] = xd_malloc(PTR_SIZE);
+  xd_free(large);
+  xd_free(medium);
+  xd_free(small);
+  // misses, so the pending frees are applied
+  void *drain = xd_malloc(DRAIN_SIZE);
+
+  // a request is served from its own size class, or else from the smallest
+  // class above it, not from the first free block in address order
+  assert(xd_malloc(SMALL_SIZE - 8) == small);
+  assert(xd_malloc(SMALL_SIZE + 8) == medium);
+  // the rest of the split block moved to a smaller class
+  xd_byte *rest = xd_malloc(MEDIUM_SIZE / 2);
+  assert(rest > medium && rest < medium + MEDIUM_SIZE);
+  assert(xd_malloc(LARGE_SIZE / 2 + 8) == large);
+  for (int i = 0; i < 3; i++) {
+    xd_free(guards[i]);
+  }
+  xd_free(drain);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,138 @@
+/*
+ * ==============================================================================
+ * File: test_emergency_reserve.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define RESERVE_SIZE (4 * 1024 * 1024)
+#define BLOCK_SIZE (1536 * 1024)
+
+/**
+ * @brief The calls of the reserve hook.
+ */
+typedef struct hook_calls {
+  size_t count;  // The number of times the hook was called
+  size_t size;   // The size passed to the last call
+} hook_calls;
+
+/**
+ * @brief Reserve hook, records the call and allocates like a logger would.
+ */
+static void on_reserve(size_t size, void *arg) {
+  hook_calls *calls = (hook_calls *)arg;
+  calls->count++;
+  calls->size = size;
+  char *message = xd_malloc(64);
+  assert(message != NULL);
+  strcpy(message, "entered reserve mode");
+  xd_free(message);
+}  // on_reserve()
+
+/**
+ * @brief Returns the size of the data segment of the process (in bytes).
+ */
+static size_t data_size() {
+  FILE *status = fopen("/proc/self/status", "r");
+  assert(status != NULL);
+  char line[256];
+  size_t size = 0;
+  while (fgets(line, sizeof(line), status) != NULL) {
+    if (sscanf(line, "VmData: %zu kB", &size) == 1) {
+      break;
+    }
+  }
+  fclose(status);
+  assert(size > 0);
+  return size * 1024;
+}  // data_size()
+
+/**
+ * @brief Used for testing `xd_malloc_emergency_reserve()`,
+ * `xd_malloc_set_reserve_hook()` and `xd_malloc_in_reserve_mode()`:
+ * - The reserve is not used while the heap can grow.
+ * - Once the heap fails to grow, allocations are served by the reserve and the
+ *   hook is called once, when entering reserve mode.
+ * - Allocations fail with `ENOMEM` once the reserve is exhausted.
+ * - Reserve mode ends when the blocks of the reserve are freed.
+ * - Allocations failing on a corrupted heap don't use the reserve.
+ */
+int main() {
+  static hook_calls calls;
+
+  assert(xd_malloc_emergency_reserve(RESERVE_SIZE) == 0);
+  xd_malloc_set_reserve_hook(on_reserve, &calls);
+
+  // the heap can grow, the reserve is not used
+  void *block = xd_malloc(BLOCK_SIZE / 4);
+  assert(block != NULL);
+  assert(!xd_malloc_in_reserve_mode() && calls.count == 0);
+  xd_free(block);
+
+  // the heap can't grow anymore
+  struct rlimit old_limit;
+  assert(getrlimit(RLIMIT_DATA, &old_limit) == 0);
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = data_size() + (BLOCK_SIZE / 4);
+  assert(setrlimit(RLIMIT_DATA, &limit) == 0);
+
+  // the reserve serves the allocations that failed
+  void *blocks[2];
+  for (size_t i = 0; i < 2; i++) {
+    blocks[i] = xd_malloc(BLOCK_SIZE);
+    assert(blocks[i] != NULL);
+    memset(blocks[i], 0xAB, BLOCK_SIZE);
+    assert(xd_malloc_in_reserve_mode());
+  }
+  assert(calls.count == 1 && calls.size == BLOCK_SIZE);
+
+  // the reserve is exhausted
+  errno = 0;
+  assert(xd_malloc(BLOCK_SIZE) == NULL && errno == ENOMEM);
+
+  // blocks of the reserve are moved out of it when the heap can grow again
+  xd_free(blocks[0]);
+  assert(xd_malloc_in_reserve_mode());
+  assert(setrlimit(RLIMIT_DATA, &old_limit) == 0);
+  blocks[1] = xd_realloc(blocks[1], BLOCK_SIZE);
+  assert(blocks[1] != NULL && ((unsigned char *)blocks[1])[0] == 0xAB);
+  assert(!xd_malloc_in_reserve_mode());
+  xd_free(blocks[1]);
+
+  // the reserve can be used again and the hook is called again
+  limit.rlim_cur = data_size() + (BLOCK_SIZE / 4);
+  assert(setrlimit(RLIMIT_DATA, &limit) == 0);
+  block = xd_calloc(1, 2 * BLOCK_SIZE);
+  assert(block != NULL && xd_malloc_in_reserve_mode() && calls.count == 2);
+  xd_free(block);
+  assert(!xd_malloc_in_reserve_mode());
+  assert(setrlimit(RLIMIT_DATA, &old_limit) == 0);
+
+  // the heap break was moved outside the allocator
+  assert(sbrk(4096) != (void *)-1);
+  assert(xd_malloc(64) == NULL);
+  assert(!xd_malloc_in_reserve_mode() && calls.count == 2);
+  assert(sbrk(-4096) != (void *)-1);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,198 @@
+/*
+ * ==============================================================================
+ * File: test_fork.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (16)
+#define PTR_SIZE (200)
+#define SHAREABLE_SIZE (4096)
+#define PRESSURE_FORK_COUNT (200)
+
+/**
+ * @brief The number of seconds a child may run before it is considered hung.
+ */
+#define CHILD_TIMEOUT (10)
+
+/**
+ * @brief Forks a child that runs `child_main()` and asserts it exits
+ * successfully, a hung child is killed after `CHILD_TIMEOUT` seconds.
+ */
+static void fork_and_wait(void (*child_main)(void **), void **pointers) {
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (pid == 0) {
+    alarm(CHILD_TIMEOUT);
+    child_main(pointers);
+    _exit(EXIT_SUCCESS);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+}  // fork_and_wait()
+
+/**
+ * @brief Frees the inherited hinted blocks and allocates new ones, which looks
+ * up and updates the chunk registry in the child.
+ */
+static void hint_child(void **pointers) {
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    xd_free(pointers[i]);
+  }
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    pointers[i] = xd_malloc_hint(PTR_SIZE * 1024, XD_HINT_LONG);
+    assert(pointers[i] != NULL);
+    memset(pointers[i], 0xAB, PTR_SIZE * 1024);
+  }
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    xd_free(pointers[i]);
+  }
+}  // hint_child()
+
+/**
+ * @brief The descriptor and offset of the shareable block of the parent.
+ */
+static int shareable_fd;
+static size_t shareable_offset;
+
+/**
+ * @brief Checks that the inherited shareable block isn't mapped, that it can
+ * be mapped through its descriptor, and that new shareable blocks don't reuse
+ * the parent's memfd.
+ */
+static void shareable_child(void **pointers) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  void *page = (void *)((uintptr_t)pointers[0] & ~(page_size - 1));
+  assert(msync(page, page_size, MS_ASYNC) == -1 && errno == ENOMEM);
+
+  size_t length = shareable_offset + SHAREABLE_SIZE;
+  unsigned char *mapping =
+      mmap(NULL, length, PROT_READ, MAP_SHARED, shareable_fd, 0);
+  assert(mapping != MAP_FAILED);
+  assert(mapping[shareable_offset + SHAREABLE_SIZE - 1] == 0xCD);
+  munmap(mapping, length);
+
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    int fd;
+    size_t offset;
+    pointers[i] = xd_malloc_shareable(SHAREABLE_SIZE, &fd, &offset);
+    assert(pointers[i] != NULL);
+    assert(fd != shareable_fd);
+    memset(pointers[i], 0xEF, SHAREABLE_SIZE);
+  }
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    xd_free(pointers[i]);
+  }
+}  // shareable_child()
+
+/**
+ * @brief A memory pressure callback that sheds nothing.
+ */
+static void pressure_callback(size_t bytes, void *arg) {
+  (void)bytes;
+  (void)arg;
+}  // pressure_callback()
+
+/**
+ * @brief Whether `pressure_thread()` should stop.
+ */
+static bool pressure_stop = false;
+
+/**
+ * @brief Registers and unregisters a pressure callback until stopped, so
+ * forks happen while the callbacks are being changed.
+ */
+static void *pressure_thread(void *arg) {
+  (void)arg;
+  while (!__atomic_load_n(&pressure_stop, __ATOMIC_RELAXED)) {
+    assert(xd_malloc_pressure_callback_add(pressure_callback, NULL) == 0);
+    assert(xd_malloc_pressure_callback_remove(pressure_callback, NULL) == 0);
+  }
+  return NULL;
+}  // pressure_thread()
+
+/**
+ * @brief Changes the pressure callbacks, which must not be left locked by the
+ * thread of the parent.
+ */
+static void pressure_child(void **pointers) {
+  (void)pointers;
+  int arg;
+  assert(xd_malloc_pressure_callback_add(pressure_callback, &arg) == 0);
+  assert(xd_malloc_pressure_callback_remove(pressure_callback, &arg) == 0);
+}  // pressure_child()
+
+/**
+ * @brief Used for testing the allocator across `fork()`:
+ * - A child can free the hinted blocks it inherited and allocate new ones,
+ *   the chunk registry isn't left locked by the fork handlers.
+ * - The parent keeps using its blocks after the child exits.
+ * - Shareable blocks are not inherited, the child allocates its own without
+ *   writing to the parent's memfd.
+ * - A child can change the pressure callbacks while another thread of the
+ *   parent was changing them.
+ */
+int main() {
+  static void *pointers[PTR_COUNT];
+
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    pointers[i] = xd_malloc_hint(PTR_SIZE, XD_HINT_SHORT);
+    assert(pointers[i] != NULL);
+    memset(pointers[i], (int)i, PTR_SIZE);
+  }
+
+  fork_and_wait(hint_child, pointers);
+  fork_and_wait(hint_child, pointers);
+
+  for (size_t i = 0; i < PTR_COUNT; i++) {
+    assert(((unsigned char *)pointers[i])[PTR_SIZE - 1] == i);
+    xd_free(pointers[i]);
+  }
+
+  void *shareable =
+      xd_malloc_shareable(SHAREABLE_SIZE, &shareable_fd, &shareable_offset);
+  assert(shareable != NULL);
+  memset(shareable, 0xCD, SHAREABLE_SIZE);
+  pointers[0] = shareable;
+  fork_and_wait(shareable_child, pointers);
+  fork_and_wait(shareable_child, pointers);
+  for (size_t i = 0; i < SHAREABLE_SIZE; i++) {
+    assert(((unsigned char *)shareable)[i] == 0xCD);
+  }
+  xd_free(shareable);
+
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, pressure_thread, NULL) == 0);
+  for (size_t i = 0; i < PRESSURE_FORK_COUNT; i++) {
+    fork_and_wait(pressure_child, pointers);
+  }
+  __atomic_store_n(&pressure_stop, true, __ATOMIC_RELAXED);
+  assert(pthread_join(thread, NULL) == 0);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
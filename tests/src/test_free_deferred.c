@@ -0,0 +1,106 @@
+/*
+ * ==============================================================================
+ * File: test_free_deferred.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_SIZE (64)
+#define BATCH_COUNT (256)
+#define RECLAIM_ATTEMPTS (8)
+
+static pthread_barrier_t barrier;
+
+/**
+ * @brief Reader thread, stays inside a (nested) critical section between the
+ * first two and the last two barriers.
+ */
+static void *reader_thread(void *arg) {
+  (void)arg;
+  xd_epoch_enter();
+  xd_epoch_enter();
+  pthread_barrier_wait(&barrier);
+  xd_epoch_exit();
+  pthread_barrier_wait(&barrier);
+  pthread_barrier_wait(&barrier);
+  xd_epoch_exit();
+  pthread_barrier_wait(&barrier);
+  return NULL;
+}  // reader_thread()
+
+/**
+ * @brief Used for testing `xd_free_deferred()`, `xd_epoch_enter()`,
+ * `xd_epoch_exit()` and `xd_epoch_reclaim()`:
+ * - A deferred block is neither freed nor written while a thread that entered
+ *   a critical section before it was deferred is still inside it (including
+ *   nested sections).
+ * - The block is freed once the thread exits the critical section.
+ * - Deferred blocks are freed in batches without calling
+ *   `xd_epoch_reclaim()`.
+ */
+int main() {
+  pthread_t thread;
+  assert(pthread_barrier_init(&barrier, NULL, 2) == 0);
+  assert(pthread_create(&thread, NULL, reader_thread, NULL) == 0);
+
+  xd_byte *ptr = xd_malloc(PTR_SIZE);
+  assert(ptr != NULL);
+  memset(ptr, 0x5A, PTR_SIZE);
+  xd_mem_block_header *header = xd_block_get_header_from_data(ptr);
+
+  // the reader is inside its critical section
+  pthread_barrier_wait(&barrier);
+  xd_free_deferred(ptr);
+  pthread_barrier_wait(&barrier);
+  for (int i = 0; i < RECLAIM_ATTEMPTS; i++) {
+    assert(xd_epoch_reclaim() == 0);
+  }
+  assert(xd_block_get_state(header) == XD_MEM_BLOCK_ALLOCATED);
+  for (int i = 0; i < PTR_SIZE; i++) {
+    assert(ptr[i] == 0x5A);
+  }
+
+  // the reader left
+  pthread_barrier_wait(&barrier);
+  pthread_barrier_wait(&barrier);
+  size_t freed = 0;
+  for (int i = 0; i < RECLAIM_ATTEMPTS; i++) {
+    freed += xd_epoch_reclaim();
+  }
+  assert(freed == 1);
+  assert(pthread_join(thread, NULL) == 0);
+
+  // batches
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    void *block = xd_malloc(PTR_SIZE);
+    assert(block != NULL);
+    xd_free_deferred(block);
+  }
+  freed = 0;
+  for (int i = 0; i < RECLAIM_ATTEMPTS; i++) {
+    freed += xd_epoch_reclaim();
+  }
+  assert(freed > 0 && freed < BATCH_COUNT);
+
+  pthread_barrier_destroy(&barrier);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
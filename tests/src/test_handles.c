@@ -0,0 +1,119 @@
+/*
+ * ==============================================================================
+ * File: test_handles.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define HANDLE_COUNT (256)
+#define HANDLE_SIZE (1000)
+#define LOCKED_INDEX (101)
+
+/**
+ * @brief Checks that the block of the passed handle holds its pattern.
+ */
+static void check_handle(xd_handle handle, int i) {
+  xd_byte *ptr = xd_hlock(handle);
+  assert(ptr != NULL);
+  for (int j = 0; j < HANDLE_SIZE; j++) {
+    assert(ptr[j] == (xd_byte)i);
+  }
+  xd_hunlock(handle);
+}  // check_handle()
+
+/**
+ * @brief Returns the header of the block of the passed handle, the handle's
+ * index is stored before the user's data.
+ */
+static xd_mem_block_header *handle_header(xd_handle handle) {
+  xd_byte *ptr = xd_hlock(handle);
+  assert(ptr != NULL);
+  xd_hunlock(handle);
+  return xd_block_get_header_from_data(ptr - XD_ALIGNMENT);
+}  // handle_header()
+
+/**
+ * @brief Used for testing `xd_halloc()`, `xd_hlock()`, `xd_hunlock()`,
+ * `xd_hfree()` and `xd_heap_compact()`:
+ * - Compaction moves the unlocked blocks toward the start of the heap, keeping
+ *   their contents, and packs them block after block.
+ * - Locked blocks never move.
+ * - Compaction is incremental, every pass stops after the passed number of
+ *   bytes, and returns `0` once there is nothing left to move.
+ * - The free space at the top of the heap is returned to the OS.
+ * - Freed handles become invalid and are reused.
+ */
+int main() {
+  xd_handle handles[HANDLE_COUNT];
+
+  for (int i = 0; i < HANDLE_COUNT; i++) {
+    handles[i] = xd_halloc(HANDLE_SIZE);
+    assert(handles[i] != 0);
+    xd_byte *ptr = xd_hlock(handles[i]);
+    assert(ptr != NULL);
+    memset(ptr, i, HANDLE_SIZE);
+    xd_hunlock(handles[i]);
+  }
+  void *heap_end = sbrk(0);
+
+  // leave holes between the blocks
+  for (int i = 0; i < HANDLE_COUNT; i += 2) {
+    xd_hfree(handles[i]);
+  }
+  assert(xd_hlock(handles[0]) == NULL);
+
+  // a locked block doesn't move
+  xd_byte *locked_ptr = xd_hlock(handles[LOCKED_INDEX]);
+
+  // compact a block at a time
+  size_t passes = 0;
+  while (xd_heap_compact(1) != 0) {
+    passes++;
+  }
+  assert(passes > 1);
+  assert(xd_hlock(handles[LOCKED_INDEX]) == locked_ptr);
+  xd_hunlock(handles[LOCKED_INDEX]);
+  xd_hunlock(handles[LOCKED_INDEX]);
+
+  // the blocks after the locked block are packed after it
+  for (int i = LOCKED_INDEX + 2; i < HANDLE_COUNT; i += 2) {
+    xd_mem_block_header *header = handle_header(handles[i]);
+    assert(xd_block_get_next(handle_header(handles[i - 2])) == header);
+    assert(xd_block_get_state(header) == XD_MEM_BLOCK_RELOCATABLE);
+  }
+
+  // the contents are kept and the top of the heap is released
+  for (int i = 1; i < HANDLE_COUNT; i += 2) {
+    check_handle(handles[i], i);
+  }
+  assert(sbrk(0) < heap_end);
+
+  // freed handles are reused
+  xd_handle handle = xd_halloc(HANDLE_SIZE);
+  assert(handle == handles[HANDLE_COUNT - 2]);
+  xd_hfree(handle);
+
+  for (int i = 1; i < HANDLE_COUNT; i += 2) {
+    xd_hfree(handles[i]);
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,136 @@
+/*
+ * ==============================================================================
+ * File: test_heap_mark.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (1024)
+#define PTR_SIZE (100)
+#define LARGE_SIZE (3 * 1024 * 1024)
+
+static void *heap_start;
+
+/**
+ * @brief Allocates a block from a thread without a mark, it must be placed in
+ * the heap.
+ */
+static void *unmarked_thread(void *arg) {
+  (void)arg;
+  void *ptr = xd_malloc(PTR_SIZE);
+  assert(ptr >= heap_start && ptr < sbrk(0));
+  xd_free(ptr);
+  return NULL;
+}  // unmarked_thread()
+
+/**
+ * @brief Used for testing `xd_heap_mark()` and `xd_heap_release_to()`:
+ * - Blocks allocated inside a mark are placed outside the heap, and freeing
+ *   them does nothing.
+ * - Releasing a mark frees the blocks allocated after it in one operation (the
+ *   next block is placed where the first block after the mark was), including
+ *   blocks of nested marks and blocks that needed a new segment.
+ * - Blocks allocated before a mark stay valid, also when they are moved by
+ *   `xd_realloc()` inside the mark, while moved blocks of the stage stay in
+ *   the stage.
+ * - Other threads allocate from the heap while a thread has a mark.
+ * - After the outermost mark is released, blocks are placed in the heap again.
+ * - Releasing a mark before any block was allocated inside a mark leaves the
+ *   thread-specific data of other keys alone.
+ */
+int main() {
+  heap_start = sbrk(0);
+
+  // nothing was ever allocated inside a mark
+  pthread_key_t key;
+  int value;
+  assert(pthread_key_create(&key, NULL) == 0);
+  assert(pthread_setspecific(key, &value) == 0);
+  xd_heap_release_to(xd_heap_mark());
+  assert(pthread_getspecific(key) == &value);
+  assert(pthread_key_delete(key) == 0);
+
+  xd_byte *before = xd_malloc(PTR_SIZE);
+  assert(before != NULL);
+  memset(before, 0xAB, PTR_SIZE);
+  xd_byte *moved = xd_malloc(PTR_SIZE);
+  assert(moved != NULL);
+  memset(moved, 0xCD, PTR_SIZE);
+
+  xd_mark mark = xd_heap_mark();
+  void *heap_end = sbrk(0);
+
+  xd_byte *first = xd_malloc(PTR_SIZE);
+  assert(first != NULL);
+  assert((void *)first < heap_start || (void *)first >= heap_end);
+  for (int i = 1; i < PTR_COUNT; i++) {
+    xd_byte *ptr = (i % 2 == 0) ? xd_malloc(PTR_SIZE) : xd_calloc(1, PTR_SIZE);
+    assert(ptr != NULL);
+    memset(ptr, i, PTR_SIZE);
+    if (i % 3 == 0) {
+      xd_free(ptr);
+    }
+  }
+  assert(sbrk(0) == heap_end);
+
+  // blocks are moved within their own heap
+  moved = xd_realloc(moved, 4 * PTR_SIZE);
+  assert(moved != NULL);
+  assert((void *)moved >= heap_start && (void *)moved < sbrk(0));
+  xd_byte *staged = xd_realloc(xd_malloc(PTR_SIZE), 4 * PTR_SIZE);
+  assert(staged != NULL);
+  assert((void *)staged < heap_start || (void *)staged >= sbrk(0));
+
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, unmarked_thread, NULL) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+
+  // nested mark with a block larger than a segment
+  xd_mark nested_mark = xd_heap_mark();
+  xd_byte *nested_first = xd_malloc(PTR_SIZE);
+  xd_byte *large = xd_malloc(LARGE_SIZE);
+  assert(large != NULL);
+  memset(large, 1, LARGE_SIZE);
+  xd_heap_release_to(nested_mark);
+  assert(xd_malloc(PTR_SIZE) == nested_first);
+
+  // release everything allocated after the first mark
+  xd_heap_release_to(mark);
+  xd_heap_release_to(mark);
+  for (int i = 0; i < PTR_SIZE; i++) {
+    assert(before[i] == (xd_byte)0xAB);
+    assert(moved[i] == (xd_byte)0xCD);
+  }
+
+  // marks are reusable, and released marks return to the heap
+  mark = xd_heap_mark();
+  assert(xd_malloc(PTR_SIZE) == first);
+  xd_heap_release_to(mark);
+  xd_byte *after = xd_malloc(PTR_SIZE);
+  assert((void *)after >= heap_start && (void *)after < sbrk(0));
+
+  xd_free(after);
+  xd_free(moved);
+  xd_free(before);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
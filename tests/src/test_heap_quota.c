@@ -0,0 +1,142 @@
+/*
+ * ==============================================================================
+ * File: test_heap_quota.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define QUOTA (256 * 1024)
+#define BLOCK_SIZE (16 * 1024)
+#define BLOCK_COUNT (64)
+
+/**
+ * @brief The blocks of a tenant, freed when its heap hits the quota.
+ */
+typedef struct tenant {
+  void *blocks[BLOCK_COUNT];
+  size_t count;  // The number of allocated blocks
+  size_t calls;  // The number of times the callback was called
+} tenant;
+
+/**
+ * @brief Quota callback, frees all the blocks of the tenant.
+ */
+static void shed_blocks(xd_heap *heap, size_t bytes, void *arg) {
+  tenant *t = (tenant *)arg;
+  assert(heap != NULL && bytes > 0);
+  t->calls++;
+
+  // allocations from the heap fail inside the callback
+  assert(xd_heap_push_current(heap) == 0);
+  errno = 0;
+  assert(xd_malloc(QUOTA) == NULL && errno == ENOMEM);
+  xd_heap_pop_current();
+
+  while (t->count > 0) {
+    xd_free(t->blocks[--t->count]);
+  }
+}  // shed_blocks()
+
+/**
+ * @brief Used for testing `xd_heap_set_quota()` and `xd_heap_get_usage()`:
+ * - Allocations fail with `ENOMEM` once the heap would map more than its
+ *   quota, without affecting other heaps.
+ * - The callback is called when the quota is hit, and the memory it frees is
+ *   used instead of growing the heap.
+ * - The usage reports the quota, the mapped size and the allocated size.
+ */
+int main() {
+  static tenant tenants[2];
+  xd_heap *heaps[2] = {xd_heap_create(), xd_heap_create()};
+  assert(heaps[0] != NULL && heaps[1] != NULL);
+
+  errno = 0;
+  assert(xd_heap_set_quota(NULL, QUOTA, NULL, NULL) == -1 && errno == EINVAL);
+  assert(xd_heap_get_usage(heaps[0], NULL) == -1 && errno == EINVAL);
+  assert(xd_heap_set_quota(heaps[0], QUOTA, NULL, NULL) == 0);
+  assert(xd_heap_set_quota(heaps[1], QUOTA, shed_blocks, &tenants[1]) == 0);
+
+  // the first tenant fills its quota, then fails
+  tenant *t = &tenants[0];
+  assert(xd_heap_push_current(heaps[0]) == 0);
+  while (t->count < BLOCK_COUNT) {
+    errno = 0;
+    void *block = xd_malloc(BLOCK_SIZE);
+    if (block == NULL) {
+      assert(errno == ENOMEM);
+      break;
+    }
+    memset(block, 0xAB, BLOCK_SIZE);
+    t->blocks[t->count++] = block;
+  }
+  xd_heap_pop_current();
+  assert(t->count > 0 && t->count < BLOCK_COUNT);
+
+  xd_heap_usage usage;
+  assert(xd_heap_get_usage(heaps[0], &usage) == 0);
+  assert(usage.quota == QUOTA);
+  assert(usage.mapped > 0 && usage.mapped <= QUOTA);
+  assert(usage.allocated >= t->count * BLOCK_SIZE);
+  assert(usage.allocated <= usage.mapped);
+
+  // the other heaps are not affected
+  void *block = xd_malloc(4 * QUOTA);
+  assert(block != NULL);
+  xd_free(block);
+
+  // the second tenant sheds its blocks instead of exceeding the quota
+  t = &tenants[1];
+  assert(xd_heap_push_current(heaps[1]) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    block = xd_malloc(BLOCK_SIZE);
+    assert(block != NULL);
+    t->blocks[t->count++] = block;
+  }
+  xd_heap_pop_current();
+  assert(t->calls > 0);
+  assert(xd_heap_get_usage(heaps[1], &usage) == 0);
+  assert(usage.mapped <= QUOTA);
+  size_t allocated = usage.allocated;
+
+  // frees are accounted
+  xd_free(t->blocks[--t->count]);
+  assert(xd_heap_get_usage(heaps[1], &usage) == 0);
+  assert(usage.allocated < allocated);
+  while (t->count > 0) {
+    xd_free(t->blocks[--t->count]);
+  }
+  assert(xd_heap_get_usage(heaps[1], &usage) == 0);
+  assert(usage.allocated == 0);
+
+  // without a quota the heap grows as needed
+  assert(xd_heap_set_quota(heaps[0], 0, NULL, NULL) == 0);
+  assert(xd_heap_push_current(heaps[0]) == 0);
+  block = xd_malloc(4 * QUOTA);
+  xd_heap_pop_current();
+  assert(block != NULL);
+  assert(xd_heap_get_usage(heaps[0], &usage) == 0);
+  assert(usage.quota == 0 && usage.mapped > QUOTA);
+
+  xd_heap_destroy(heaps[0]);
+  xd_heap_destroy(heaps[1]);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
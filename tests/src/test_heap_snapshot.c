@@ -0,0 +1,177 @@
+/*
+ * ==============================================================================
+ * File: test_heap_snapshot.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define TAG (5)
+#define BLOCK_COUNT (100)
+#define BLOCK_SIZE (200)
+#define READ_SIZE (4096)
+#define PIPE_BLOCK_COUNT (8192)
+
+/**
+ * @brief Returns the number of records of a snapshot whose address is one of
+ * the passed blocks.
+ */
+static size_t snapshot_count(FILE *stream, const xd_snapshot_header *header,
+                             void **pointers, uint32_t tag) {
+  size_t found = 0;
+  for (uint64_t i = 0; i < header->block_count; i++) {
+    xd_snapshot_block block;
+    assert(fread(&block, sizeof(block), 1, stream) == 1);
+    assert(block.state <= XD_SNAPSHOT_BLOCK_RELOCATABLE);
+    for (size_t j = 0; j < BLOCK_COUNT; j++) {
+      if (block.address == (uint64_t)(uintptr_t)pointers[j]) {
+        assert(block.state == XD_SNAPSHOT_BLOCK_ALLOCATED);
+        assert(block.size >= BLOCK_SIZE && block.tag == tag);
+        found++;
+      }
+    }
+  }
+  return found;
+}  // snapshot_count()
+
+/**
+ * @brief Reads a snapshot from a pipe into buffers allocated while it is
+ * being written, returns the number of bytes read.
+ */
+static void *pipe_read(void *arg) {
+  int fd = *(int *)arg;
+  size_t total = 0;
+  while (true) {
+    char *buffer = xd_malloc(READ_SIZE);
+    assert(buffer != NULL);
+    ssize_t length = read(fd, buffer, READ_SIZE);
+    xd_free(buffer);
+    assert(length >= 0);
+    if (length == 0) {
+      break;
+    }
+    total += (size_t)length;
+  }
+  return (void *)total;
+}  // pipe_read()
+
+/**
+ * @brief Used for testing `xd_malloc_snapshot()`:
+ * - The snapshot holds every allocated block with its size and tag.
+ * - The snapshot holds the sampled blocks with their allocation stacks.
+ * - The snapshot is written after the allocator is unlocked, so a pipe read
+ *   by a thread that allocates doesn't deadlock.
+ * - A failed write is reported with `EIO`.
+ */
+int main() {
+  static void *pointers[BLOCK_COUNT];
+  static void *tagged[BLOCK_COUNT];
+
+  xd_malloc_lifetime_prediction(1);
+  xd_malloc_leak_detection(NULL);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    pointers[i] = xd_malloc(BLOCK_SIZE);
+    assert(pointers[i] != NULL);
+  }
+  assert(xd_malloc_tag_push(TAG) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    tagged[i] = xd_malloc(BLOCK_SIZE);
+    assert(tagged[i] != NULL);
+  }
+  xd_malloc_tag_pop();
+
+  FILE *stream = tmpfile();
+  assert(stream != NULL);
+  assert(xd_malloc_snapshot(stream) == 0);
+  long size = ftell(stream);
+  rewind(stream);
+
+  // the header describes the records that follow
+  xd_snapshot_header header;
+  assert(fread(&header, sizeof(header), 1, stream) == 1);
+  assert(header.magic == XD_SNAPSHOT_MAGIC);
+  assert(header.version == XD_SNAPSHOT_VERSION);
+  assert(header.stack_depth == XD_SNAPSHOT_STACK_DEPTH);
+  assert(header.sample_period == 1);
+  assert(header.block_count >= 2 * BLOCK_COUNT);
+  assert(header.sample_count >= BLOCK_COUNT);
+  assert((size_t)size ==
+         sizeof(header) + (header.block_count * sizeof(xd_snapshot_block)) +
+             (header.sample_count * sizeof(xd_snapshot_sample)));
+
+  // every block is present with its tag
+  long blocks_start = ftell(stream);
+  assert(snapshot_count(stream, &header, pointers, 0) == BLOCK_COUNT);
+  assert(fseek(stream, blocks_start, SEEK_SET) == 0);
+  assert(snapshot_count(stream, &header, tagged, TAG) == BLOCK_COUNT);
+
+  // the sampled blocks carry their allocation stacks
+  size_t sampled = 0;
+  for (uint64_t i = 0; i < header.sample_count; i++) {
+    xd_snapshot_sample sample;
+    assert(fread(&sample, sizeof(sample), 1, stream) == 1);
+    assert(sample.stack[0] != 0);
+    for (size_t j = 0; j < BLOCK_COUNT; j++) {
+      sampled += (sample.address == (uint64_t)(uintptr_t)pointers[j]);
+    }
+  }
+  assert(sampled > 0);
+  fclose(stream);
+
+  // the snapshot overflows the pipe while the reader allocates
+  static void *pipe_blocks[PIPE_BLOCK_COUNT];
+  for (size_t i = 0; i < PIPE_BLOCK_COUNT; i++) {
+    pipe_blocks[i] = xd_malloc(16);
+    assert(pipe_blocks[i] != NULL);
+  }
+  int fds[2];
+  assert(pipe(fds) == 0);
+  pthread_t reader;
+  assert(pthread_create(&reader, NULL, pipe_read, &fds[0]) == 0);
+  stream = fdopen(fds[1], "w");
+  assert(stream != NULL);
+  assert(xd_malloc_snapshot(stream) == 0);
+  fclose(stream);
+  void *piped;
+  assert(pthread_join(reader, &piped) == 0);
+  assert((size_t)piped > PIPE_BLOCK_COUNT * sizeof(xd_snapshot_block));
+  close(fds[0]);
+  for (size_t i = 0; i < PIPE_BLOCK_COUNT; i++) {
+    xd_free(pipe_blocks[i]);
+  }
+
+  // a stream that cannot be written fails
+  stream = fopen("/dev/null", "r");
+  assert(stream != NULL);
+  errno = 0;
+  assert(xd_malloc_snapshot(stream) == -1 && errno == EIO);
+  fclose(stream);
+
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    xd_free(pointers[i]);
+    xd_free(tagged[i]);
+  }
+  xd_malloc_lifetime_prediction(0);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
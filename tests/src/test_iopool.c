@@ -0,0 +1,155 @@
+/*
+ * ==============================================================================
+ * File: test_iopool.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define BUFFER_SIZE (4096)
+#define CHUNK_COUNT (8)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Checks whether the page containing the passed address is mapped.
+ */
+static int is_mapped(void *ptr) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  void *page = (void *)((uintptr_t)ptr & ~(uintptr_t)(page_size - 1));
+  return msync(page, page_size, MS_ASYNC) == 0;
+}  // is_mapped()
+
+/**
+ * @brief Checks whether the passed buffer lies in one of the pool's regions.
+ */
+static int in_regions(xd_iopool *pool, void *buffer) {
+  xd_iopool_region regions[8];
+  size_t count = xd_iopool_regions(pool, regions, 8);
+  for (size_t i = 0; i < count && i < 8; i++) {
+    if ((char *)buffer >= (char *)regions[i].base &&
+        (char *)buffer + BUFFER_SIZE <=
+            (char *)regions[i].base + regions[i].size) {
+      return 1;
+    }
+  }
+  return 0;
+}  // in_regions()
+
+/**
+ * @brief Puts the passed buffers back into the pool from another thread.
+ */
+static void *put_thread(void *arg) {
+  void **args = (void **)arg;
+  xd_iopool *pool = (xd_iopool *)args[0];
+  for (int i = 1; i <= CHUNK_COUNT; i++) {
+    xd_iopool_put(pool, args[i]);
+  }
+  return NULL;
+}  // put_thread()
+
+/**
+ * @brief Used for testing `xd_iopool_create()`, `xd_iopool_get()`,
+ * `xd_iopool_put()`, `xd_iopool_regions()` and `xd_iopool_destroy()`:
+ * - Buffers are page-aligned, distinct and lie in the pool's regions, a new
+ *   region is added once the buffers of the first one are all in use.
+ * - A buffer put back by a thread is reused by it first.
+ * - Buffers put back by a thread that exits return to the pool.
+ * - Huge page pools use whole huge pages.
+ * - Locked pools work, or fail cleanly when the lock limit is too low.
+ * - Destroying the pool unmaps its buffers.
+ */
+int main() {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  errno = 0;
+  assert(xd_iopool_create(0, CHUNK_COUNT, 0) == NULL && errno == EINVAL);
+
+  xd_iopool *pool = xd_iopool_create(BUFFER_SIZE, CHUNK_COUNT, 0);
+  assert(pool != NULL);
+  xd_iopool_region region;
+  assert(xd_iopool_regions(pool, &region, 1) == 1);
+  assert(region.size >= CHUNK_COUNT * BUFFER_SIZE);
+
+  void *buffers[CHUNK_COUNT + 1];
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    buffers[i] = xd_iopool_get(pool);
+    assert(buffers[i] != NULL);
+    assert((uintptr_t)buffers[i] % page_size == 0);
+    assert(in_regions(pool, buffers[i]));
+    for (int j = 0; j < i; j++) {
+      assert(buffers[i] != buffers[j]);
+    }
+    memset(buffers[i], i, BUFFER_SIZE);
+  }
+  if (region.size / BUFFER_SIZE == CHUNK_COUNT) {
+    buffers[CHUNK_COUNT] = xd_iopool_get(pool);
+    assert(xd_iopool_regions(pool, NULL, 0) == 2);
+    assert(in_regions(pool, buffers[CHUNK_COUNT]));
+    xd_iopool_put(pool, buffers[CHUNK_COUNT]);
+  }
+
+  // recycling by the same thread
+  xd_iopool_put(pool, buffers[3]);
+  assert(xd_iopool_get(pool) == buffers[3]);
+
+  // buffers put back by an exiting thread return to the pool
+  size_t region_count = xd_iopool_regions(pool, NULL, 0);
+  void *args[CHUNK_COUNT + 1] = {pool};
+  memcpy(&args[1], buffers, CHUNK_COUNT * sizeof(void *));
+  pthread_t thread;
+  assert(pthread_create(&thread, NULL, put_thread, args) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    void *buffer = xd_iopool_get(pool);
+    assert(in_regions(pool, buffer));
+  }
+  assert(xd_iopool_regions(pool, NULL, 0) == region_count);
+  xd_iopool_destroy(pool);
+  assert(!is_mapped(buffers[0]));
+
+  // huge pages
+  pool = xd_iopool_create(BUFFER_SIZE, CHUNK_COUNT, XD_IOPOOL_HUGEPAGE);
+  assert(pool != NULL);
+  assert(xd_iopool_regions(pool, &region, 1) == 1);
+  assert(region.size % HUGE_PAGE_SIZE == 0);
+  for (size_t i = 0; i < HUGE_PAGE_SIZE / BUFFER_SIZE; i++) {
+    assert(xd_iopool_get(pool) != NULL);
+  }
+  assert(xd_iopool_regions(pool, NULL, 0) == 1);
+  xd_iopool_destroy(pool);
+
+  // locked pages
+  errno = 0;
+  pool = xd_iopool_create(BUFFER_SIZE, 2, XD_IOPOOL_MLOCK);
+  if (pool == NULL) {
+    assert(errno == ENOMEM || errno == EPERM || errno == EAGAIN);
+  }
+  else {
+    void *buffer = xd_iopool_get(pool);
+    assert(buffer != NULL);
+    xd_iopool_put(pool, buffer);
+    xd_iopool_destroy(pool);
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,143 @@
+/*
+ * ==============================================================================
+ * File: test_leak_report.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define LEAK_COUNT (10)
+#define LEAK_SIZE (1000)
+#define AGE_COUNT (256)
+
+/**
+ * @brief Allocates the blocks that are leaked, from a call site of its own.
+ */
+static __attribute__((noinline)) void leak_blocks(void **blocks) {
+  for (size_t i = 0; i < LEAK_COUNT; i++) {
+    blocks[i] = xd_malloc(LEAK_SIZE);
+    assert(blocks[i] != NULL);
+  }
+}  // leak_blocks()
+
+/**
+ * @brief Allocates and frees sampled blocks, so lifetime prediction ages out
+ * its older samples.
+ */
+static __attribute__((noinline)) void age_samples() {
+  for (size_t i = 0; i < AGE_COUNT; i++) {
+    void *block = xd_malloc(64);
+    assert(block != NULL);
+    xd_free(block);
+  }
+}  // age_samples()
+
+/**
+ * @brief Reads a report written to the passed stream since `start`.
+ */
+static void report_read(FILE *stream, long start, char *report, size_t size) {
+  fflush(stream);
+  long end = ftell(stream);
+  assert(end > start && (size_t)(end - start) < size);
+  assert(fseek(stream, start, SEEK_SET) == 0);
+  size_t length = fread(report, 1, (size_t)(end - start), stream);
+  report[length] = '\0';
+  assert(fseek(stream, 0, SEEK_END) == 0);
+}  // report_read()
+
+/**
+ * @brief Used for testing `xd_malloc_leak_report()` and
+ * `xd_malloc_leak_detection()`:
+ * - The report counts the blocks still allocated in the main heap, the hint
+ *   heaps and the created heaps, but not the allocator's own structures.
+ * - The sampled blocks are grouped by allocation stack.
+ * - Long-lived sampled blocks keep their stacks after lifetime prediction
+ *   stops tracking them.
+ * - The report is written on exit when leak detection is enabled.
+ */
+int main() {
+  static char report[64 * 1024];
+  static void *blocks[LEAK_COUNT];
+  FILE *stream = tmpfile();
+  assert(stream != NULL);
+
+  // the heap itself is not a leak
+  xd_heap *heap = xd_heap_create();
+  assert(heap != NULL);
+
+  xd_malloc_lifetime_prediction(1);
+  xd_malloc_leak_detection(stream);
+  assert(xd_malloc_leak_report(stream) == 0);
+  long start = ftell(stream);
+
+  // the leaked blocks are counted and grouped by stack
+  leak_blocks(blocks);
+  assert(xd_heap_push_current(heap) == 0);
+  void *heap_block = xd_malloc(512);
+  assert(heap_block != NULL);
+  xd_heap_pop_current();
+
+  assert(xd_malloc_leak_report(stream) == (LEAK_COUNT * LEAK_SIZE) + 512);
+  report_read(stream, start, report, sizeof(report));
+  assert(strstr(report, " bytes leaked in ") != NULL);
+  char *group = strstr(report, "bytes in ~10 blocks allocated at:\n");
+  assert(group != NULL);
+  assert(strstr(group, "    #0 0x") != NULL);
+  assert(strstr(group, "    #1 0x") != NULL);
+
+  // the stacks outlive the samples of lifetime prediction
+  usleep(1100 * 1000);
+  age_samples();
+  start = ftell(stream);
+  assert(xd_malloc_leak_report(stream) == (LEAK_COUNT * LEAK_SIZE) + 512);
+  report_read(stream, start, report, sizeof(report));
+  assert(strstr(report, "bytes in ~10 blocks allocated at:\n") != NULL);
+
+  // freed blocks are no longer counted
+  for (size_t i = 0; i < LEAK_COUNT; i++) {
+    xd_free(blocks[i]);
+  }
+  xd_free(heap_block);
+  assert(xd_malloc_leak_report(stream) == 0);
+  xd_heap_destroy(heap);
+  xd_malloc_leak_detection(NULL);
+
+  // the report is written on exit
+  long exit_start = ftell(stream);
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (pid == 0) {
+    xd_malloc_leak_detection(stream);
+    leak_blocks(blocks);
+    exit(EXIT_SUCCESS);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status));
+  assert(fseek(stream, 0, SEEK_END) == 0);
+  report_read(stream, exit_start, report, sizeof(report));
+  assert(strstr(report, " bytes leaked in ") != NULL);
+  assert(strstr(report, "bytes in ~10 blocks allocated at:\n") != NULL);
+
+  xd_malloc_lifetime_prediction(0);
+  fclose(stream);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
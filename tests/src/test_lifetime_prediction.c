@@ -0,0 +1,164 @@
+/*
+ * ==============================================================================
+ * File: test_lifetime_prediction.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (16)
+#define PTR_SIZE (48)
+#define AGE_ALLOC_COUNT (128)
+#define FILL_COUNT (4096)
+#define CHUNK_SIZE (64 * 1024)
+
+/**
+ * @brief Allocation call site whose blocks are freed right away.
+ */
+static __attribute__((noinline)) void *short_site(size_t size) {
+  return xd_malloc(size);
+}  // short_site()
+
+/**
+ * @brief Allocation call site whose blocks are never freed during the test.
+ */
+static __attribute__((noinline)) void *long_site(size_t size) {
+  return xd_malloc(size);
+}  // long_site()
+
+/**
+ * @brief Allocation call site whose blocks fill the sample slots before they
+ * become long-lived.
+ */
+static __attribute__((noinline)) void *fill_site(size_t size) {
+  return xd_malloc(size);
+}  // fill_site()
+
+/**
+ * @brief Allocation call site first used after the sample slots were filled by
+ * long-lived blocks, whose blocks are freed right away.
+ */
+static __attribute__((noinline)) void *late_site(size_t size) {
+  return xd_malloc(size);
+}  // late_site()
+
+/**
+ * @brief Allocation call site that is never sampled enough to be predicted.
+ */
+static __attribute__((noinline)) void *unknown_site(size_t size) {
+  return xd_malloc(size);
+}  // unknown_site()
+
+/**
+ * @brief Checks whether a block is in the same chunk as a block allocated using
+ * `xd_malloc_hint()` with the passed hint.
+ */
+static int is_placed_as_hint(void *ptr, int hint) {
+  xd_byte *hint_ptr = xd_malloc_hint(PTR_SIZE, hint);
+  assert(hint_ptr != NULL);
+  xd_byte *byte_ptr = ptr;
+  int placed = (byte_ptr > hint_ptr) ? (byte_ptr - hint_ptr < CHUNK_SIZE)
+                                     : (hint_ptr - byte_ptr < CHUNK_SIZE);
+  xd_free(hint_ptr);
+  return placed;
+}  // is_placed_as_hint()
+
+/**
+ * @brief Used for testing `xd_malloc_lifetime_prediction()`:
+ * - Blocks of call sites without enough samples stay in the heap used by
+ *   `xd_malloc()`.
+ * - Blocks of a call site that frees them right away are placed as short-lived
+ *   once predicted.
+ * - Blocks of a call site that keeps them for more than a second are placed as
+ *   long-lived once predicted, without being freed.
+ * - Long-lived samples are evicted, so call sites first used after all the
+ *   sample slots were filled are still predicted.
+ * - Disabling prediction places all blocks in the heap used by `xd_malloc()`.
+ */
+int main() {
+  void *heap_start = sbrk(0);
+  xd_free(xd_malloc(1));
+  void *heap_end = sbrk(0);
+
+  xd_malloc_lifetime_prediction(1);
+
+  // not enough samples
+  void *ptr = unknown_site(PTR_SIZE);
+  assert(ptr >= heap_start && ptr < heap_end);
+  xd_free(ptr);
+
+  // short-lived site
+  for (int i = 0; i < PTR_COUNT; i++) {
+    ptr = short_site(PTR_SIZE);
+    assert(ptr != NULL);
+    memset(ptr, 1, PTR_SIZE);
+    xd_free(ptr);
+  }
+  ptr = short_site(PTR_SIZE);
+  assert(ptr < heap_start || ptr >= heap_end);
+  assert(is_placed_as_hint(ptr, XD_HINT_SHORT));
+  xd_free(ptr);
+
+  // long-lived site, the samples are counted by later samples once old enough
+  void *long_ptrs[PTR_COUNT];
+  for (int i = 0; i < PTR_COUNT; i++) {
+    long_ptrs[i] = long_site(PTR_SIZE);
+    assert(long_ptrs[i] >= heap_start && long_ptrs[i] < heap_end);
+  }
+  static void *fill_ptrs[FILL_COUNT];
+  for (int i = 0; i < FILL_COUNT; i++) {
+    fill_ptrs[i] = fill_site(PTR_SIZE);
+    assert(fill_ptrs[i] != NULL);
+  }
+  heap_end = sbrk(0);
+  struct timespec delay = {1, 100000000};
+  nanosleep(&delay, NULL);
+  for (int i = 0; i < AGE_ALLOC_COUNT; i++) {
+    xd_free(short_site(PTR_SIZE));
+  }
+  ptr = long_site(PTR_SIZE);
+  assert(ptr < heap_start || ptr >= heap_end);
+  assert(is_placed_as_hint(ptr, XD_HINT_LONG));
+  xd_free(ptr);
+
+  // a call site first used once the sample slots were filled
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(late_site(PTR_SIZE));
+  }
+  ptr = late_site(PTR_SIZE);
+  assert(is_placed_as_hint(ptr, XD_HINT_SHORT));
+  xd_free(ptr);
+
+  // disabled
+  xd_malloc_lifetime_prediction(0);
+  ptr = short_site(PTR_SIZE);
+  assert(ptr >= heap_start && ptr < heap_end);
+  xd_free(ptr);
+
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(long_ptrs[i]);
+  }
+  for (int i = 0; i < FILL_COUNT; i++) {
+    xd_free(fill_ptrs[i]);
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
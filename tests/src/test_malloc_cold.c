@@ -0,0 +1,89 @@
+/*
+ * ==============================================================================
+ * File: test_malloc_cold.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (64)
+#define PTR_SIZE (200)
+
+/**
+ * @brief Used for testing `xd_malloc_cold()` and `xd_heap_mark_cold()`:
+ * - Cold blocks are packed together, and are neither placed in the heap used by
+ *   `xd_malloc()` nor grow it, even when allocated interleaved with hot blocks.
+ * - Hot blocks stay packed together.
+ * - Marking the cold heap keeps the contents of the cold blocks.
+ * - `xd_realloc()` keeps a block in the cold heap.
+ */
+int main() {
+  xd_byte *cold_ptrs[PTR_COUNT];
+  xd_byte *hot_ptrs[PTR_COUNT];
+
+  void *heap_start = sbrk(0);
+  xd_free(xd_malloc(1));
+  void *heap_end = sbrk(0);
+
+  for (int i = 0; i < PTR_COUNT; i++) {
+    cold_ptrs[i] = xd_malloc_cold(PTR_SIZE);
+    assert(cold_ptrs[i] != NULL);
+    assert((void *)cold_ptrs[i] < heap_start ||
+           (void *)cold_ptrs[i] >= heap_end);
+    memset(cold_ptrs[i], i, PTR_SIZE);
+
+    hot_ptrs[i] = xd_malloc(PTR_SIZE);
+    assert(hot_ptrs[i] != NULL);
+    assert((void *)hot_ptrs[i] >= heap_start);
+  }
+  heap_end = sbrk(0);
+
+  // both are packed, block after block
+  for (int i = 1; i < PTR_COUNT; i++) {
+    assert(xd_block_get_next(xd_block_get_header_from_data(cold_ptrs[i - 1])) ==
+           xd_block_get_header_from_data(cold_ptrs[i]));
+    assert(xd_block_get_next(xd_block_get_header_from_data(hot_ptrs[i - 1])) ==
+           xd_block_get_header_from_data(hot_ptrs[i]));
+  }
+
+  // the contents survive the advice
+  assert(xd_heap_mark_cold() == 0);
+  for (int i = 0; i < PTR_COUNT; i++) {
+    for (int j = 0; j < PTR_SIZE; j++) {
+      assert(cold_ptrs[i][j] == (xd_byte)i);
+    }
+  }
+
+  // realloc stays cold
+  xd_byte *ptr = xd_realloc(cold_ptrs[0], 4 * PTR_SIZE);
+  assert(ptr != NULL);
+  assert((void *)ptr < heap_start || (void *)ptr >= heap_end);
+  for (int j = 0; j < PTR_SIZE; j++) {
+    assert(ptr[j] == 0);
+  }
+  cold_ptrs[0] = ptr;
+
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(cold_ptrs[i]);
+    xd_free(hot_ptrs[i]);
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
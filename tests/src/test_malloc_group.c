@@ -0,0 +1,127 @@
+/*
+ * ==============================================================================
+ * File: test_malloc_group.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define GROUP_SIZE (4)
+#define GROUP_COUNT (32)
+
+static const size_t sizes[GROUP_SIZE] = {24, 1, 100, 7};
+
+/**
+ * @brief Used for testing `xd_malloc_group()`:
+ * - The members of a group are allocated block after block, in order, and are
+ *   at least as large as requested.
+ * - Groups allocated after scattering the heap are still contiguous.
+ * - Members are freed individually (in any order) without affecting the other
+ *   members.
+ * - With a current heap, the members are placed in it, counted in its usage
+ *   and freed when it is destroyed.
+ * - A member of size 0, or missing arrays, fail with `EINVAL`.
+ */
+int main() {
+  void *ptrs[GROUP_COUNT][GROUP_SIZE];
+  void *scatter[GROUP_COUNT];
+
+  for (int g = 0; g < GROUP_COUNT; g++) {
+    // scatter the heap with small blocks between the groups
+    scatter[g] = xd_malloc(16);
+    assert(scatter[g] != NULL);
+
+    assert(xd_malloc_group(sizes, GROUP_SIZE, ptrs[g]) == 0);
+    for (int i = 0; i < GROUP_SIZE; i++) {
+      xd_mem_block_header *header = xd_block_get_header_from_data(ptrs[g][i]);
+      assert(xd_block_get_state(header) == XD_MEM_BLOCK_ALLOCATED);
+      assert(xd_block_get_size(header) >= sizes[i]);
+      if (i > 0) {
+        xd_mem_block_header *prev =
+            xd_block_get_header_from_data(ptrs[g][i - 1]);
+        assert(xd_block_get_next(prev) == header);
+      }
+      memset(ptrs[g][i], g + i, sizes[i]);
+    }
+  }
+
+  // free the scatter blocks, the groups are intact
+  for (int g = 0; g < GROUP_COUNT; g++) {
+    xd_free(scatter[g]);
+  }
+  for (int g = 0; g < GROUP_COUNT; g++) {
+    for (int i = 0; i < GROUP_SIZE; i++) {
+      for (size_t j = 0; j < sizes[i]; j++) {
+        assert(((xd_byte *)ptrs[g][i])[j] == (xd_byte)(g + i));
+      }
+    }
+  }
+
+  // free members out of order, the rest of the group is intact
+  for (int g = 0; g < GROUP_COUNT; g++) {
+    xd_free(ptrs[g][2]);
+    xd_free(ptrs[g][0]);
+    for (size_t j = 0; j < sizes[1]; j++) {
+      assert(((xd_byte *)ptrs[g][1])[j] == (xd_byte)(g + 1));
+    }
+    for (size_t j = 0; j < sizes[3]; j++) {
+      assert(((xd_byte *)ptrs[g][3])[j] == (xd_byte)(g + 3));
+    }
+    xd_free(ptrs[g][3]);
+    xd_free(ptrs[g][1]);
+  }
+
+  // invalid size
+  size_t invalid_sizes[2] = {16, 0};
+  void *invalid_ptrs[2];
+  errno = 0;
+  assert(xd_malloc_group(invalid_sizes, 2, invalid_ptrs) == -1);
+  assert(errno == EINVAL);
+
+  // missing arrays
+  errno = 0;
+  assert(xd_malloc_group(NULL, 2, invalid_ptrs) == -1 && errno == EINVAL);
+  errno = 0;
+  assert(xd_malloc_group(sizes, GROUP_SIZE, NULL) == -1 && errno == EINVAL);
+
+  // the members are placed in the current heap
+  xd_heap *heap = xd_heap_create();
+  assert(heap != NULL);
+  assert(xd_heap_push_current(heap) == 0);
+  assert(xd_malloc_group(sizes, GROUP_SIZE, ptrs[0]) == 0);
+  xd_heap_pop_current();
+  xd_heap_usage usage;
+  assert(xd_heap_get_usage(heap, &usage) == 0);
+  size_t allocated = 0;
+  for (int i = 0; i < GROUP_SIZE; i++) {
+    xd_mem_block_header *header = xd_block_get_header_from_data(ptrs[0][i]);
+    allocated += xd_block_get_size(header);
+  }
+  assert(usage.mapped > 0 && usage.allocated == allocated);
+  xd_free(ptrs[0][1]);
+  assert(xd_heap_get_usage(heap, &usage) == 0);
+  assert(usage.allocated < allocated);
+  xd_heap_destroy(heap);
+
+  // empty group
+  assert(xd_malloc_group(NULL, 0, NULL) == 0);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
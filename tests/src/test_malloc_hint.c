@@ -0,0 +1,104 @@
+/*
+ * ==============================================================================
+ * File: test_malloc_hint.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define PTR_COUNT (64)
+#define PTR_SIZE (48)
+
+static const int hints[] = {XD_HINT_SHORT, XD_HINT_LONG, XD_HINT_PERMANENT};
+
+#define HINT_COUNT ((int)(sizeof(hints) / sizeof(hints[0])))
+
+/**
+ * @brief Used for testing `xd_malloc_hint()`:
+ * - Blocks of different lifetime classes are never placed next to each other,
+ *   even when allocated interleaved.
+ * - Blocks of each class are packed together, and are neither placed in the
+ *   heap used by `xd_malloc()` nor grow it.
+ * - Freeing all the short-lived blocks coalesces them into a single block,
+ *   regardless of the long-lived blocks allocated between them.
+ * - `xd_realloc()` keeps a block in its class, and unknown hints fall back to
+ *   `xd_malloc()`.
+ */
+int main() {
+  xd_byte *ptrs[HINT_COUNT][PTR_COUNT];
+
+  void *heap_start = sbrk(0);
+  xd_free(xd_malloc(1));
+  void *heap_end = sbrk(0);
+
+  // interleave the lifetime classes
+  for (int i = 0; i < PTR_COUNT; i++) {
+    for (int h = 0; h < HINT_COUNT; h++) {
+      ptrs[h][i] = xd_malloc_hint(PTR_SIZE, hints[h]);
+      assert(ptrs[h][i] != NULL);
+      assert((void *)ptrs[h][i] < heap_start ||
+             (void *)ptrs[h][i] >= heap_end);
+      memset(ptrs[h][i], h, PTR_SIZE);
+    }
+  }
+  assert(sbrk(0) == heap_end);
+
+  // each class is packed, block after block
+  for (int h = 0; h < HINT_COUNT; h++) {
+    for (int i = 1; i < PTR_COUNT; i++) {
+      xd_mem_block_header *prev = xd_block_get_header_from_data(ptrs[h][i - 1]);
+      assert(xd_block_get_next(prev) ==
+             xd_block_get_header_from_data(ptrs[h][i]));
+    }
+  }
+
+  // the short-lived blocks coalesce into one, the other classes are intact
+  for (int i = 0; i < PTR_COUNT; i++) {
+    xd_free(ptrs[0][i]);
+  }
+  xd_byte *ptr = xd_malloc_hint(PTR_COUNT * PTR_SIZE, XD_HINT_SHORT);
+  assert(ptr == ptrs[0][0]);
+  for (int h = 1; h < HINT_COUNT; h++) {
+    for (int i = 0; i < PTR_COUNT; i++) {
+      for (int j = 0; j < PTR_SIZE; j++) {
+        assert(ptrs[h][i][j] == (xd_byte)h);
+      }
+    }
+  }
+
+  // realloc stays in the class
+  ptr = xd_realloc(ptr, 2 * PTR_COUNT * PTR_SIZE);
+  assert(ptr != NULL);
+  assert((void *)ptr < heap_start || (void *)ptr >= heap_end);
+  xd_free(ptr);
+
+  // unknown hint
+  ptr = xd_malloc_hint(PTR_SIZE, 0);
+  assert((void *)ptr >= heap_start && (void *)ptr < heap_end);
+  xd_free(ptr);
+
+  for (int h = 1; h < HINT_COUNT; h++) {
+    for (int i = 0; i < PTR_COUNT; i++) {
+      xd_free(ptrs[h][i]);
+    }
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
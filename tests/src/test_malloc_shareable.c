@@ -0,0 +1,196 @@
+/*
+ * ==============================================================================
+ * File: test_malloc_shareable.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define BUFFER_SIZE (1 << 20)
+#define SMALL_SIZE (100)
+
+/**
+ * @brief Represents the description of a shared buffer sent to the receiver.
+ */
+typedef struct buffer_message {
+  size_t offset;  // The offset of the buffer in the memfd
+  size_t size;    // The size of the buffer (in bytes)
+} buffer_message;
+
+/**
+ * @brief Receives a buffer descriptor over the passed socket, maps the buffer,
+ * checks its contents and writes a reply into it.
+ *
+ * @return `0` on success, or `1` on failure.
+ */
+static int receiver(int sock) {
+  buffer_message message;
+  char control[CMSG_SPACE(sizeof(int))];
+  struct iovec iov = {&message, sizeof(message)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if (recvmsg(sock, &msg, 0) != (ssize_t)sizeof(message)) {
+    return 1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(CMSG_FIRSTHDR(&msg)), sizeof(int));
+
+  size_t length = message.offset + message.size;
+  unsigned char *mapping =
+      mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return 1;
+  }
+  unsigned char *buffer = mapping + message.offset;
+  for (size_t i = 0; i < message.size; i++) {
+    if (buffer[i] != (unsigned char)(i * 7)) {
+      return 1;
+    }
+  }
+  strcpy((char *)buffer, "received");
+  munmap(mapping, length);
+  close(fd);
+
+  // tell the sender the reply was written
+  char done = 1;
+  return (write(sock, &done, 1) == 1) ? 0 : 1;
+}  // receiver()
+
+/**
+ * @brief Used for testing `xd_malloc_shareable()`:
+ * - A process that didn't inherit the buffer maps it through the passed
+ *   descriptor and offset, and sees its contents and writes without copies.
+ * - Blocks are outside the heap used by `xd_malloc()` and freed by `xd_free()`.
+ * - Every block has a memfd of its own holding only whole pages around it,
+ *   which is closed when the block is freed.
+ * - `xd_realloc()` keeps a block shareable, in place while it fits, and its
+ *   new descriptor and offset are returned by `xd_shareable_info()`.
+ */
+int main() {
+  int socks[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, socks) == 0);
+
+  // forked before the allocation, so the receiver doesn't inherit the buffer
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (pid == 0) {
+    close(socks[0]);
+    _exit(receiver(socks[1]));
+  }
+  close(socks[1]);
+
+  void *heap_start = sbrk(0);
+  int fd;
+  size_t offset;
+  unsigned char *buffer = xd_malloc_shareable(BUFFER_SIZE, &fd, &offset);
+  assert(buffer != NULL && fd >= 0);
+  assert((void *)buffer < heap_start || (void *)buffer >= sbrk(0));
+  for (size_t i = 0; i < BUFFER_SIZE; i++) {
+    buffer[i] = (unsigned char)(i * 7);
+  }
+
+  // send the descriptor and the offset
+  buffer_message message = {offset, BUFFER_SIZE};
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {&message, sizeof(message)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  assert(sendmsg(socks[0], &msg, 0) == (ssize_t)sizeof(message));
+
+  char done;
+  assert(read(socks[0], &done, 1) == 1);
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  assert(strcmp((char *)buffer, "received") == 0);
+  close(socks[0]);
+
+  // small blocks have a memfd each, of whole pages around the block
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  int small_fd;
+  size_t small_offset;
+  char *small = xd_malloc_shareable(SMALL_SIZE, &small_fd, &small_offset);
+  int other_fd;
+  size_t other_offset;
+  char *other = xd_malloc_shareable(SMALL_SIZE, &other_fd, &other_offset);
+  assert(small != NULL && other != NULL);
+  assert(small_fd != other_fd);
+  struct stat file_stat;
+  assert(fstat(other_fd, &file_stat) == 0);
+  assert((size_t)file_stat.st_size % page_size == 0);
+  assert((size_t)file_stat.st_size < other_offset + SMALL_SIZE + page_size);
+  strcpy(other, "mapped twice");
+  char *mapping = mmap(NULL, other_offset + SMALL_SIZE, PROT_READ, MAP_SHARED,
+                       other_fd, 0);
+  assert(mapping != MAP_FAILED);
+  assert(strcmp(mapping + other_offset, "mapped twice") == 0);
+  munmap(mapping, other_offset + SMALL_SIZE);
+
+  // freeing a block closes its memfd
+  xd_free(small);
+  errno = 0;
+  assert(fcntl(small_fd, F_GETFD) == -1 && errno == EBADF);
+
+  // realloc keeps the block shareable, in place while it fits
+  int fd_info;
+  size_t offset_info;
+  assert(xd_realloc(other, SMALL_SIZE / 2) == other);
+  other = xd_realloc(other, 2 * BUFFER_SIZE);
+  assert(other != NULL);
+  assert((void *)other < heap_start || (void *)other >= sbrk(0));
+  assert(strcmp(other, "mapped twice") == 0);
+  assert(xd_shareable_info(other, &fd_info, &offset_info) == 0);
+  mapping = mmap(NULL, offset_info + SMALL_SIZE, PROT_READ, MAP_SHARED,
+                 fd_info, 0);
+  assert(mapping != MAP_FAILED);
+  assert(strcmp(mapping + offset_info, "mapped twice") == 0);
+  munmap(mapping, offset_info + SMALL_SIZE);
+
+  // other blocks are not shareable
+  void *plain = xd_malloc(SMALL_SIZE);
+  errno = 0;
+  assert(xd_shareable_info(plain, &fd_info, &offset_info) == -1 &&
+         errno == EINVAL);
+  xd_free(plain);
+
+  xd_free(other);
+  xd_free(buffer);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,163 @@
+/*
+ * ==============================================================================
+ * File: test_malloc_tag.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define TAG_CACHE (1)
+#define TAG_PARSER (2)
+#define BLOCK_COUNT (2500)
+
+/**
+ * @brief Thread entry point, allocates without a tag while the main thread has
+ * one pushed.
+ */
+static void *untagged_thread(void *arg) {
+  (void)arg;
+  void *block = xd_malloc(100);
+  assert(block != NULL);
+  return block;
+}  // untagged_thread()
+
+/**
+ * @brief Used for testing `xd_malloc_tag_push()`, `xd_malloc_tag_pop()` and
+ * `xd_malloc_tag_stats()`:
+ * - Blocks allocated while a tag is current are counted in its statistics
+ *   until freed, nested tags are restored when popped.
+ * - Tags are per thread.
+ * - Blocks moved by `xd_realloc()` keep their tag, not the current one.
+ * - Blocks of destroyed heaps are no longer counted.
+ * - Tagged blocks can also be sampled by lifetime prediction.
+ * - Invalid tags and arguments fail.
+ */
+int main() {
+  static void *cache_blocks[BLOCK_COUNT];
+  static void *parser_blocks[BLOCK_COUNT];
+  xd_tag_stats stats;
+
+  errno = 0;
+  assert(xd_malloc_tag_push(0) == -1 && errno == EINVAL);
+  assert(xd_malloc_tag_push(XD_TAG_MAX + 1) == -1 && errno == EINVAL);
+  assert(xd_malloc_tag_stats(TAG_CACHE, NULL) == -1 && errno == EINVAL);
+  for (int i = 0; i < 16; i++) {
+    assert(xd_malloc_tag_push(TAG_CACHE) == 0);
+  }
+  assert(xd_malloc_tag_push(TAG_CACHE) == -1 && errno == EOVERFLOW);
+  for (int i = 0; i < 16; i++) {
+    xd_malloc_tag_pop();
+  }
+  xd_malloc_tag_pop();
+
+  // nested tags, enough blocks to grow the table
+  assert(xd_malloc_tag_push(TAG_CACHE) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT / 2; i++) {
+    cache_blocks[i] = xd_malloc(100);
+    assert(cache_blocks[i] != NULL);
+  }
+  assert(xd_malloc_tag_push(TAG_PARSER) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    parser_blocks[i] = xd_calloc(1, 1000);
+    assert(parser_blocks[i] != NULL);
+  }
+  xd_malloc_tag_pop();
+  for (size_t i = BLOCK_COUNT / 2; i < BLOCK_COUNT; i++) {
+    cache_blocks[i] = xd_malloc(100);
+    assert(cache_blocks[i] != NULL);
+  }
+
+  // other threads don't use the tag
+  pthread_t thread;
+  void *untagged_block;
+  assert(pthread_create(&thread, NULL, untagged_thread, NULL) == 0);
+  assert(pthread_join(thread, &untagged_block) == 0);
+  xd_malloc_tag_pop();
+  xd_free(untagged_block);
+
+  assert(xd_malloc_tag_stats(TAG_CACHE, &stats) == 0);
+  assert(stats.live_blocks == BLOCK_COUNT && stats.total_blocks == BLOCK_COUNT);
+  assert(stats.live_bytes >= BLOCK_COUNT * 100);
+  assert(stats.live_bytes == stats.total_bytes);
+  assert(xd_malloc_tag_stats(TAG_PARSER, &stats) == 0);
+  assert(stats.live_blocks == BLOCK_COUNT);
+  assert(stats.live_bytes >= BLOCK_COUNT * 1000);
+
+  // freed blocks leave the live statistics only
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    xd_free(parser_blocks[i]);
+  }
+  assert(xd_malloc_tag_stats(TAG_PARSER, &stats) == 0);
+  assert(stats.live_blocks == 0 && stats.live_bytes == 0);
+  assert(stats.total_blocks == BLOCK_COUNT);
+
+  // moved blocks keep their tag
+  cache_blocks[0] = xd_realloc(cache_blocks[0], 5000);
+  assert(cache_blocks[0] != NULL);
+  assert(xd_malloc_tag_stats(TAG_CACHE, &stats) == 0);
+  assert(stats.live_blocks == BLOCK_COUNT && stats.live_bytes >= 5000);
+  assert(xd_malloc_tag_push(TAG_PARSER) == 0);
+  cache_blocks[1] = xd_realloc(cache_blocks[1], 5000);
+  assert(cache_blocks[1] != NULL);
+  xd_malloc_tag_pop();
+  assert(xd_malloc_tag_stats(TAG_CACHE, &stats) == 0);
+  assert(stats.live_blocks == BLOCK_COUNT);
+  assert(xd_malloc_tag_stats(TAG_PARSER, &stats) == 0);
+  assert(stats.live_blocks == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    xd_free(cache_blocks[i]);
+  }
+  assert(xd_malloc_tag_stats(TAG_CACHE, &stats) == 0);
+  assert(stats.live_blocks == 0 && stats.live_bytes == 0);
+
+  // the blocks of a destroyed heap are no longer counted
+  xd_heap *heap = xd_heap_create();
+  assert(heap != NULL);
+  assert(xd_heap_push_current(heap) == 0);
+  assert(xd_malloc_tag_push(TAG_PARSER) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    assert(xd_malloc(64) != NULL);
+  }
+  xd_malloc_tag_pop();
+  xd_heap_pop_current();
+  assert(xd_malloc_tag_stats(TAG_PARSER, &stats) == 0);
+  assert(stats.live_blocks == BLOCK_COUNT);
+  xd_heap_destroy(heap);
+  assert(xd_malloc_tag_stats(TAG_PARSER, &stats) == 0);
+  assert(stats.live_blocks == 0 && stats.live_bytes == 0);
+
+  // sampled blocks can be tagged
+  xd_malloc_lifetime_prediction(1);
+  assert(xd_malloc_tag_push(TAG_CACHE) == 0);
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    cache_blocks[i] = xd_malloc(32);
+    assert(cache_blocks[i] != NULL);
+  }
+  xd_malloc_tag_pop();
+  for (size_t i = 0; i < BLOCK_COUNT; i++) {
+    xd_free(cache_blocks[i]);
+  }
+  xd_malloc_lifetime_prediction(0);
+  assert(xd_malloc_tag_stats(TAG_CACHE, &stats) == 0);
+  // the 2 moved blocks count as allocations too
+  assert(stats.live_blocks == 0 && stats.total_blocks == 2 * BLOCK_COUNT + 2);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,111 @@
+/*
+ * ==============================================================================
+ * File: test_memory_limit.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define BLOCK_SIZE (1024 * 1024)
+#define BLOCK_COUNT (8)
+#define LARGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Returns the number of resident pages in the whole pages of the passed
+ * block.
+ */
+static size_t resident_pages(void *ptr, size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)ptr + page_size - 1) & ~(page_size - 1);
+  uintptr_t end = ((uintptr_t)ptr + size) & ~(page_size - 1);
+  size_t count = (end - start) / page_size;
+  unsigned char vec[count];
+  assert(mincore((void *)start, end - start, vec) == 0);
+  size_t resident = 0;
+  for (size_t i = 0; i < count; i++) {
+    resident += vec[i] & 1;
+  }
+  return resident;
+}  // resident_pages()
+
+/**
+ * @brief Used for testing `xd_malloc_purge()` and `xd_malloc_memory_limit()`:
+ * - Purging returns the pages of free blocks to the OS and keeps the contents
+ *   of allocated blocks.
+ * - Freed blocks are reusable after being purged.
+ * - Once the usage is above the limit, the heaps are purged as they grow.
+ */
+int main() {
+  char *ptrs[BLOCK_COUNT];
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    ptrs[i] = xd_malloc(BLOCK_SIZE);
+    assert(ptrs[i] != NULL);
+    memset(ptrs[i], i + 1, BLOCK_SIZE);
+  }
+  for (int i = 0; i < BLOCK_COUNT; i += 2) {
+    xd_free(ptrs[i]);
+  }
+  assert(resident_pages(ptrs[0], BLOCK_SIZE) > 0);
+
+  // purge the free blocks
+  assert(xd_malloc_purge() >= (BLOCK_COUNT / 2) * (BLOCK_SIZE / 2));
+  for (int i = 0; i < BLOCK_COUNT; i += 2) {
+    assert(resident_pages(ptrs[i], BLOCK_SIZE) <= 1);
+  }
+  for (int i = 1; i < BLOCK_COUNT; i += 2) {
+    for (size_t j = 0; j < BLOCK_SIZE; j++) {
+      assert(ptrs[i][j] == (char)(i + 1));
+    }
+  }
+
+  // purged blocks are reused
+  for (int i = 0; i < BLOCK_COUNT; i += 2) {
+    ptrs[i] = xd_malloc(BLOCK_SIZE);
+    assert(ptrs[i] != NULL);
+    memset(ptrs[i], i + 1, BLOCK_SIZE);
+  }
+
+  // a limit below the usage purges while the heap grows
+  assert(xd_malloc_memory_limit(BLOCK_SIZE) == 0);
+  xd_free(ptrs[2]);
+  assert(resident_pages(ptrs[2], BLOCK_SIZE) > 0);
+  char *large[4];
+  for (int i = 0; i < 4; i++) {
+    large[i] = xd_malloc(LARGE_SIZE);
+    assert(large[i] != NULL);
+    memset(large[i], 0xAB, LARGE_SIZE);
+  }
+  xd_free(xd_malloc(1));
+  assert(resident_pages(ptrs[2], BLOCK_SIZE) <= 1);
+  assert(xd_malloc_memory_limit(SIZE_MAX) == 0);
+
+  for (int i = 0; i < 4; i++) {
+    xd_free(large[i]);
+  }
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    if (i != 2) {
+      xd_free(ptrs[i]);
+    }
+  }
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
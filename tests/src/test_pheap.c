@@ -0,0 +1,109 @@
+/*
+ * ==============================================================================
+ * File: test_pheap.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define HEAP_SIZE (1 << 20)
+#define NODE_COUNT (1000)
+
+/**
+ * @brief A node of a list stored in a persistent heap, linked by offsets.
+ */
+typedef struct node {
+  size_t next;  // Offset of the next node (`0` if none)
+  size_t value;
+  char payload[40];
+} node;
+
+/**
+ * @brief Used for testing `xd_pheap_open()`, `xd_pheap_close()`,
+ * `xd_pheap_malloc()`, `xd_pheap_free()` and the root block:
+ * - A list built in a new heap is found through the root after reopening.
+ * - The file can't be opened twice at the same time.
+ * - Freed blocks coalesce back into a single block spanning the heap.
+ * - A file that is not a persistent heap is rejected.
+ */
+int main() {
+  char path[] = "/tmp/xd_pheap_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd != -1);
+  close(fd);
+
+  // build a list and make its head the root
+  xd_pheap *pheap = xd_pheap_open(path, HEAP_SIZE);
+  assert(pheap != NULL);
+  assert(xd_pheap_root(pheap) == NULL);
+  size_t head = 0;
+  for (size_t i = 0; i < NODE_COUNT; i++) {
+    node *n = xd_pheap_malloc(pheap, sizeof(node));
+    assert(n != NULL);
+    n->next = head;
+    n->value = i;
+    memset(n->payload, (int)(i & 0x7F), sizeof(n->payload));
+    head = xd_pheap_offset(pheap, n);
+  }
+  xd_pheap_set_root(pheap, xd_pheap_pointer(pheap, head));
+
+  // the file is locked while open
+  errno = 0;
+  assert(xd_pheap_open(path, HEAP_SIZE) == NULL && errno == EBUSY);
+  assert(xd_pheap_close(pheap) == 0);
+
+  // reopen (the size is ignored) and walk the list from the root
+  pheap = xd_pheap_open(path, 0);
+  assert(pheap != NULL);
+  node *n = xd_pheap_root(pheap);
+  assert(n != NULL);
+  for (size_t i = NODE_COUNT; i-- > 0;) {
+    assert(n->value == i);
+    for (size_t j = 0; j < sizeof(n->payload); j++) {
+      assert(n->payload[j] == (char)(i & 0x7F));
+    }
+    node *next = (n->next == 0) ? NULL : xd_pheap_pointer(pheap, n->next);
+    xd_pheap_free(pheap, n);
+    n = next;
+  }
+  assert(n == NULL);
+  xd_pheap_set_root(pheap, NULL);
+
+  // all blocks coalesced, the whole heap can be allocated again
+  void *ptr = xd_pheap_malloc(pheap, HEAP_SIZE);
+  assert(ptr != NULL);
+  errno = 0;
+  assert(xd_pheap_malloc(pheap, HEAP_SIZE) == NULL && errno == ENOMEM);
+  xd_pheap_free(pheap, ptr);
+  assert(xd_pheap_close(pheap) == 0);
+
+  // not a persistent heap
+  FILE *file = fopen(path, "w");
+  assert(file != NULL);
+  fputs("not a heap", file);
+  fclose(file);
+  errno = 0;
+  assert(xd_pheap_open(path, HEAP_SIZE) == NULL && errno == EINVAL);
+
+  unlink(path);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
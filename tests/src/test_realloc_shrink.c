@@ -0,0 +1,62 @@
+/*
+ * ==============================================================================
+ * File: test_realloc_shrink.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define HOLE_SIZE (16)
+#define GUARD_SIZE (64)
+#define LARGE_SIZE (256 * 1024)
+#define SMALL_SIZE (8)
+
+/**
+ * @brief Used for testing `xd_realloc()` shrinking a block:
+ * - A large block moved to a small free block keeps the head of its contents.
+ * - Only the bytes that fit the new block are copied, the blocks after it are
+ *   left untouched.
+ */
+int main() {
+  void *hole = xd_malloc(HOLE_SIZE);
+  xd_byte *guard = xd_malloc(GUARD_SIZE);
+  assert(hole != NULL && guard != NULL);
+  memset(guard, 0x5A, GUARD_SIZE);
+  xd_free(hole);
+
+  xd_byte *large = xd_malloc(LARGE_SIZE);
+  assert(large != NULL);
+  for (size_t i = 0; i < LARGE_SIZE; i++) {
+    large[i] = (xd_byte)i;
+  }
+
+  xd_byte *small = xd_realloc(large, SMALL_SIZE);
+  assert(small != NULL);
+  for (size_t i = 0; i < SMALL_SIZE; i++) {
+    assert(small[i] == (xd_byte)i);
+  }
+  for (size_t i = 0; i < GUARD_SIZE; i++) {
+    assert(guard[i] == 0x5A);
+  }
+
+  xd_free(small);
+  xd_free(guard);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
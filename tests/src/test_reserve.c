@@ -0,0 +1,73 @@
+/*
+ * ==============================================================================
+ * File: test_reserve.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "xd_malloc.h"
+
+/**
+ * @brief Used for testing `xd_malloc_reserve()` and
+ * `xd_malloc_reserve_blocks()`:
+ * - Assuming 64-bit architecture.
+ * - Reserving 16384 bytes requests a single chunk of 20480 bytes:
+ *   [FENCEPOST    at 0     with size 0]
+ *   [UNALLOCATED  at 16    with size 20432]
+ *   [FENCEPOST    at 20464 with size 0]
+ *
+ * - Pre-splitting three blocks of size 32 we are supposed to have:
+ *   [FENCEPOST    at 0     with size 0]
+ *  A[UNALLOCATED  at 16    with size 32]
+ *  B[UNALLOCATED  at 64    with size 32]
+ *  C[UNALLOCATED  at 112   with size 32]
+ *   [UNALLOCATED  at 160   with size 20288]
+ *   [FENCEPOST    at 20464 with size 0]
+ *   and the free list is A -> B -> C -> remainder.
+ *
+ * - Allocating 32 bytes takes A without splitting.
+ *
+ * - Same is calculated for 32-bit architecture.
+ */
+int main() {
+  assert(xd_malloc_reserve(16384, XD_RESERVE_PREFAULT) == 0);
+  assert(xd_malloc_reserve(16384, XD_RESERVE_PREFAULT_PARALLEL) == 0);
+
+  puts("");
+  puts("AFTER RESERVE");
+  puts("");
+
+  xd_heap_headers_dump(stdout, NULL, NULL);
+
+  assert(xd_malloc_reserve_blocks(32, 3) == 0);
+
+  puts("");
+  puts("AFTER RESERVE BLOCKS");
+  puts("");
+
+  xd_heap_headers_dump(stdout, NULL, NULL);
+  xd_free_list_headers_dump(stdout);
+
+  xd_malloc(32);
+
+  puts("");
+  puts("AFTER MALLOC");
+  puts("");
+
+  xd_heap_headers_dump(stdout, NULL, NULL);
+  xd_free_list_headers_dump(stdout);
+
+  exit(EXIT_SUCCESS);
+}  // main()
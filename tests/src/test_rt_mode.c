@@ -0,0 +1,83 @@
+/*
+ * ==============================================================================
+ * File: test_rt_mode.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+
+#define PTR_COUNT (64)
+
+/**
+ * @brief Used for testing the real-time mode (`xd_malloc_rt_enable()`):
+ * - The heap does not grow on allocation, once the reserved memory is used up
+ *   `xd_malloc()` fails with `ENOMEM`.
+ * - Freed blocks are reused and coalesced through the bins.
+ * - The heap grows again only through `xd_malloc_reserve()`.
+ * - Compaction never returns the reserved memory to the OS.
+ */
+int main() {
+  void *ptrs[PTR_COUNT];
+
+  assert(xd_malloc_rt_enable(16384) == 0);
+  void *heap_end = sbrk(0);
+
+  // allocate and free mixed sizes without growing the heap
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < PTR_COUNT; i++) {
+      ptrs[i] = xd_malloc((size_t)(16 + (i * 8)));
+      assert(ptrs[i] != NULL);
+    }
+    for (int i = 0; i < PTR_COUNT; i += 2) {
+      xd_free(ptrs[i]);
+    }
+    for (int i = 1; i < PTR_COUNT; i += 2) {
+      xd_free(ptrs[i]);
+    }
+  }
+  assert(sbrk(0) == heap_end);
+
+  // everything is freed, so the whole reserved block can be allocated again
+  void *ptr = xd_malloc(16384);
+  assert(ptr != NULL);
+  xd_free(ptr);
+
+  // no implicit growth
+  errno = 0;
+  assert(xd_malloc(65536) == NULL);
+  assert(errno == ENOMEM);
+  assert(sbrk(0) == heap_end);
+
+  // explicit growth
+  assert(xd_malloc_reserve(65536, 0) == 0);
+  ptr = xd_malloc(65536);
+  assert(ptr != NULL);
+  xd_free(ptr);
+
+  // the free space at the top of the heap is kept
+  heap_end = sbrk(0);
+  xd_heap_compact(SIZE_MAX);
+  assert(sbrk(0) == heap_end);
+  ptr = xd_malloc(65536);
+  assert(ptr != NULL);
+  xd_free(ptr);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
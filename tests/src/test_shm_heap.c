@@ -0,0 +1,200 @@
+/*
+ * ==============================================================================
+ * File: test_shm_heap.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define HEAP_SIZE (1 << 20)
+#define PROCESS_COUNT (4)
+#define ITERATIONS (20000)
+#define LIVE_COUNT (32)
+#define MAX_SIZE (512)
+#define KILL_COUNT (20)
+
+/**
+ * @brief The root block of the test heap.
+ */
+typedef struct root {
+  size_t allocations;  // The number of allocations made by all processes
+} root;
+
+/**
+ * @brief Allocates and frees random blocks from the heap, checking that no
+ * other process writes to them.
+ *
+ * @return `0` on success, `1` if a block was overwritten or an allocation
+ * failed.
+ */
+static int worker(xd_pheap *pheap, unsigned int seed) {
+  unsigned char *ptrs[LIVE_COUNT] = {NULL};
+  size_t sizes[LIVE_COUNT] = {0};
+  size_t allocations = 0;
+  for (int i = 0; i < ITERATIONS; i++) {
+    int slot = rand_r(&seed) % LIVE_COUNT;
+    if (ptrs[slot] != NULL) {
+      for (size_t j = 0; j < sizes[slot]; j++) {
+        if (ptrs[slot][j] != (unsigned char)(slot + sizes[slot])) {
+          return 1;
+        }
+      }
+      xd_pheap_free(pheap, ptrs[slot]);
+    }
+    sizes[slot] = 1 + (rand_r(&seed) % MAX_SIZE);
+    ptrs[slot] = xd_pheap_malloc(pheap, sizes[slot]);
+    if (ptrs[slot] == NULL) {
+      return 1;
+    }
+    memset(ptrs[slot], (int)(slot + sizes[slot]), sizes[slot]);
+    allocations++;
+  }
+  for (int slot = 0; slot < LIVE_COUNT; slot++) {
+    xd_pheap_free(pheap, ptrs[slot]);
+  }
+
+  root *r = xd_pheap_root(pheap);
+  __atomic_add_fetch(&r->allocations, allocations, __ATOMIC_RELAXED);
+  return 0;
+}  // worker()
+
+/**
+ * @brief Allocates and frees random blocks from the heap until killed.
+ */
+static void churn(xd_pheap *pheap, unsigned int seed) {
+  while (true) {
+    void *ptr = xd_pheap_malloc(pheap, 1 + (rand_r(&seed) % MAX_SIZE));
+    xd_pheap_free(pheap, ptr);
+  }
+}  // churn()
+
+/**
+ * @brief Used for testing `xd_shm_heap_open()`:
+ * - Processes that open the same named heap allocate and free concurrently
+ *   without handing out the same block twice, with and without caches.
+ * - The root block is shared between the processes.
+ * - Closing the heaps returns the cached blocks, so all blocks coalesce.
+ * - An anonymous heap is shared with forked children.
+ * - Processes killed while holding the lock don't break the heap, the free
+ *   list is rebuilt by the next process.
+ */
+int main() {
+  char name[64];
+  snprintf(name, sizeof(name), "/xd_shm_heap_test_%d", (int)getpid());
+  shm_unlink(name);
+
+  xd_pheap *pheap = xd_shm_heap_open(name, HEAP_SIZE, XD_SHM_HEAP_CACHE);
+  assert(pheap != NULL);
+  root *r = xd_pheap_malloc(pheap, sizeof(root));
+  assert(r != NULL);
+  r->allocations = 0;
+  xd_pheap_set_root(pheap, r);
+
+  pid_t pids[PROCESS_COUNT];
+  for (int i = 0; i < PROCESS_COUNT; i++) {
+    pids[i] = fork();
+    assert(pids[i] != -1);
+    if (pids[i] == 0) {
+      int flags = (i % 2 == 0) ? XD_SHM_HEAP_CACHE : 0;
+      xd_pheap *child_heap = xd_shm_heap_open(name, 0, flags);
+      if (child_heap == NULL) {
+        _exit(1);
+      }
+      int ret = worker(child_heap, (unsigned int)i + 1);
+      xd_pheap_close(child_heap);
+      _exit(ret);
+    }
+  }
+  assert(worker(pheap, 0) == 0);
+  for (int i = 0; i < PROCESS_COUNT; i++) {
+    int status;
+    assert(waitpid(pids[i], &status, 0) == pids[i]);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  assert(r->allocations == (PROCESS_COUNT + 1) * (size_t)ITERATIONS);
+  xd_pheap_set_root(pheap, NULL);
+  xd_pheap_free(pheap, r);
+  assert(xd_pheap_close(pheap) == 0);
+
+  // everything was returned, the whole heap can be allocated
+  pheap = xd_shm_heap_open(name, 0, 0);
+  assert(pheap != NULL);
+  void *ptr = xd_pheap_malloc(pheap, HEAP_SIZE);
+  assert(ptr != NULL);
+  xd_pheap_free(pheap, ptr);
+  assert(xd_pheap_close(pheap) == 0);
+  assert(shm_unlink(name) == 0);
+
+  // anonymous heap shared with a child
+  pheap = xd_shm_heap_open(NULL, HEAP_SIZE, XD_SHM_HEAP_CACHE);
+  assert(pheap != NULL);
+  char *message = xd_pheap_malloc(pheap, 64);
+  xd_pheap_free(pheap, message);
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (pid == 0) {
+    // the parent's cached block is not reused by the child
+    char *child_message = xd_pheap_malloc(pheap, 64);
+    if (child_message == NULL || child_message == message) {
+      _exit(1);
+    }
+    strcpy(child_message, "hello from the child");
+    xd_pheap_set_root(pheap, child_message);
+    _exit(0);
+  }
+  int status;
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  char *child_message = xd_pheap_root(pheap);
+  assert(child_message != NULL);
+  assert(strcmp(child_message, "hello from the child") == 0);
+  assert(xd_pheap_malloc(pheap, 64) == message);
+  assert(xd_pheap_close(pheap) == 0);
+
+  // children killed while allocating
+  pheap = xd_shm_heap_open(NULL, HEAP_SIZE, 0);
+  assert(pheap != NULL);
+  for (int i = 0; i < KILL_COUNT; i++) {
+    pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+      churn(pheap, (unsigned int)i + 1);
+    }
+    usleep(1000 * (1 + (i % 5)));
+    assert(kill(pid, SIGKILL) == 0);
+    assert(waitpid(pid, &status, 0) == pid);
+    void *ptr = xd_pheap_malloc(pheap, MAX_SIZE);
+    assert(ptr != NULL);
+    xd_pheap_free(pheap, ptr);
+  }
+
+  // at most one block per child was lost
+  void *half = xd_pheap_malloc(pheap, HEAP_SIZE / 2);
+  assert(half != NULL);
+  xd_pheap_free(pheap, half);
+  assert(xd_pheap_close(pheap) == 0);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
@@ -0,0 +1,179 @@
+/*
+ * ==============================================================================
+ * File: test_snapshot_diff.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+// the tool is built into the test, its `main()` is run in a child process
+#define main snapshot_diff_main
+#include "../../tools/src/xd_snapshot_diff.c"
+#undef main
+
+#define TAG (3)
+#define GROWN_COUNT (10)
+#define GROWN_SIZE (1000)
+#define GROWN_SAMPLES (4)
+#define SAMPLE_PERIOD (2)
+
+/**
+ * @brief Writes a snapshot file from the passed records, returns its path.
+ */
+static char *snapshot_write(const xd_snapshot_block *records,
+                            uint64_t block_count,
+                            const xd_snapshot_sample *samples,
+                            uint64_t sample_count) {
+  static char paths[3][32];
+  static size_t path_count = 0;
+  char *path = paths[path_count++];
+  strcpy(path, "/tmp/xd_snapshot_XXXXXX");
+  int fd = mkstemp(path);
+  assert(fd != -1);
+  FILE *file = fdopen(fd, "wb");
+  assert(file != NULL);
+
+  xd_snapshot_header header = {
+      .magic = XD_SNAPSHOT_MAGIC,
+      .version = XD_SNAPSHOT_VERSION,
+      .stack_depth = XD_SNAPSHOT_STACK_DEPTH,
+      .sample_period = SAMPLE_PERIOD,
+      .block_count = block_count,
+      .sample_count = sample_count,
+  };
+  assert(fwrite(&header, sizeof(header), 1, file) == 1);
+  assert(fwrite(records, sizeof(*records), block_count, file) == block_count);
+  assert(fwrite(samples, sizeof(*samples), sample_count, file) ==
+         sample_count);
+  assert(fclose(file) == 0);
+  return path;
+}  // snapshot_write()
+
+/**
+ * @brief Runs the tool on two snapshots, stores its output and returns its
+ * exit status.
+ */
+static int diff_run(char *before, char *after, char *output, size_t size) {
+  int fds[2];
+  assert(pipe(fds) == 0);
+  pid_t pid = fork();
+  assert(pid != -1);
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    char *argv[] = {"xd_snapshot_diff", before, after, NULL};
+    snapshot_diff_main(3, argv);
+  }
+  close(fds[1]);
+  size_t length = 0;
+  ssize_t count;
+  while ((count = read(fds[0], output + length, size - length - 1)) > 0) {
+    length += (size_t)count;
+  }
+  output[length] = '\0';
+  close(fds[0]);
+
+  int status;
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status));
+  return WEXITSTATUS(status);
+}  // diff_run()
+
+/**
+ * @brief Returns whether the output holds the passed growth row.
+ */
+static bool row_find(const char *output, const char *name, int64_t bytes,
+                     int64_t count, uint64_t after) {
+  char row[128];
+  snprintf(row, sizeof(row), "%-24s %+16" PRId64 " %+14" PRId64 " %16" PRIu64
+           "\n", name, bytes, count, after);
+  return strstr(output, row) != NULL;
+}  // row_find()
+
+/**
+ * @brief Used for testing the `xd_snapshot_diff` tool:
+ * - The growth is reported by size class and by tag.
+ * - The call sites that grew are reported with their stacks, estimated from
+ *   the sample period, and the unchanged ones are not.
+ * - A snapshot whose counts don't match its size is rejected.
+ */
+int main() {
+  static char output[64 * 1024];
+  static xd_snapshot_block records[GROWN_COUNT + 2];
+  static xd_snapshot_sample samples[GROWN_SAMPLES + 1];
+
+  // both snapshots hold a small block, a free block and a sampled stack
+  records[0] = (xd_snapshot_block){0x10000, 100, XD_SNAPSHOT_BLOCK_ALLOCATED,
+                                   0};
+  records[1] = (xd_snapshot_block){0x20000, 4096, XD_SNAPSHOT_BLOCK_FREE, 0};
+  samples[0] = (xd_snapshot_sample){0x10000, 100, {0x1000, 0x1001}};
+  char *before = snapshot_write(records, 2, samples, 1);
+
+  // the second one also holds tagged blocks allocated from another stack
+  for (size_t i = 0; i < GROWN_COUNT; i++) {
+    records[i + 2] = (xd_snapshot_block){0x30000 + (i * 0x1000), GROWN_SIZE,
+                                         XD_SNAPSHOT_BLOCK_ALLOCATED, TAG};
+  }
+  for (size_t i = 0; i < GROWN_SAMPLES; i++) {
+    samples[i + 1] = (xd_snapshot_sample){0x30000 + (i * 0x1000), GROWN_SIZE,
+                                          {0x2000, 0x2001}};
+  }
+  char *after =
+      snapshot_write(records, GROWN_COUNT + 2, samples, GROWN_SAMPLES + 1);
+
+  assert(diff_run(before, after, output, sizeof(output)) == 0);
+  const int64_t grown_bytes = GROWN_COUNT * GROWN_SIZE;
+  assert(row_find(output, "[2^9, 2^10)", grown_bytes, GROWN_COUNT,
+                  grown_bytes));
+  assert(strstr(output, "[2^6, 2^7)") == NULL);
+  char tag[8];
+  snprintf(tag, sizeof(tag), "%d", TAG);
+  assert(row_find(output, tag, grown_bytes, GROWN_COUNT, grown_bytes));
+
+  const int64_t site_bytes = GROWN_SAMPLES * GROWN_SIZE * SAMPLE_PERIOD;
+  const int64_t site_blocks = GROWN_SAMPLES * SAMPLE_PERIOD;
+  assert(row_find(output, "#1", site_bytes, site_blocks, site_bytes));
+  assert(strstr(output, "    #0 0x2000\n    #1 0x2001\n") != NULL);
+  assert(strstr(output, "0x1000") == NULL);
+
+  // counts past the end of the file are rejected before any allocation
+  xd_snapshot_sample sample = {0, 0, {0}};
+  char *corrupt = snapshot_write(records, 2, &sample, 1);
+  FILE *file = fopen(corrupt, "r+b");
+  assert(file != NULL);
+  xd_snapshot_header header;
+  assert(fread(&header, sizeof(header), 1, file) == 1);
+  header.sample_count = (uint64_t)1 << 40;
+  rewind(file);
+  assert(fwrite(&header, sizeof(header), 1, file) == 1);
+  assert(fclose(file) == 0);
+  assert(diff_run(before, corrupt, output, sizeof(output)) == EXIT_FAILURE);
+  assert(strstr(output, "truncated snapshot") != NULL);
+
+  unlink(before);
+  unlink(after);
+  unlink(corrupt);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
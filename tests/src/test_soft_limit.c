@@ -0,0 +1,109 @@
+/*
+ * ==============================================================================
+ * File: test_soft_limit.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+#include "xd_malloc_test_utils.h"
+
+#define ENTRY_SIZE (64 * 1024)
+#define ENTRY_COUNT (64)
+#define LIMIT (4 * 1024 * 1024)
+
+/**
+ * @brief An application cache that sheds its entries under memory pressure.
+ */
+typedef struct cache {
+  void *entries[ENTRY_COUNT];
+  size_t count;    // The number of cached entries
+  size_t calls;    // The number of times the callback was called
+  size_t pending;  // The bytes to shed requested by the last call
+} cache;
+
+/**
+ * @brief Memory pressure callback, drops all the cache entries.
+ */
+static void shed_entries(size_t bytes, void *arg) {
+  cache *c = (cache *)arg;
+  c->calls++;
+  c->pending = bytes;
+  while (c->count > 0) {
+    xd_free(c->entries[--c->count]);
+  }
+}  // shed_entries()
+
+/**
+ * @brief A callback that is never registered.
+ */
+static void unused_callback(size_t bytes, void *arg) {
+  (void)bytes;
+  (void)arg;
+}  // unused_callback()
+
+/**
+ * @brief Used for testing `xd_malloc_set_soft_limit()`,
+ * `xd_malloc_pressure_callback_add()` and
+ * `xd_malloc_pressure_callback_remove()`:
+ * - Before the heap grows past the soft limit, the callbacks are called and
+ *   the memory they free is used instead of growing the heap.
+ * - The heap grows past the limit once nothing is left to shed.
+ * - Callbacks are unregistered, and invalid registrations fail.
+ */
+int main() {
+  static cache c;
+  void *heap_start = sbrk(0);
+
+  errno = 0;
+  assert(xd_malloc_pressure_callback_add(NULL, NULL) == -1 && errno == EINVAL);
+  assert(xd_malloc_pressure_callback_add(shed_entries, &c) == 0);
+
+  // fill the cache to the limit
+  xd_malloc_set_soft_limit(LIMIT);
+  while ((size_t)((char *)sbrk(0) - (char *)heap_start) + ENTRY_SIZE <
+             LIMIT &&
+         c.count < ENTRY_COUNT) {
+    c.entries[c.count] = xd_malloc(ENTRY_SIZE);
+    assert(c.entries[c.count] != NULL);
+    c.count++;
+  }
+  assert(c.calls == 0);
+
+  // a large block sheds the cache instead of growing the heap
+  void *large = xd_malloc(LIMIT / 2);
+  assert(large != NULL);
+  assert(c.calls == 1 && c.pending > 0 && c.count == 0);
+  assert((size_t)((char *)sbrk(0) - (char *)heap_start) <= LIMIT);
+
+  // nothing left to shed, the heap grows past the soft limit
+  void *huge = xd_malloc(2 * LIMIT);
+  assert(huge != NULL);
+  assert((size_t)((char *)sbrk(0) - (char *)heap_start) > LIMIT);
+  xd_free(huge);
+  xd_free(large);
+
+  errno = 0;
+  assert(xd_malloc_pressure_callback_remove(unused_callback, NULL) == -1 &&
+         errno == ENOENT);
+  assert(xd_malloc_pressure_callback_remove(shed_entries, &c) == 0);
+  xd_malloc_set_soft_limit(0);
+
+  puts("PASSED");
+  exit(EXIT_SUCCESS);
+}  // main()
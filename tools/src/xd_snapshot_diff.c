@@ -0,0 +1,381 @@
+/*
+ * ==============================================================================
+ * File: xd_snapshot_diff.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-malloc project.
+ * Repository: https://github.com/xduraid/xd-malloc
+ * ==============================================================================
+ * Copyright (c) 2025 Duraid Maihoub
+ *
+ * xd-malloc is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xd_malloc.h"
+
+/**
+ * @brief The default number of rows printed for each table.
+ */
+#define DEFAULT_ROW_COUNT (10)
+
+/**
+ * @brief The number of block records read at once.
+ */
+#define READ_BLOCK_COUNT (64 * 1024)
+
+/**
+ * @brief The number of size classes, size class `i` holds the blocks of size
+ * in `[2^i, 2^(i+1))`.
+ */
+#define SIZE_CLASS_COUNT (64)
+
+/**
+ * @brief The kinds of rows of the printed tables.
+ */
+typedef enum row_kind {
+  ROW_SIZE_CLASS,  // A size class
+  ROW_TAG,         // A tag
+  ROW_SITE,        // An allocation call site
+} row_kind;
+
+/**
+ * @brief Represents the allocated blocks counted in a row of a table.
+ */
+typedef struct totals {
+  uint64_t bytes;   // The size of the blocks (in bytes)
+  uint64_t blocks;  // The number of blocks
+} totals;
+
+/**
+ * @brief Represents the sampled blocks of an allocation stack.
+ */
+typedef struct site {
+  uint64_t stack[XD_SNAPSHOT_STACK_DEPTH];  // The allocation stack
+  totals live;                              // The sampled blocks
+} site;
+
+/**
+ * @brief Represents a snapshot aggregated by size class, tag and call site.
+ */
+typedef struct snapshot {
+  xd_snapshot_header header;         // The header of the snapshot
+  totals allocated;                  // All the allocated blocks
+  totals unallocated;                // All the free blocks
+  totals classes[SIZE_CLASS_COUNT];  // The allocated blocks by size class
+  totals tags[XD_TAG_MAX + 1];       // The allocated blocks by tag
+  site *sites;                       // The call sites sorted by stack
+  size_t site_count;                 // The number of call sites
+} snapshot;
+
+/**
+ * @brief Represents the growth of a row between the two snapshots.
+ */
+typedef struct growth {
+  size_t index;    // The size class, tag or position of the call site
+  int64_t bytes;   // The difference in size (in bytes)
+  int64_t blocks;  // The difference in number of blocks
+  uint64_t after;  // The size (in bytes) in the second snapshot
+} growth;
+
+static xd_snapshot_block blocks[READ_BLOCK_COUNT];
+
+/**
+ * @brief Prints an error about a snapshot file and exits.
+ */
+static void fail(const char *path, const char *message) {
+  fprintf(stderr, "xd_snapshot_diff: %s: %s\n", path, message);
+  exit(EXIT_FAILURE);
+}  // fail()
+
+/**
+ * @brief Returns the size class of a block size.
+ */
+static size_t size_class(uint64_t size) {
+  return (size == 0) ? 0 : (size_t)(63 - __builtin_clzll(size));
+}  // size_class()
+
+/**
+ * @brief Orders call sites by their allocation stacks.
+ */
+static int site_compare(const void *a, const void *b) {
+  return memcmp(((const site *)a)->stack, ((const site *)b)->stack,
+                sizeof(((const site *)a)->stack));
+}  // site_compare()
+
+/**
+ * @brief Orders growth rows by decreasing growth in bytes.
+ */
+static int growth_compare(const void *a, const void *b) {
+  int64_t x = ((const growth *)a)->bytes;
+  int64_t y = ((const growth *)b)->bytes;
+  return (x < y) - (x > y);
+}  // growth_compare()
+
+/**
+ * @brief Reads a snapshot, streaming its block records into the size class and
+ * tag totals and collapsing its samples into call sites.
+ */
+static void snapshot_read(const char *path, snapshot *snap) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    fail(path, strerror(errno));
+  }
+  memset(snap, 0, sizeof(*snap));
+  xd_snapshot_header *header = &snap->header;
+  if (fread(header, sizeof(*header), 1, file) != 1 ||
+      header->magic != XD_SNAPSHOT_MAGIC) {
+    fail(path, "not a heap snapshot");
+  }
+  if (header->version != XD_SNAPSHOT_VERSION ||
+      header->stack_depth != XD_SNAPSHOT_STACK_DEPTH) {
+    fail(path, "unsupported snapshot version");
+  }
+
+  // the counts are checked against the size of the file before anything is
+  // sized from them, so a corrupt header can't overflow the sites buffer
+  struct stat file_stat;
+  if (fstat(fileno(file), &file_stat) != 0) {
+    fail(path, strerror(errno));
+  }
+  uint64_t records_size = (file_stat.st_size > (off_t)sizeof(*header))
+                              ? (uint64_t)file_stat.st_size - sizeof(*header)
+                              : 0;
+  if (header->block_count > records_size / sizeof(xd_snapshot_block)) {
+    fail(path, "truncated snapshot");
+  }
+  records_size -= header->block_count * sizeof(xd_snapshot_block);
+  if (header->sample_count > records_size / sizeof(xd_snapshot_sample) ||
+      header->sample_count >= SIZE_MAX / sizeof(site)) {
+    fail(path, "truncated snapshot");
+  }
+
+  uint64_t remaining = header->block_count;
+  while (remaining > 0) {
+    size_t count = (remaining < READ_BLOCK_COUNT) ? (size_t)remaining
+                                                  : READ_BLOCK_COUNT;
+    if (fread(blocks, sizeof(xd_snapshot_block), count, file) != count) {
+      fail(path, "truncated snapshot");
+    }
+    for (size_t i = 0; i < count; i++) {
+      totals *total = &snap->unallocated;
+      if (blocks[i].state != XD_SNAPSHOT_BLOCK_FREE) {
+        total = &snap->allocated;
+        snap->classes[size_class(blocks[i].size)].bytes += blocks[i].size;
+        snap->classes[size_class(blocks[i].size)].blocks++;
+        snap->tags[blocks[i].tag & XD_TAG_MAX].bytes += blocks[i].size;
+        snap->tags[blocks[i].tag & XD_TAG_MAX].blocks++;
+      }
+      total->bytes += blocks[i].size;
+      total->blocks++;
+    }
+    remaining -= count;
+  }
+
+  // the samples stand for `sample_period` blocks each
+  uint64_t period = (header->sample_period == 0) ? 1 : header->sample_period;
+  size_t sample_count = (size_t)header->sample_count;
+  snap->sites = malloc((sample_count + 1) * sizeof(site));
+  if (snap->sites == NULL) {
+    fail(path, strerror(errno));
+  }
+  for (size_t i = 0; i < sample_count; i++) {
+    xd_snapshot_sample sample;
+    if (fread(&sample, sizeof(sample), 1, file) != 1) {
+      fail(path, "truncated snapshot");
+    }
+    site *current = &snap->sites[i];
+    memcpy(current->stack, sample.stack, sizeof(current->stack));
+    current->live = (totals){sample.size * period, period};
+  }
+  fclose(file);
+
+  qsort(snap->sites, sample_count, sizeof(site), site_compare);
+  size_t count = 0;
+  for (size_t i = 0; i < sample_count; i++) {
+    if (count > 0 && site_compare(&snap->sites[count - 1],
+                                  &snap->sites[i]) == 0) {
+      snap->sites[count - 1].live.bytes += snap->sites[i].live.bytes;
+      snap->sites[count - 1].live.blocks += snap->sites[i].live.blocks;
+      continue;
+    }
+    snap->sites[count++] = snap->sites[i];
+  }
+  snap->site_count = count;
+}  // snapshot_read()
+
+/**
+ * @brief Fills a growth row from the totals of the two snapshots, returns
+ * whether anything changed.
+ */
+static bool growth_fill(growth *row, size_t index, const totals *before,
+                        const totals *after) {
+  row->index = index;
+  row->bytes = (int64_t)(after->bytes - before->bytes);
+  row->blocks = (int64_t)(after->blocks - before->blocks);
+  row->after = after->bytes;
+  return row->bytes != 0 || row->blocks != 0;
+}  // growth_fill()
+
+/**
+ * @brief Sorts the growth rows and prints the first `limit` of them.
+ */
+static void growth_print(row_kind kind, growth *rows, size_t count,
+                         size_t limit, const site *sites) {
+  static const char *titles[] = {"size class", "tag", "call site"};
+  qsort(rows, count, sizeof(growth), growth_compare);
+  printf("\n%-24s %16s %14s %16s\n", titles[kind], "delta bytes",
+         "delta blocks", "after bytes");
+  for (size_t i = 0; i < count && i < limit; i++) {
+    char name[32];
+    switch (kind) {
+      case ROW_SIZE_CLASS:
+        snprintf(name, sizeof(name), "[2^%zu, 2^%zu)", rows[i].index,
+                 rows[i].index + 1);
+        break;
+      case ROW_TAG:
+        snprintf(name, sizeof(name), "%zu", rows[i].index);
+        break;
+      case ROW_SITE:
+        snprintf(name, sizeof(name), "#%zu", i + 1);
+        break;
+    }
+    printf("%-24s %+16" PRId64 " %+14" PRId64 " %16" PRIu64 "\n", name,
+           rows[i].bytes, rows[i].blocks, rows[i].after);
+    if (kind == ROW_SITE) {
+      const site *current = &sites[rows[i].index];
+      for (size_t j = 0; j < XD_SNAPSHOT_STACK_DEPTH && current->stack[j] != 0;
+           j++) {
+        printf("    #%zu 0x%" PRIx64 "\n", j, current->stack[j]);
+      }
+    }
+  }
+}  // growth_print()
+
+/**
+ * @brief Merges the sorted call sites of the two snapshots into growth rows,
+ * returns the sites the rows point to.
+ */
+static site *sites_merge(const snapshot *before, const snapshot *after,
+                         growth **rows, size_t *count) {
+  size_t capacity = before->site_count + after->site_count + 1;
+  site *sites = malloc(capacity * sizeof(site));
+  *rows = malloc(capacity * sizeof(growth));
+  if (sites == NULL || *rows == NULL) {
+    fail("merge", strerror(errno));
+  }
+
+  static const totals none = {0, 0};
+  size_t i = 0;
+  size_t j = 0;
+  *count = 0;
+  while (i < before->site_count || j < after->site_count) {
+    int order;
+    if (i == before->site_count) {
+      order = 1;
+    }
+    else if (j == after->site_count) {
+      order = -1;
+    }
+    else {
+      order = site_compare(&before->sites[i], &after->sites[j]);
+    }
+    const site *current = (order <= 0) ? &before->sites[i] : &after->sites[j];
+    const totals *old = (order <= 0) ? &before->sites[i].live : &none;
+    const totals *new = (order >= 0) ? &after->sites[j].live : &none;
+    sites[*count] = *current;
+    if (growth_fill(&(*rows)[*count], *count, old, new)) {
+      (*count)++;
+    }
+    i += (order <= 0);
+    j += (order >= 0);
+  }
+  return sites;
+}  // sites_merge()
+
+/**
+ * @brief Prints the usage of the tool and exits.
+ */
+static void usage() {
+  fprintf(stderr, "usage: xd_snapshot_diff [-n rows] before after\n");
+  exit(EXIT_FAILURE);
+}  // usage()
+
+/**
+ * @brief Compares two heap snapshots written by `xd_malloc_snapshot()`:
+ * - Usage: `xd_snapshot_diff [-n rows] before after` (default 10 rows).
+ * - The block records are streamed through a fixed buffer into per size class
+ *   and per tag totals, so snapshots of tens of millions of blocks are read
+ *   in seconds with constant memory.
+ * - The samples of each snapshot are sorted by allocation stack, then the two
+ *   are merged to find the call sites that grew (estimated from the sample
+ *   period, the stacks are only captured with leak detection enabled).
+ * - Each table is printed by decreasing growth in bytes.
+ */
+int main(int argc, char **argv) {
+  size_t limit = DEFAULT_ROW_COUNT;
+  int option;
+  while ((option = getopt(argc, argv, "n:")) != -1) {
+    if (option != 'n') {
+      usage();
+    }
+    limit = (size_t)strtoull(optarg, NULL, 10);
+  }
+  if (argc - optind != 2) {
+    usage();
+  }
+
+  static snapshot before;
+  static snapshot after;
+  snapshot_read(argv[optind], &before);
+  snapshot_read(argv[optind + 1], &after);
+
+  printf("%-24s %16s %16s %16s\n", "", "before bytes", "after bytes",
+         "delta bytes");
+  printf("%-24s %16" PRIu64 " %16" PRIu64 " %+16" PRId64 "\n", "allocated",
+         before.allocated.bytes, after.allocated.bytes,
+         (int64_t)(after.allocated.bytes - before.allocated.bytes));
+  printf("%-24s %16" PRIu64 " %16" PRIu64 " %+16" PRId64 "\n", "free",
+         before.unallocated.bytes, after.unallocated.bytes,
+         (int64_t)(after.unallocated.bytes - before.unallocated.bytes));
+
+  growth rows[SIZE_CLASS_COUNT + XD_TAG_MAX + 1];
+  size_t count = 0;
+  for (size_t i = 0; i < SIZE_CLASS_COUNT; i++) {
+    count += growth_fill(&rows[count], i, &before.classes[i],
+                         &after.classes[i]);
+  }
+  growth_print(ROW_SIZE_CLASS, rows, count, limit, NULL);
+
+  count = 0;
+  for (size_t i = 0; i <= XD_TAG_MAX; i++) {
+    count += growth_fill(&rows[count], i, &before.tags[i], &after.tags[i]);
+  }
+  growth_print(ROW_TAG, rows, count, limit, NULL);
+
+  growth *site_rows;
+  site *sites = sites_merge(&before, &after, &site_rows, &count);
+  if (before.site_count == 0 && after.site_count == 0) {
+    printf("\nno sampled blocks, enable xd_malloc_lifetime_prediction()\n");
+  }
+  else {
+    growth_print(ROW_SITE, site_rows, count, limit, sites);
+  }
+
+  free(site_rows);
+  free(sites);
+  free(before.sites);
+  free(after.sites);
+  exit(EXIT_SUCCESS);
+}  // main()